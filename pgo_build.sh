@@ -0,0 +1,37 @@
+#!/bin/sh
+
+# Build PE with profile-guided optimization (GCC).
+# 1. Build instrumented PE.
+# 2. Train it: PricingCore benchmark, and replay of tick journal if given
+#    (recorded in production, see output.journal_file in pe.ini).
+# 3. Rebuild with collected profile, in the same build directory (GCC finds
+#    profile by path of object files): build_pgo/PE.
+#
+# Usage: ./pgo_build.sh [journal] [cmake options, ex: -DPE_MARCH=haswell]
+
+set -e
+
+ROOT=$(cd "$(dirname "$0")" && pwd)
+JOURNAL=""
+if [ $# -gt 0 ] && [ -f "$1" ]; then
+  JOURNAL=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+  shift
+fi
+PGO_DIR="$ROOT/build_pgo/profile"
+
+rm -rf "$PGO_DIR"
+BUILD_DIR="$ROOT/build_pgo"
+
+cmake -S "$ROOT" -B "$BUILD_DIR" -DCMAKE_BUILD_TYPE=Release \
+      -DPE_PGO=GENERATE -DPE_PGO_DIR="$PGO_DIR" "$@"
+cmake --build "$BUILD_DIR" -j"$(nproc)"
+
+"$BUILD_DIR/PE" --benchmark 10000
+if [ -n "$JOURNAL" ]; then
+  "$BUILD_DIR/PE" --replay "$JOURNAL"
+fi
+
+cmake -S "$ROOT" -B "$BUILD_DIR" -DCMAKE_BUILD_TYPE=Release \
+      -DPE_PGO=USE -DPE_PGO_DIR="$PGO_DIR" "$@"
+cmake --build "$BUILD_DIR" -j"$(nproc)"
+echo "Optimized PE: $BUILD_DIR/PE"
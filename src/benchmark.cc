@@ -0,0 +1,246 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include "glog/logging.h"
+#include "pricing_core.h"
+#include "redis_controller.h"
+
+namespace {
+
+// Number of loops which are measured.
+const int kLoopNumber = 1000;
+// Number of currency codes, symbols are pairs of these codes.
+const int kCodeNumber = 100;
+
+std::string GetCode(int i) {
+  // Room for any int, |i| is not negative though.
+  char code[16];
+  snprintf(code, sizeof(code), "c%02d", i % kCodeNumber);
+  return code;
+}
+
+// Generate symbols with settings similar to production: most of them are
+// calculated based on jpy, some are fixed price, some are skewed.
+void AddSymbols(PricingCore& pricing_core, int symbol_number) {
+  std::mt19937 random(1);
+  for (int i = 0; i < symbol_number; i++) {
+    FairValueConfig config;
+    config.calculate_method =
+        (i % 5 == 0) ? FIXED_PRICE : BASED_ON_A_CURRENCY;
+    config.fixed_price = 100.0 + i;
+    config.skew_active = (i % 3 != 0);
+    config.skew_type = (i % 2) + 1;
+    config.skew_value = 0.5;
+    config.skew_percent = 101.0;
+    config.moving_average = 60;
+
+    int first = random() % kCodeNumber;
+    int second = (first + 1 + random() % (kCodeNumber - 1)) % kCodeNumber;
+    pricing_core.AddSymbol(GetCode(first) + GetCode(second), config);
+  }
+}
+
+// Return average time per symbol (nanoseconds).
+double Measure(PricingCore& pricing_core, bool simd) {
+  std::mt19937 random(2);
+  std::uniform_real_distribution<double> change(-0.001, 0.001);
+  std::vector<double> prices(pricing_core.GetLegNumber(), 1000.0);
+
+  int64_t total = 0;
+  for (int loop = 0; loop < kLoopNumber; loop++) {
+    // Leg prices are read from redis in production, not measured.
+    for (size_t leg = 0; leg < prices.size(); leg++) {
+      prices[leg] *= 1.0 + change(random);
+      pricing_core.SetLegPrice(leg, prices[leg]);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    if (simd)
+      pricing_core.Calculate();
+    else
+      pricing_core.CalculateScalar();
+    total += std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+  }
+
+  return static_cast<double>(total) / kLoopNumber /
+         pricing_core.GetSymbolNumber();
+}
+
+// Number of keys written by redis benchmark (like symbols of a group), and
+// example of fair value data.
+const int kBenchmarkKeyNumber = 100;
+const char kBenchmarkKeyPrefix[] = "pe_benchmark_";
+const char kBenchmarkValue[] =
+    "{\"fair_value\":\"0.03412500\",\"mov_avr\":\"0.03410000\","
+    "\"std_avr_ratio\":\"0.012345\",\"timestamp\":\"1500000000000\"}";
+
+std::string GetBenchmarkKey(int i) {
+  return kBenchmarkKeyPrefix + std::to_string(i % kBenchmarkKeyNumber);
+}
+
+// Latencies of redis commands (microseconds).
+struct RedisLatency {
+  double mean = 0.0;
+  double p50 = 0.0;
+  double p99 = 0.0;
+  // Average time per command when commands of a loop are pipelined.
+  double pipelined = 0.0;
+};
+
+// Return false if connection failed.
+bool MeasureRedis(const RedisServerInformation& server, int command_number,
+                  RedisLatency& latency) {
+  redisContext* redis_context = redis::client::CreateRedisClient(server);
+  if (redis_context == nullptr)
+    return false;
+  if (!redis::client::Authenticate(redis_context, server.password)) {
+    redisFree(redis_context);
+    return false;
+  }
+
+  // One by one, like legacy write mode. First commands warm up connection
+  // and server, they are not measured.
+  std::vector<double> samples;
+  samples.reserve(command_number);
+  int warm_up = std::min(command_number, 1000);
+  for (int i = -warm_up; i < command_number; i++) {
+    std::string key = GetBenchmarkKey(i + warm_up);
+    auto start = std::chrono::steady_clock::now();
+    redisReply* reply = (redisReply*) redisCommand(
+        redis_context, "SET %b %s", key.data(), key.size(), kBenchmarkValue);
+    auto stop = std::chrono::steady_clock::now();
+    if (reply == nullptr) {
+      LOG(ERROR) << "Benchmark failed: " << redis_context->errstr;
+      redisFree(redis_context);
+      return false;
+    }
+    freeReplyObject(reply);
+    if (i >= 0) {
+      samples.push_back(
+          std::chrono::duration<double, std::micro>(stop - start).count());
+    }
+  }
+
+  std::sort(samples.begin(), samples.end());
+  double sum = 0.0;
+  for (double sample : samples)
+    sum += sample;
+  latency.mean = sum / samples.size();
+  latency.p50 = samples[samples.size() / 2];
+  latency.p99 = samples[samples.size() * 99 / 100];
+
+  // Pipelined, |kBenchmarkKeyNumber| commands per loop.
+  int loop_number =
+      std::max(command_number / kBenchmarkKeyNumber, 1);
+  auto start = std::chrono::steady_clock::now();
+  for (int loop = 0; loop < loop_number; loop++) {
+    for (int i = 0; i < kBenchmarkKeyNumber; i++) {
+      std::string key = GetBenchmarkKey(i);
+      redisAppendCommand(redis_context, "SET %b %s",
+                         key.data(), key.size(), kBenchmarkValue);
+    }
+    for (int i = 0; i < kBenchmarkKeyNumber; i++) {
+      redisReply* reply = nullptr;
+      if (redisGetReply(redis_context, (void**) &reply) != REDIS_OK) {
+        LOG(ERROR) << "Benchmark failed: " << redis_context->errstr;
+        redisFree(redis_context);
+        return false;
+      }
+      freeReplyObject(reply);
+    }
+  }
+  latency.pipelined = std::chrono::duration<double, std::micro>(
+      std::chrono::steady_clock::now() - start).count() /
+      (loop_number * kBenchmarkKeyNumber);
+
+  for (int i = 0; i < kBenchmarkKeyNumber; i++) {
+    std::string key = GetBenchmarkKey(i);
+    freeReplyObject(redisCommand(redis_context, "DEL %b",
+                                 key.data(), key.size()));
+  }
+  redisFree(redis_context);
+  return true;
+}
+
+void LogRedisLatency(const std::string& name, const RedisLatency& latency) {
+  LOG(INFO) << " - " << name << ": mean " << latency.mean << " us, p50 "
+            << latency.p50 << " us, p99 " << latency.p99
+            << " us, pipelined " << latency.pipelined << " us/command";
+}
+
+} // namespace
+
+int RunPricingCoreBenchmark(int symbol_number) {
+  if (symbol_number <= 0) {
+    LOG(ERROR) << "Symbol number must be positive.";
+    return EXIT_FAILURE;
+  }
+
+  PricingCore scalar_core;
+  PricingCore simd_core;
+  AddSymbols(scalar_core, symbol_number);
+  AddSymbols(simd_core, symbol_number);
+
+  double scalar = Measure(scalar_core, false);
+  double simd = Measure(simd_core, true);
+
+  // Make sure both ways give the same results.
+  int mismatch = 0;
+  for (size_t i = 0; i < simd_core.GetSymbolNumber(); i++) {
+    if (simd_core.GetFairValue(i) != scalar_core.GetFairValue(i) ||
+        simd_core.GetMovingAverage(i) != scalar_core.GetMovingAverage(i) ||
+        simd_core.GetStandardDeviationRatio(i) !=
+            scalar_core.GetStandardDeviationRatio(i))
+      mismatch++;
+  }
+
+#if defined(__AVX__)
+  const char* simd_name = "AVX";
+#elif defined(__SSE2__)
+  const char* simd_name = "SSE2";
+#else
+  const char* simd_name = "none";
+#endif
+  LOG(INFO) << "PricingCore benchmark: " << symbol_number << " symbols, "
+            << simd_core.GetLegNumber() << " legs, " << kLoopNumber
+            << " loops.\n"
+            << " - Scalar: " << scalar << " ns/symbol\n"
+            << " - SIMD (" << simd_name << "): " << simd << " ns/symbol\n"
+            << " - Mismatched results: " << mismatch;
+  return mismatch == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int RunRedisBenchmark(const RedisServerInformation& server,
+                      int command_number) {
+  if (command_number <= 0) {
+    LOG(ERROR) << "Command number must be positive.";
+    return EXIT_FAILURE;
+  }
+
+  RedisServerInformation tcp_server = server;
+  tcp_server.unix_socket.clear();
+  RedisLatency tcp;
+  if (!MeasureRedis(tcp_server, command_number, tcp))
+    return EXIT_FAILURE;
+
+  LOG(INFO) << "Redis benchmark: " << command_number << " SET commands.";
+  LogRedisLatency("TCP " + server.host + ":" + std::to_string(server.port),
+                  tcp);
+
+  if (server.unix_socket.empty()) {
+    LOG(INFO) << "Set redis_server.unix_socket to compare with unix socket.";
+    return EXIT_SUCCESS;
+  }
+
+  RedisLatency unix_socket;
+  if (!MeasureRedis(server, command_number, unix_socket))
+    return EXIT_FAILURE;
+  LogRedisLatency("Unix socket " + server.unix_socket, unix_socket);
+  return EXIT_SUCCESS;
+}
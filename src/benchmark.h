@@ -0,0 +1,20 @@
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+
+#include "configuration.h"
+
+// Micro benchmarks, run by "PE --benchmark [symbol_number]" (no redis
+// connection is needed, inputs are generated) and by
+// "PE --benchmark-redis <config> [command_number]".
+
+// Measure time to calculate fair values of |symbol_number| symbols by
+// |PricingCore|, with and without SIMD. Return exit code.
+int RunPricingCoreBenchmark(int symbol_number);
+
+// Measure latency of writing fair value data to |server| (SET, one by one
+// and pipelined like a loop of a group), by TCP and by unix socket (if it is
+// configured). Return exit code.
+int RunRedisBenchmark(const RedisServerInformation& server,
+                      int command_number);
+
+#endif  // BENCHMARK_H_
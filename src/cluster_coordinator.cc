@@ -0,0 +1,217 @@
+#include "cluster_coordinator.h"
+
+#include <algorithm>
+#include <cstring>
+#include "common/clock.h"
+#include "glog/logging.h"
+#include "redis_key.h"
+
+namespace {
+
+// Number of virtual nodes per instance on hash ring.
+const int kVirtualNodeNumber = 64;
+
+// Add/refresh this instance in member list, remove expired members, return
+// member list.
+// KEYS: member list.
+// ARGV: instance id, expire time, current time (milliseconds since epoch).
+const char kHeartbeatScript[] =
+    "redis.call('ZADD', KEYS[1], ARGV[2], ARGV[1])\n"
+    "redis.call('ZREMRANGEBYSCORE', KEYS[1], '-inf', ARGV[3])\n"
+    "return redis.call('ZRANGE', KEYS[1], 0, -1)\n";
+
+// Extend leases which are held by this instance, return keys of the others
+// (lost leases).
+// KEYS: lease keys.
+// ARGV: instance id, lease time (milliseconds).
+const char kRenewScript[] =
+    "local lost = {}\n"
+    "for i, key in ipairs(KEYS) do\n"
+    "  if redis.call('GET', key) == ARGV[1] then\n"
+    "    redis.call('PEXPIRE', key, ARGV[2])\n"
+    "  else\n"
+    "    lost[#lost + 1] = key\n"
+    "  end\n"
+    "end\n"
+    "return lost\n";
+
+// Delete leases which are held by this instance, and remove it from member
+// list if leaving.
+// KEYS: member list, then lease keys.
+// ARGV: instance id, "1" if leaving.
+const char kReleaseScript[] =
+    "for i = 2, #KEYS do\n"
+    "  if redis.call('GET', KEYS[i]) == ARGV[1] then\n"
+    "    redis.call('DEL', KEYS[i])\n"
+    "  end\n"
+    "end\n"
+    "if ARGV[2] == '1' then\n"
+    "  redis.call('ZREM', KEYS[1], ARGV[1])\n"
+    "end\n"
+    "return 1\n";
+
+} // namespace
+
+ClusterCoordinator::ClusterCoordinator(
+    const RedisServerInformation& redis_info,
+    const ClusterInformation& cluster_info)
+    : redis_info_(redis_info),
+      cluster_info_(cluster_info),
+      ring_(kVirtualNodeNumber) {
+  // Connect, heartbeat and renewal of an update must be done before a lease
+  // can expire.
+  int max_timeout = std::max<int>(
+      (cluster_info_.lease_time - cluster_info_.renew_interval) / 4, 1);
+  if (redis_info_.connect_timeout <= 0 ||
+      redis_info_.connect_timeout > max_timeout)
+    redis_info_.connect_timeout = max_timeout;
+  if (redis_info_.command_timeout <= 0 ||
+      redis_info_.command_timeout > max_timeout)
+    redis_info_.command_timeout = max_timeout;
+  heartbeat_script_.source = kHeartbeatScript;
+  renew_script_.source = kRenewScript;
+  release_script_.source = kReleaseScript;
+}
+
+ClusterCoordinator::~ClusterCoordinator() {
+}
+
+void ClusterCoordinator::Update(const std::vector<std::string>& group_names,
+                                std::vector<std::string>& acquired,
+                                std::vector<std::string>& lost,
+                                std::vector<std::string>& releasing) {
+  uint64_t now = common::ToUint64(common::GetMonotonicMs());
+  if (now < last_update_time_ + cluster_info_.renew_interval)
+    return;
+  last_update_time_ = now;
+
+  redis::client::Client* redis_client =
+      redis::client::GetThreadClient(redis_info_);
+  const std::string& id = cluster_info_.instance_id;
+
+  // Heartbeat, members which are not refreshed within lease time are
+  // removed.
+  std::vector<std::string> members;
+  uint64_t system_time = common::ToUint64(common::GetWallClockMs());
+  bool connected = redis_client != nullptr &&
+      redis::client::EvalSha(
+          redis_client, heartbeat_script_, {kClusterMembersKey},
+          {id, std::to_string(system_time + cluster_info_.lease_time),
+           std::to_string(system_time)},
+          members);
+  if (connected && members != members_) {
+    std::string list;
+    for (auto& member : members)
+      list += (list.empty() ? "" : ", ") + member;
+    LOG(INFO) << "Cluster members: " << list;
+    members_ = members;
+    ring_.SetNodes(members_);
+  }
+
+  // Renew leases of owned groups.
+  if (connected && !owned_groups_.empty()) {
+    std::vector<std::string> keys;
+    for (auto& group : owned_groups_)
+      keys.push_back(kClusterLeasePrefix + group.first);
+
+    std::vector<std::string> lost_keys;
+    connected = redis::client::EvalSha(
+        redis_client, renew_script_, keys,
+        {id, std::to_string(cluster_info_.lease_time)}, lost_keys);
+    if (connected) {
+      for (auto& key : lost_keys) {
+        std::string name = key.substr(strlen(kClusterLeasePrefix));
+        LOG(ERROR) << "Lease of group " << name << " is lost.";
+        owned_groups_.erase(name);
+        lost.push_back(name);
+      }
+      for (auto& group : owned_groups_)
+        group.second = now;
+    }
+  }
+
+  // Stop groups which may be acquired by another instance before next
+  // update, because their leases cannot be renewed. Commands above may take
+  // time, so clock is read again.
+  now = common::ToUint64(common::GetMonotonicMs());
+  for (auto it = owned_groups_.begin(); it != owned_groups_.end();) {
+    if (now - it->second + cluster_info_.renew_interval >=
+        cluster_info_.lease_time) {
+      LOG(ERROR) << "Lease of group " << it->first
+                 << " is not renewed in time, stop it.";
+      lost.push_back(it->first);
+      it = owned_groups_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  if (!connected)
+    return;
+
+  // Release groups which are assigned to other instances (after members are
+  // changed) or removed from configuration.
+  for (auto it = owned_groups_.begin(); it != owned_groups_.end();) {
+    bool configured = std::find(group_names.begin(), group_names.end(),
+                                it->first) != group_names.end();
+    if (!configured || ring_.GetNode(it->first) != id) {
+      LOG(INFO) << "Release group " << it->first;
+      releasing.push_back(it->first);
+      it = owned_groups_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  // Acquire groups which are assigned to this instance. Lease of previous
+  // owner may still be valid (it is releasing it, or it failed), try again
+  // next time.
+  for (auto& name : group_names) {
+    if (owned_groups_.count(name) != 0 || ring_.GetNode(name) != id)
+      continue;
+    uint64_t acquire_time = common::ToUint64(common::GetMonotonicMs());
+    if (redis::client::SetNx(redis_client, kClusterLeasePrefix + name, id,
+                             cluster_info_.lease_time)) {
+      LOG(INFO) << "Acquire group " << name;
+      owned_groups_[name] = acquire_time;
+      acquired.push_back(name);
+    }
+  }
+}
+
+void ClusterCoordinator::Release(const std::string& group_name) {
+  redis::client::Client* redis_client =
+      redis::client::GetThreadClient(redis_info_);
+  if (redis_client == nullptr)
+    return;
+
+  redis::client::EvalSha(
+      redis_client, release_script_,
+      {kClusterMembersKey, kClusterLeasePrefix + group_name},
+      {cluster_info_.instance_id, "0"});
+}
+
+uint64_t ClusterCoordinator::GetLeaseDeadline(
+    const std::string& group_name) const {
+  auto it = owned_groups_.find(group_name);
+  if (it == owned_groups_.end())
+    return 0;
+  // Same margin as stopping groups in |Update()|.
+  return it->second + cluster_info_.lease_time - cluster_info_.renew_interval;
+}
+
+void ClusterCoordinator::Leave() {
+  redis::client::Client* redis_client =
+      redis::client::GetThreadClient(redis_info_);
+  if (redis_client == nullptr)
+    return;
+
+  std::vector<std::string> keys = {kClusterMembersKey};
+  for (auto& group : owned_groups_)
+    keys.push_back(kClusterLeasePrefix + group.first);
+  owned_groups_.clear();
+
+  redis::client::EvalSha(redis_client, release_script_, keys,
+                         {cluster_info_.instance_id, "1"});
+  LOG(INFO) << "Instance " << cluster_info_.instance_id
+            << " left cluster.";
+}
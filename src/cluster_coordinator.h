@@ -0,0 +1,84 @@
+#ifndef CLUSTER_COORDINATOR_H_
+#define CLUSTER_COORDINATOR_H_
+
+#include <map>
+#include <string>
+#include <vector>
+#include "common/consistent_hash.h"
+#include "configuration.h"
+#include "redis_controller.h"
+
+// Share groups of configuration file between PE instances which use the same
+// redis server, so more symbols are priced than one host can handle, and
+// groups of a failed instance are taken over by the others.
+//
+// Instances announce themselves in a member list (with expire time), each
+// group is assigned to one member by consistent hashing of its name. The
+// assigned instance runs the group while it holds the lease of the group: a
+// redis key (SET NX PX) containing its id, renewed periodically. A group is
+// never run by 2 instances: an instance stops a group as soon as it cannot
+// prove that it still holds the lease (renewal failed or redis unreachable
+// too long), before the lease expires and another instance can acquire it.
+// Commands of coordinator have short timeouts, so they cannot block it until
+// then. In case main thread is late anyway, groups stop writing at their
+// lease deadline (see |GetLeaseDeadline()|) by themselves.
+//
+// Used on main thread only.
+class ClusterCoordinator {
+public:
+  ClusterCoordinator(const RedisServerInformation& redis_info,
+                     const ClusterInformation& cluster_info);
+  virtual ~ClusterCoordinator();
+
+  ClusterCoordinator(const ClusterCoordinator&) = delete;
+  ClusterCoordinator& operator=(const ClusterCoordinator&) = delete;
+
+  // Heartbeat, renew leases of owned groups and acquire unowned groups which
+  // are assigned to this instance, once per renew interval (do nothing if
+  // called earlier). |group_names| are groups in configuration file.
+  // Output (names of groups):
+  //  - |acquired|: start these groups.
+  //  - |lost|: leases are lost, stop these groups right now.
+  //  - |releasing|: assigned to other instance (or removed from
+  //    configuration), stop these groups then call |Release()|.
+  void Update(const std::vector<std::string>& group_names,
+              std::vector<std::string>& acquired,
+              std::vector<std::string>& lost,
+              std::vector<std::string>& releasing);
+
+  // Give lease of a stopped group back, so its new owner does not wait for
+  // expiration.
+  void Release(const std::string& group_name);
+
+  // Time (monotonic, milliseconds) until which lease of owned group
+  // |group_name| is surely held, 0 if it is not owned.
+  uint64_t GetLeaseDeadline(const std::string& group_name) const;
+
+  // Leave cluster: release all leases and remove this instance from member
+  // list. Owned groups must be stopped before.
+  void Leave();
+
+  const std::string& GetInstanceId() { return cluster_info_.instance_id; }
+
+private:
+  RedisServerInformation redis_info_;
+  ClusterInformation cluster_info_;
+
+  redis::client::Script heartbeat_script_;
+  redis::client::Script renew_script_;
+  redis::client::Script release_script_;
+
+  // Members of cluster, updated by each heartbeat.
+  std::vector<std::string> members_;
+  common::ConsistentHashRing ring_;
+
+  // Owned groups -> time (monotonic, milliseconds) when their lease was
+  // renewed last time (before renewal was sent, so lease is valid for at
+  // least lease time from then).
+  std::map<std::string, uint64_t> owned_groups_;
+
+  // Time (monotonic, milliseconds) of last |Update()|.
+  uint64_t last_update_time_ = 0;
+};
+
+#endif  // CLUSTER_COORDINATOR_H_
@@ -0,0 +1,87 @@
+#ifndef COMMON_CLOCK_H_
+#define COMMON_CLOCK_H_
+
+#include <time.h>
+#include <chrono>
+#include <cstdint>
+
+namespace common {
+
+// Times of the two clocks, unit is part of the type so they cannot be mixed
+// up (a duration is |time - time|, ex: std::chrono::milliseconds).
+//  - Monotonic clock: never jumps, for intervals, timeouts and staleness of
+//    local events. Same epoch as std::chrono::steady_clock.
+//  - Wall clock: time since unix epoch, for timestamps which are published
+//    or compared with other processes. Same as std::chrono::system_clock.
+typedef std::chrono::time_point<std::chrono::steady_clock,
+                                std::chrono::nanoseconds> MonotonicNs;
+typedef std::chrono::time_point<std::chrono::steady_clock,
+                                std::chrono::milliseconds> MonotonicMs;
+typedef std::chrono::time_point<std::chrono::system_clock,
+                                std::chrono::nanoseconds> WallClockNs;
+typedef std::chrono::time_point<std::chrono::system_clock,
+                                std::chrono::milliseconds> WallClockMs;
+
+// Clocks are read by clock_gettime(), which is served by vDSO on Linux (no
+// system call, a few tens of nanoseconds).
+inline MonotonicNs GetMonotonicNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return MonotonicNs(std::chrono::nanoseconds(
+      static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec));
+}
+
+inline MonotonicMs GetMonotonicMs() {
+  return std::chrono::time_point_cast<std::chrono::milliseconds>(
+      GetMonotonicNs());
+}
+
+inline WallClockNs GetWallClockNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return WallClockNs(std::chrono::nanoseconds(
+      static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec));
+}
+
+inline WallClockMs GetWallClockMs() {
+  return std::chrono::time_point_cast<std::chrono::milliseconds>(
+      GetWallClockNs());
+}
+
+// Count of units since epoch of |time|, for fields which are stored or
+// published as integers (ex: 'timestamp' of fair value, milliseconds).
+template<typename Clock, typename Duration>
+uint64_t ToUint64(std::chrono::time_point<Clock, Duration> time) {
+  return static_cast<uint64_t>(time.time_since_epoch().count());
+}
+
+// Time of a tick (a loop of a group), both clocks are sampled once by
+// |Update()| at start of tick and then read without calling the clocks, so
+// all symbols of a tick have the same timestamp.
+class TickTime {
+public:
+  TickTime() {}
+
+  void Update() {
+    monotonic_ = common::GetMonotonicNs();
+    wall_clock_ = common::GetWallClockNs();
+  }
+
+  MonotonicNs GetMonotonicNs() const { return monotonic_; }
+  MonotonicMs GetMonotonicMs() const {
+    return std::chrono::time_point_cast<std::chrono::milliseconds>(monotonic_);
+  }
+  WallClockNs GetWallClockNs() const { return wall_clock_; }
+  WallClockMs GetWallClockMs() const {
+    return std::chrono::time_point_cast<std::chrono::milliseconds>(
+        wall_clock_);
+  }
+
+private:
+  MonotonicNs monotonic_;
+  WallClockNs wall_clock_;
+};
+
+} // namespace common
+
+#endif  // COMMON_CLOCK_H_
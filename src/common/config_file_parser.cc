@@ -73,4 +73,23 @@ std::vector<std::string> ConfigFileParser::GetListString(
   return common::Split(value, ',');
 }
 
+std::vector<int> ConfigFileParser::GetListInt(const std::string& key) {
+  std::vector<int> result;
+  for (auto& item : GetListString(key)) {
+    int i = 0;
+    std::string value = common::Trim(item);
+    if (value.empty())
+      continue;
+
+    try {
+      if (common::StringToInt(value, i))
+        result.push_back(i);
+    } catch (std::exception& e) {
+    }
+  }
+
+  return result;
+}
+
 } // namespace common
+
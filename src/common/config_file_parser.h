@@ -3,6 +3,7 @@
 #define COMMON_CONFIG_FILE_PARSER_H_
 
 #include <map>
+#include <string>
 #include <vector>
 
 namespace common {
@@ -23,6 +24,8 @@ public:
   int GetInt(const std::string& key);
   double GetDouble(const std::string& key);
   std::vector<std::string> GetListString(const std::string& key);
+  // Empty and invalid items are ignored.
+  std::vector<int> GetListInt(const std::string& key);
 
 private:
   std::map<std::string, std::string> data_;
@@ -0,0 +1,45 @@
+#include "common/consistent_hash.h"
+
+namespace common {
+
+uint64_t StableHash(const std::string& s) {
+  // FNV-1a, then mixed (splitmix64 finalizer) because similar strings (ex:
+  // "node#1", "node#2") have close FNV values.
+  uint64_t hash = 14695981039346656037ULL;
+  for (unsigned char c : s) {
+    hash ^= c;
+    hash *= 1099511628211ULL;
+  }
+
+  hash ^= hash >> 30;
+  hash *= 0xbf58476d1ce4e5b9ULL;
+  hash ^= hash >> 27;
+  hash *= 0x94d049bb133111ebULL;
+  hash ^= hash >> 31;
+  return hash;
+}
+
+ConsistentHashRing::ConsistentHashRing(int virtual_node_number)
+    : virtual_node_number_(virtual_node_number > 0 ? virtual_node_number : 1) {
+}
+
+void ConsistentHashRing::SetNodes(const std::vector<std::string>& nodes) {
+  ring_.clear();
+  for (auto& node : nodes) {
+    for (int i = 0; i < virtual_node_number_; i++)
+      ring_[StableHash(node + "#" + std::to_string(i))] = node;
+  }
+}
+
+std::string ConsistentHashRing::GetNode(const std::string& key) const {
+  if (ring_.empty())
+    return std::string();
+
+  // First virtual node clockwise from key.
+  auto it = ring_.lower_bound(StableHash(key));
+  if (it == ring_.end())
+    it = ring_.begin();
+  return it->second;
+}
+
+} // namespace common
@@ -0,0 +1,36 @@
+#ifndef COMMON_CONSISTENT_HASH_H_
+#define COMMON_CONSISTENT_HASH_H_
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace common {
+
+// 64-bit hash of |s|, same value on all platforms and builds (unlike
+// std::hash), so processes on different hosts agree on it.
+uint64_t StableHash(const std::string& s);
+
+// Consistent hash ring: each key is assigned to a node, and only keys of a
+// node are moved when it joins or leaves. Each node has many virtual nodes on
+// the ring to spread keys evenly.
+class ConsistentHashRing {
+public:
+  explicit ConsistentHashRing(int virtual_node_number);
+
+  // Replace all nodes.
+  void SetNodes(const std::vector<std::string>& nodes);
+
+  // Get node of |key|, empty if there is no node.
+  std::string GetNode(const std::string& key) const;
+
+private:
+  int virtual_node_number_;
+  // Position on ring -> node.
+  std::map<uint64_t, std::string> ring_;
+};
+
+} // namespace common
+
+#endif  // COMMON_CONSISTENT_HASH_H_
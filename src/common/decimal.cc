@@ -0,0 +1,241 @@
+#include "common/decimal.h"
+
+#include <cmath>
+#include <limits>
+
+namespace common {
+
+namespace {
+
+typedef __int128 int128_t;
+
+const int128_t kMaxInt64 = std::numeric_limits<int64_t>::max();
+const int128_t kMaxInt128 =
+    static_cast<int128_t>(~static_cast<unsigned __int128>(0) >> 1);
+
+// 10^n, n is in [0, 38].
+int128_t Pow10(int n) {
+  int128_t result = 1;
+  for (int i = 0; i < n; i++)
+    result *= 10;
+  return result;
+}
+
+const uint64_t kPow10Uint64[] = {
+  1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+  100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL,
+  1000000000000ULL, 10000000000000ULL, 100000000000000ULL,
+  1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+  1000000000000000000ULL, 10000000000000000000ULL
+};
+
+// |numerator| / |denominator|, rounded half away from zero.
+int128_t DivideRound(int128_t numerator, int128_t denominator) {
+  int128_t quotient = numerator / denominator;
+  int128_t remainder = numerator % denominator;
+  if (remainder < 0)
+    remainder = -remainder;
+  int128_t half = denominator < 0 ? -denominator : denominator;
+  if (remainder >= half - remainder)
+    quotient += ((numerator < 0) != (denominator < 0)) ? -1 : 1;
+  return quotient;
+}
+
+// |value| * 10^n. Return false if overflowed.
+bool MultiplyPow10(int128_t value, int n, int128_t& result) {
+  if (value == 0) {
+    result = 0;
+    return true;
+  }
+  if (n > 38)
+    return false;
+
+  int128_t factor = Pow10(n);
+  int128_t absolute = value < 0 ? -value : value;
+  if (absolute > kMaxInt128 / factor)
+    return false;
+
+  result = value * factor;
+  return true;
+}
+
+// Convert to |Decimal|, 0 if |value| does not fit in int64.
+Decimal MakeDecimal(int128_t value, int scale) {
+  if (value > kMaxInt64 || value < -kMaxInt64)
+    return Decimal(0, scale);
+  return Decimal(static_cast<int64_t>(value), scale);
+}
+
+// |value| with |from| digits after decimal point, to |to| digits.
+bool RescaleValue(int128_t value, int from, int to, int128_t& result) {
+  if (to >= from)
+    return MultiplyPow10(value, to - from, result);
+
+  result = DivideRound(value, Pow10(from - to));
+  return true;
+}
+
+} // namespace
+
+const int Decimal::kMaxScale;
+const size_t Decimal::kMaxStringLength;
+
+// static
+Decimal Decimal::FromDouble(double value, int scale) {
+  if (scale < 0)
+    scale = 0;
+  if (scale > kMaxScale)
+    scale = kMaxScale;
+
+  double mantissa = std::round(value * static_cast<double>(Pow10(scale)));
+  if (!std::isfinite(mantissa) ||
+      std::fabs(mantissa) >= 9.2e18)
+    return Decimal(0, scale);
+  return Decimal(static_cast<int64_t>(mantissa), scale);
+}
+
+// static
+bool Decimal::Parse(const char* str, size_t length, Decimal& result) {
+  size_t i = 0;
+  bool negative = false;
+  if (i < length && (str[i] == '-' || str[i] == '+')) {
+    negative = str[i] == '-';
+    i++;
+  }
+
+  int128_t mantissa = 0;
+  int scale = 0;
+  bool has_digit = false;
+  bool has_point = false;
+  bool round_up = false;
+  bool ignored_digit = false;
+  for (; i < length; i++) {
+    char c = str[i];
+    if (c == '.' && !has_point) {
+      has_point = true;
+      continue;
+    }
+    if (c < '0' || c > '9')
+      return false;
+
+    has_digit = true;
+    // Digits after |kMaxScale| are rounded.
+    if (has_point && scale == kMaxScale) {
+      if (!ignored_digit)
+        round_up = c >= '5';
+      ignored_digit = true;
+      continue;
+    }
+
+    mantissa = mantissa * 10 + (c - '0');
+    if (mantissa > kMaxInt64)
+      return false;
+    if (has_point)
+      scale++;
+  }
+
+  if (!has_digit)
+    return false;
+
+  if (round_up && ++mantissa > kMaxInt64)
+    return false;
+
+  result = Decimal(static_cast<int64_t>(negative ? -mantissa : mantissa),
+                   scale);
+  return true;
+}
+
+double Decimal::ToDouble() const {
+  return static_cast<double>(mantissa_) / static_cast<double>(Pow10(scale_));
+}
+
+Decimal Decimal::Rescale(int scale) const {
+  int128_t value;
+  if (!RescaleValue(mantissa_, scale_, scale, value))
+    return Decimal(0, scale);
+  return MakeDecimal(value, scale);
+}
+
+Decimal Decimal::Add(const Decimal& other) const {
+  int128_t value;
+  if (!RescaleValue(other.mantissa_, other.scale_, scale_, value))
+    return Decimal(0, scale_);
+  return MakeDecimal(value + mantissa_, scale_);
+}
+
+Decimal Decimal::Multiply(const Decimal& other) const {
+  // Product of two int64 always fits in int128.
+  int128_t product = static_cast<int128_t>(mantissa_) * other.mantissa_;
+  return MakeDecimal(DivideRound(product, Pow10(other.scale_)), scale_);
+}
+
+Decimal Decimal::Divide(const Decimal& other, int scale) const {
+  if (other.mantissa_ == 0)
+    return Decimal(0, scale);
+
+  // mantissa = this / other * 10^scale
+  //          = (m1 / 10^s1) / (m2 / 10^s2) * 10^scale
+  //          = m1 * 10^(scale + s2 - s1) / m2
+  int shift = scale + other.scale_ - scale_;
+  int128_t numerator = mantissa_;
+  int128_t denominator = other.mantissa_;
+  if (shift >= 0) {
+    if (!MultiplyPow10(numerator, shift, numerator))
+      return Decimal(0, scale);
+  } else {
+    if (!MultiplyPow10(denominator, -shift, denominator))
+      return Decimal(0, scale);
+  }
+
+  return MakeDecimal(DivideRound(numerator, denominator), scale);
+}
+
+size_t Decimal::Format(char* buffer) const {
+  size_t length = 0;
+  uint64_t absolute = mantissa_ < 0
+      ? static_cast<uint64_t>(-(mantissa_ + 1)) + 1
+      : static_cast<uint64_t>(mantissa_);
+  if (mantissa_ < 0)
+    buffer[length++] = '-';
+
+  uint64_t factor = kPow10Uint64[scale_];
+  length += FormatUint64(absolute / factor, buffer + length);
+  if (scale_ > 0) {
+    buffer[length++] = '.';
+    uint64_t fraction = absolute % factor;
+    for (int i = scale_ - 1; i >= 0; i--) {
+      buffer[length + i] = '0' + fraction % 10;
+      fraction /= 10;
+    }
+    length += scale_;
+  }
+
+  buffer[length] = '\0';
+  return length;
+}
+
+std::string Decimal::ToString() const {
+  char buffer[kMaxStringLength];
+  size_t length = Format(buffer);
+  return std::string(buffer, length);
+}
+
+size_t FormatUint64(uint64_t value, char* buffer) {
+  // Write digits backward, then reverse.
+  size_t length = 0;
+  do {
+    buffer[length++] = '0' + value % 10;
+    value /= 10;
+  } while (value != 0);
+
+  for (size_t i = 0; i < length / 2; i++) {
+    char c = buffer[i];
+    buffer[i] = buffer[length - 1 - i];
+    buffer[length - 1 - i] = c;
+  }
+
+  buffer[length] = '\0';
+  return length;
+}
+
+} // namespace common
@@ -0,0 +1,72 @@
+#ifndef COMMON_DECIMAL_H_
+#define COMMON_DECIMAL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace common {
+
+// Fixed-point decimal number: value = mantissa / 10^scale.
+// Used for prices, so arithmetic and formatting are exact with the precision
+// of each symbol (no binary floating point rounding).
+// Results are rounded half away from zero.
+class Decimal {
+public:
+  // Max number of digits after decimal point.
+  static const int kMaxScale = 18;
+  // Max length of formatted string (sign, 19 digits, point, '\0').
+  static const size_t kMaxStringLength = 24;
+
+  Decimal() : mantissa_(0), scale_(0) {}
+  Decimal(int64_t mantissa, int scale) : mantissa_(mantissa), scale_(scale) {}
+
+  // Round |value| to |scale| digits after decimal point.
+  static Decimal FromDouble(double value, int scale);
+
+  // Parse decimal string (ex: "-123.4500"), digits after decimal point are
+  // kept (up to |kMaxScale|). Return false if string is not a number or too
+  // big.
+  static bool Parse(const char* str, size_t length, Decimal& result);
+  static bool Parse(const std::string& str, Decimal& result) {
+    return Parse(str.data(), str.size(), result);
+  }
+
+  int64_t mantissa() const { return mantissa_; }
+  int scale() const { return scale_; }
+  bool IsZero() const { return mantissa_ == 0; }
+  bool IsPositive() const { return mantissa_ > 0; }
+
+  double ToDouble() const;
+
+  // Round to |scale| digits after decimal point.
+  Decimal Rescale(int scale) const;
+
+  // Arithmetic, result has |scale()| of this number (or |scale| if it is
+  // given). Result is 0 if it is overflowed or divided by 0.
+  Decimal Add(const Decimal& other) const;
+  Decimal Multiply(const Decimal& other) const;
+  Decimal Divide(const Decimal& other, int scale) const;
+
+  // Write number into |buffer| (at least |kMaxStringLength| bytes) without
+  // memory allocation. All digits of |scale()| are written (ex: "0.10000").
+  // Return length of string (not include '\0').
+  size_t Format(char* buffer) const;
+  std::string ToString() const;
+
+private:
+  int64_t mantissa_;
+  int scale_;
+};
+
+// Max length of formatted uint64 (20 digits, '\0').
+const size_t kMaxUint64StringLength = 21;
+
+// Write unsigned integer into |buffer| (at least |kMaxUint64StringLength|
+// bytes) without memory allocation. Return length of string (not include
+// '\0').
+size_t FormatUint64(uint64_t value, char* buffer);
+
+} // namespace common
+
+#endif  // COMMON_DECIMAL_H_
@@ -0,0 +1,61 @@
+#ifndef COMMON_MPSC_QUEUE_H_
+#define COMMON_MPSC_QUEUE_H_
+
+#include <atomic>
+#include <utility>
+
+namespace common {
+
+// Lock-free multi-producer single-consumer queue (Vyukov's algorithm).
+// |Push()| can be called from any thread, |Pop()| must only be called from
+// the consumer thread.
+template<typename T>
+class MpscQueue {
+public:
+  MpscQueue() : head_(new Node()), tail_(head_.load()) {}
+  virtual ~MpscQueue() {
+    T value;
+    while (Pop(value));
+    delete tail_;
+  }
+
+  MpscQueue(const MpscQueue&) = delete;
+  MpscQueue& operator=(const MpscQueue&) = delete;
+
+  void Push(T value) {
+    Node* node = new Node(std::move(value));
+    Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+  }
+
+  // Return false if queue is empty (or a producer is in the middle of
+  // pushing, the item will be available on next call).
+  bool Pop(T& value) {
+    Node* tail = tail_;
+    Node* next = tail->next.load(std::memory_order_acquire);
+    if (next == nullptr)
+      return false;
+
+    value = std::move(next->value);
+    tail_ = next;
+    delete tail;
+    return true;
+  }
+
+private:
+  struct Node {
+    Node() : next(nullptr) {}
+    explicit Node(T v) : value(std::move(v)), next(nullptr) {}
+
+    T value;
+    std::atomic<Node*> next;
+  };
+
+  // Producers push at |head_|, consumer pops at |tail_|.
+  std::atomic<Node*> head_;
+  Node* tail_;
+};
+
+} // namespace common
+
+#endif  // COMMON_MPSC_QUEUE_H_
@@ -0,0 +1,138 @@
+#ifndef COMMON_PRICE_MULTICAST_PROTOCOL_H_
+#define COMMON_PRICE_MULTICAST_PROTOCOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include "common/decimal.h"
+
+// Wire protocol of multicast price feed (see |PriceMulticastPublisher| and
+// |PriceMulticastReceiver|). Integers and doubles are in little-endian byte
+// order (native byte order of x86/arm hosts).
+//
+// Datagram (at most |kPriceMulticastMaxDatagramSize| bytes):
+//
+//   | session (uint32) | sequence (uint64) | update count (uint16) | updates |
+//
+// |session| changes when publisher is restarted. |sequence| of datagrams with
+// updates starts from 1 and increases by 1, receivers detect lost datagrams
+// by it. A heartbeat (no update) is sent when feed is idle, its |sequence| is
+// the last sent one, so loss of last datagrams is detected too.
+//
+// Update: | length (uint8) | symbol name | timestamp (uint64) |
+//         | fair value mantissa (int64) | fair value scale (uint8) |
+//         | moving average (double) | standard deviation ratio (double) |
+//
+// Fair value is exact: mantissa / 10^scale (see |common::Decimal|).
+//
+// Snapshot service (TCP or unix socket) writes latest update of every symbol
+// and closes connection, receivers recover from it after a gap:
+//
+//   | session (uint32) | sequence (uint64) | update count (uint32) | updates |
+//
+// |sequence| is the last datagram which is included in snapshot.
+
+namespace common {
+
+// Fits in one ethernet frame (1500 bytes MTU - IP and UDP headers).
+const size_t kPriceMulticastMaxDatagramSize = 1472;
+const size_t kPriceMulticastDatagramHeaderSize = 14;
+const size_t kPriceMulticastSnapshotHeaderSize = 16;
+const size_t kPriceMulticastMaxSymbolNameSize = 255;
+// Size of an update without symbol name.
+const size_t kPriceMulticastUpdateFixedSize = 34;
+
+struct PriceMulticastUpdate {
+  std::string symbol_name;
+  // Wall clock, milliseconds since unix epoch.
+  uint64_t timestamp;
+  Decimal fair_value;
+  double moving_average;
+  double standard_deviation_ratio;
+};
+
+// Size of |update| on the wire.
+inline size_t GetPriceMulticastUpdateSize(const PriceMulticastUpdate& update) {
+  return update.symbol_name.size() + kPriceMulticastUpdateFixedSize;
+}
+
+// Write |update| to |buffer|, which has room for
+// |GetPriceMulticastUpdateSize()| bytes. Return number of written bytes.
+// Symbol name must not be longer than |kPriceMulticastMaxSymbolNameSize|.
+inline size_t WritePriceMulticastUpdate(const PriceMulticastUpdate& update,
+                                        char* buffer) {
+  size_t name_size = update.symbol_name.size();
+  buffer[0] = static_cast<char>(name_size);
+  memcpy(buffer + 1, update.symbol_name.data(), name_size);
+  char* out = buffer + 1 + name_size;
+  int64_t mantissa = update.fair_value.mantissa();
+  memcpy(out, &update.timestamp, 8);
+  memcpy(out + 8, &mantissa, 8);
+  out[16] = static_cast<char>(update.fair_value.scale());
+  memcpy(out + 17, &update.moving_average, 8);
+  memcpy(out + 25, &update.standard_deviation_ratio, 8);
+  return name_size + kPriceMulticastUpdateFixedSize;
+}
+
+// Read an update from |size| bytes of |data| into |update|. Return number of
+// read bytes, 0 if |data| is truncated.
+inline size_t ReadPriceMulticastUpdate(const char* data, size_t size,
+                                       PriceMulticastUpdate& update) {
+  if (size < 1)
+    return 0;
+  size_t name_size = static_cast<uint8_t>(data[0]);
+  if (size < name_size + kPriceMulticastUpdateFixedSize)
+    return 0;
+  int scale = static_cast<uint8_t>(data[1 + name_size + 16]);
+  if (scale > Decimal::kMaxScale)
+    return 0;
+  update.symbol_name.assign(data + 1, name_size);
+  const char* in = data + 1 + name_size;
+  int64_t mantissa = 0;
+  memcpy(&update.timestamp, in, 8);
+  memcpy(&mantissa, in + 8, 8);
+  update.fair_value = Decimal(mantissa, scale);
+  memcpy(&update.moving_average, in + 17, 8);
+  memcpy(&update.standard_deviation_ratio, in + 25, 8);
+  return name_size + kPriceMulticastUpdateFixedSize;
+}
+
+// Write datagram header to |buffer|.
+inline void WritePriceMulticastHeader(uint32_t session, uint64_t sequence,
+                                      uint16_t update_count, char* buffer) {
+  memcpy(buffer, &session, 4);
+  memcpy(buffer + 4, &sequence, 8);
+  memcpy(buffer + 12, &update_count, 2);
+}
+
+inline void ReadPriceMulticastHeader(const char* buffer, uint32_t& session,
+                                     uint64_t& sequence,
+                                     uint16_t& update_count) {
+  memcpy(&session, buffer, 4);
+  memcpy(&sequence, buffer + 4, 8);
+  memcpy(&update_count, buffer + 12, 2);
+}
+
+// Write snapshot header to |buffer|.
+inline void WritePriceMulticastSnapshotHeader(uint32_t session,
+                                              uint64_t sequence,
+                                              uint32_t update_count,
+                                              char* buffer) {
+  memcpy(buffer, &session, 4);
+  memcpy(buffer + 4, &sequence, 8);
+  memcpy(buffer + 12, &update_count, 4);
+}
+
+inline void ReadPriceMulticastSnapshotHeader(const char* buffer,
+                                             uint32_t& session,
+                                             uint64_t& sequence,
+                                             uint32_t& update_count) {
+  memcpy(&session, buffer, 4);
+  memcpy(&sequence, buffer + 4, 8);
+  memcpy(&update_count, buffer + 12, 4);
+}
+
+} // namespace common
+
+#endif  // COMMON_PRICE_MULTICAST_PROTOCOL_H_
@@ -0,0 +1,297 @@
+#include "common/price_multicast_receiver.h"
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace common {
+
+namespace {
+
+// Socket buffer holds datagrams while a snapshot is read. (bytes)
+const int kReceiveBufferSize = 4 * 1024 * 1024;
+// Timeout of reading a snapshot. (seconds)
+const int kSnapshotTimeout = 2;
+
+// Split "address:port". Return false if port is missing.
+bool SplitAddress(const std::string& address, std::string& host,
+                  std::string& port) {
+  size_t colon = address.rfind(':');
+  if (colon == std::string::npos || colon + 1 >= address.size())
+    return false;
+  host = address.substr(0, colon);
+  port = address.substr(colon + 1);
+  return true;
+}
+
+// Connect to snapshot service, return socket or -1.
+int ConnectSnapshotService(const std::string& address) {
+  if (address[0] == '/') {
+    struct sockaddr_un un;
+    if (address.size() >= sizeof(un.sun_path))
+      return -1;
+    memset(&un, 0, sizeof(un));
+    un.sun_family = AF_UNIX;
+    strcpy(un.sun_path, address.c_str());
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0 &&
+        connect(fd, reinterpret_cast<struct sockaddr*>(&un), sizeof(un)) !=
+            0) {
+      close(fd);
+      return -1;
+    }
+    return fd;
+  }
+
+  std::string host, port;
+  if (!SplitAddress(address, host, port))
+    return -1;
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo* result = nullptr;
+  if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0)
+    return -1;
+  int fd = -1;
+  for (struct addrinfo* info = result; info != nullptr; info = info->ai_next) {
+    fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+    if (fd < 0)
+      continue;
+    if (connect(fd, info->ai_addr, info->ai_addrlen) == 0)
+      break;
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(result);
+  return fd;
+}
+
+} // namespace
+
+PriceMulticastReceiver::PriceMulticastReceiver()
+    : socket_(-1),
+      synchronized_(false),
+      session_(0),
+      sequence_(0),
+      gap_count_(0),
+      recovery_count_(0),
+      invalid_count_(0) {}
+
+PriceMulticastReceiver::~PriceMulticastReceiver() {
+  Close();
+}
+
+bool PriceMulticastReceiver::Open(const std::string& group,
+                                  const std::string& interface,
+                                  const std::string& snapshot_address) {
+  Close();
+
+  std::string host, port;
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  if (!SplitAddress(group, host, port) ||
+      inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1 ||
+      !IN_MULTICAST(ntohl(address.sin_addr.s_addr)))
+    return false;
+  address.sin_port = htons(atoi(port.c_str()));
+
+  struct ip_mreq membership;
+  membership.imr_multiaddr = address.sin_addr;
+  membership.imr_interface.s_addr = htonl(INADDR_ANY);
+  if (!interface.empty() &&
+      inet_pton(AF_INET, interface.c_str(), &membership.imr_interface) != 1)
+    return false;
+
+  socket_ = socket(AF_INET, SOCK_DGRAM, 0);
+  if (socket_ < 0)
+    return false;
+  // Several receivers on the same host.
+  int reuse = 1;
+  setsockopt(socket_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  int buffer_size = kReceiveBufferSize;
+  setsockopt(socket_, SOL_SOCKET, SO_RCVBUF, &buffer_size,
+             sizeof(buffer_size));
+  // Bound to group address, datagrams of other groups on this port are not
+  // received.
+  if (bind(socket_, reinterpret_cast<struct sockaddr*>(&address),
+           sizeof(address)) != 0 ||
+      setsockopt(socket_, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership,
+                 sizeof(membership)) != 0) {
+    Close();
+    return false;
+  }
+
+  snapshot_address_ = snapshot_address;
+  synchronized_ = false;
+  session_ = 0;
+  sequence_ = 0;
+  gap_count_ = 0;
+  recovery_count_ = 0;
+  invalid_count_ = 0;
+  return true;
+}
+
+void PriceMulticastReceiver::Close() {
+  if (socket_ < 0)
+    return;
+
+  // Membership is dropped with socket.
+  close(socket_);
+  socket_ = -1;
+}
+
+bool PriceMulticastReceiver::Poll(int timeout, const Handler& handler) {
+  if (socket_ < 0)
+    return false;
+
+  struct pollfd poll_fd;
+  poll_fd.fd = socket_;
+  poll_fd.events = POLLIN;
+  int result = poll(&poll_fd, 1, timeout);
+  if (result < 0)
+    return errno == EINTR;
+  if (result == 0)
+    return true;
+
+  char datagram[kPriceMulticastMaxDatagramSize];
+  while (true) {
+    ssize_t size = recv(socket_, datagram, sizeof(datagram), MSG_DONTWAIT);
+    if (size < 0)
+      return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    OnDatagram(datagram, size, handler);
+  }
+}
+
+void PriceMulticastReceiver::OnDatagram(const char* data, size_t size,
+                                        const Handler& handler) {
+  if (size < kPriceMulticastDatagramHeaderSize) {
+    invalid_count_++;
+    return;
+  }
+  uint32_t session = 0;
+  uint64_t sequence = 0;
+  uint16_t update_count = 0;
+  ReadPriceMulticastHeader(data, session, sequence, update_count);
+  // Sequence of datagram before this one, heartbeat repeats last sequence.
+  uint64_t previous = update_count == 0 ? sequence : sequence - 1;
+
+  // First datagram, or publisher is restarted.
+  if (!synchronized_ || session != session_) {
+    if (synchronized_)
+      gap_count_++;
+    if (!Recover(handler) || session != session_) {
+      synchronized_ = true;
+      session_ = session;
+      sequence_ = previous;
+    }
+  }
+
+  if (previous > sequence_) {
+    gap_count_++;
+    // Lost updates are skipped if snapshot is not available.
+    if (!Recover(handler) || session != session_ || previous > sequence_) {
+      session_ = session;
+      sequence_ = previous;
+    }
+  }
+
+  // Heartbeat, duplicate, or already included in snapshot.
+  if (update_count == 0 || sequence <= sequence_)
+    return;
+
+  PriceMulticastUpdate update;
+  size_t offset = kPriceMulticastDatagramHeaderSize;
+  for (uint16_t i = 0; i < update_count; i++) {
+    size_t read_size =
+        ReadPriceMulticastUpdate(data + offset, size - offset, update);
+    if (read_size == 0) {
+      invalid_count_++;
+      break;
+    }
+    offset += read_size;
+    handler(update);
+  }
+  sequence_ = sequence;
+}
+
+bool PriceMulticastReceiver::Recover(const Handler& handler) {
+  std::string snapshot;
+  if (snapshot_address_.empty() || !ReadSnapshot(snapshot) ||
+      snapshot.size() < kPriceMulticastSnapshotHeaderSize)
+    return false;
+
+  uint32_t session = 0;
+  uint64_t sequence = 0;
+  uint32_t update_count = 0;
+  ReadPriceMulticastSnapshotHeader(snapshot.data(), session, sequence,
+                                   update_count);
+  // Count comes from the wire, each update has at least its fixed fields.
+  size_t max_update_count =
+      (snapshot.size() - kPriceMulticastSnapshotHeaderSize) /
+      GetPriceMulticastUpdateSize(PriceMulticastUpdate());
+  if (update_count > max_update_count) {
+    invalid_count_++;
+    return false;
+  }
+
+  // Whole snapshot is checked before any update is applied.
+  std::vector<PriceMulticastUpdate> updates;
+  updates.reserve(update_count);
+  size_t offset = kPriceMulticastSnapshotHeaderSize;
+  for (uint32_t i = 0; i < update_count; i++) {
+    updates.emplace_back();
+    size_t read_size = ReadPriceMulticastUpdate(
+        snapshot.data() + offset, snapshot.size() - offset, updates.back());
+    if (read_size == 0) {
+      invalid_count_++;
+      return false;
+    }
+    offset += read_size;
+  }
+
+  for (auto& update : updates)
+    handler(update);
+  synchronized_ = true;
+  session_ = session;
+  sequence_ = sequence;
+  recovery_count_++;
+  return true;
+}
+
+bool PriceMulticastReceiver::ReadSnapshot(std::string& snapshot) const {
+  int fd = ConnectSnapshotService(snapshot_address_);
+  if (fd < 0)
+    return false;
+  struct timeval timeout = {kSnapshotTimeout, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  // Service closes connection after snapshot.
+  char buffer[65536];
+  while (true) {
+    ssize_t size = read(fd, buffer, sizeof(buffer));
+    if (size == 0)
+      break;
+    if (size < 0) {
+      if (errno == EINTR)
+        continue;
+      close(fd);
+      return false;
+    }
+    snapshot.append(buffer, size);
+  }
+  close(fd);
+  return true;
+}
+
+} // namespace common
@@ -0,0 +1,75 @@
+#ifndef COMMON_PRICE_MULTICAST_RECEIVER_H_
+#define COMMON_PRICE_MULTICAST_RECEIVER_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include "common/price_multicast_protocol.h"
+
+namespace common {
+
+// Receive prices from multicast price feed of PE.
+// Usage:
+//    common::PriceMulticastReceiver receiver;
+//    receiver.Open("239.1.1.1:9200", "", "/var/run/pe_snapshot.sock");
+//    while (receiver.Poll(1000, [](const common::PriceMulticastUpdate& u) {
+//      ...
+//    }));
+// First datagram and every gap (lost datagrams, restart of publisher) are
+// recovered from snapshot service: latest update of all symbols is passed to
+// handler, then feed continues after the snapshot. Datagrams which arrive
+// meanwhile wait in socket buffer, so nothing is missed. Without snapshot
+// service, lost updates are only counted.
+// A receiver must be used by one thread only.
+class PriceMulticastReceiver {
+public:
+  typedef std::function<void(const PriceMulticastUpdate&)> Handler;
+
+  PriceMulticastReceiver();
+  virtual ~PriceMulticastReceiver();
+
+  PriceMulticastReceiver(const PriceMulticastReceiver&) = delete;
+  PriceMulticastReceiver& operator=(const PriceMulticastReceiver&) = delete;
+
+  // Join multicast |group| ("address:port") on interface |interface| (local
+  // IPv4 address, default interface if empty). |snapshot_address| is
+  // "host:port" or path of unix socket, empty if not used.
+  bool Open(const std::string& group, const std::string& interface,
+            const std::string& snapshot_address);
+  void Close();
+
+  // Wait at most |timeout| milliseconds for datagrams, and pass their updates
+  // to |handler|. Return false if socket failed.
+  bool Poll(int timeout, const Handler& handler);
+
+  // For polling together with other sockets.
+  int GetSocket() const { return socket_; }
+  // Sequence of last applied datagram (or snapshot).
+  uint64_t GetSequence() const { return sequence_; }
+  // Number of detected gaps, and gaps which are recovered by snapshot.
+  uint64_t GetGapCount() const { return gap_count_; }
+  uint64_t GetRecoveryCount() const { return recovery_count_; }
+  uint64_t GetInvalidCount() const { return invalid_count_; }
+
+private:
+  void OnDatagram(const char* data, size_t size, const Handler& handler);
+  // Apply snapshot from snapshot service. Return false if failed.
+  bool Recover(const Handler& handler);
+  // Read whole snapshot. Return false if failed.
+  bool ReadSnapshot(std::string& snapshot) const;
+
+  int socket_;
+  std::string snapshot_address_;
+
+  bool synchronized_;
+  uint32_t session_;
+  uint64_t sequence_;
+
+  uint64_t gap_count_;
+  uint64_t recovery_count_;
+  uint64_t invalid_count_;
+};
+
+} // namespace common
+
+#endif  // COMMON_PRICE_MULTICAST_RECEIVER_H_
@@ -0,0 +1,107 @@
+#ifndef COMMON_PRICE_STREAM_PROTOCOL_H_
+#define COMMON_PRICE_STREAM_PROTOCOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "common/decimal.h"
+
+// Wire protocol of price stream server (see |PriceStreamServer|), shared
+// with downstream consumers. Both directions are a stream of frames:
+//
+//   | length (uint32) | type (uint8) | payload |
+//
+// |length| counts type and payload. Integers and doubles are in little-endian
+// byte order (native byte order of x86/arm hosts).
+//
+// Client -> server:
+// - SUBSCRIBE: symbol names, each is | length (uint8) | name |. No name
+//   means all symbols (including symbols which appear later). Server replies
+//   with a snapshot: SYMBOL and latest UPDATE of each subscribed symbol which
+//   has a price, then SNAPSHOT_END. Symbols which are not published yet are
+//   subscribed when they appear. Frames of a client are not read while its
+//   output is backed up.
+// - UNSUBSCRIBE: same payload, no name means all symbols.
+//
+// Server -> client:
+// - SYMBOL: | symbol id (uint32) | length (uint8) | name |, sent before first
+//   UPDATE of a symbol.
+// - UPDATE: |PriceStreamUpdate|, fields in order without padding. Fair value
+//   is exact: | mantissa (int64) | scale (uint8) | (see |common::Decimal|).
+//   Updates of a slow client are conflated (it only gets latest price of
+//   each symbol), |sequence| tells how many updates were skipped.
+// - SNAPSHOT_END: no payload.
+
+namespace common {
+
+const size_t kPriceStreamFrameHeaderSize = 5;
+// Frames longer than this are invalid, connection is closed.
+const uint32_t kPriceStreamMaxFrameLength = 65536;
+const size_t kPriceStreamMaxSymbolNameSize = 255;
+
+enum PriceStreamClientMessage {
+  PRICE_STREAM_SUBSCRIBE = 1,
+  PRICE_STREAM_UNSUBSCRIBE = 2
+};
+
+enum PriceStreamServerMessage {
+  PRICE_STREAM_SYMBOL = 1,
+  PRICE_STREAM_UPDATE = 2,
+  PRICE_STREAM_SNAPSHOT_END = 3
+};
+
+// Payload of UPDATE.
+struct PriceStreamUpdate {
+  uint32_t symbol_id;
+  // Number of updates of this symbol, starts from 1.
+  uint64_t sequence;
+  // Wall clock, milliseconds since unix epoch.
+  uint64_t timestamp;
+  Decimal fair_value;
+  double moving_average;
+  double standard_deviation_ratio;
+};
+
+// Size of UPDATE payload on the wire (fields are not padded).
+const size_t kPriceStreamUpdateSize = 45;
+
+// Write frame header of |type| with |payload_size| to |buffer|.
+inline void WritePriceStreamHeader(uint8_t type, size_t payload_size,
+                                   char* buffer) {
+  uint32_t length = static_cast<uint32_t>(payload_size + 1);
+  memcpy(buffer, &length, sizeof(length));
+  buffer[4] = static_cast<char>(type);
+}
+
+// Write whole UPDATE frame of |update| to |buffer|, which has room for
+// |kPriceStreamFrameHeaderSize| + |kPriceStreamUpdateSize| bytes.
+inline void WritePriceStreamUpdate(const PriceStreamUpdate& update,
+                                   char* buffer) {
+  WritePriceStreamHeader(PRICE_STREAM_UPDATE, kPriceStreamUpdateSize, buffer);
+  char* out = buffer + kPriceStreamFrameHeaderSize;
+  memcpy(out, &update.symbol_id, 4);
+  memcpy(out + 4, &update.sequence, 8);
+  int64_t mantissa = update.fair_value.mantissa();
+  memcpy(out + 12, &update.timestamp, 8);
+  memcpy(out + 20, &mantissa, 8);
+  out[28] = static_cast<char>(update.fair_value.scale());
+  memcpy(out + 29, &update.moving_average, 8);
+  memcpy(out + 37, &update.standard_deviation_ratio, 8);
+}
+
+// Read UPDATE payload (|kPriceStreamUpdateSize| bytes) into |update|.
+inline void ReadPriceStreamUpdate(const char* payload,
+                                  PriceStreamUpdate& update) {
+  memcpy(&update.symbol_id, payload, 4);
+  memcpy(&update.sequence, payload + 4, 8);
+  int64_t mantissa = 0;
+  memcpy(&update.timestamp, payload + 12, 8);
+  memcpy(&mantissa, payload + 20, 8);
+  update.fair_value = Decimal(mantissa, static_cast<uint8_t>(payload[28]));
+  memcpy(&update.moving_average, payload + 29, 8);
+  memcpy(&update.standard_deviation_ratio, payload + 37, 8);
+}
+
+} // namespace common
+
+#endif  // COMMON_PRICE_STREAM_PROTOCOL_H_
@@ -0,0 +1,83 @@
+#ifndef COMMON_SHM_PRICE_LAYOUT_H_
+#define COMMON_SHM_PRICE_LAYOUT_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Memory layout of shared memory price buffer, shared between writer (PE) and
+// readers (co-located consumers).
+//
+//   | ShmPriceHeader | ShmPriceSlot x max_symbols | ShmPriceEntry x ring_size |
+//
+// - Each slot keeps the latest price of a symbol (symbol id = slot index).
+//   Slot of a removed symbol is cleared (empty name), and can be given to
+//   another symbol later, so readers check name of records.
+// - Ring keeps the stream of all updates, in order of writing.
+// Both slots and ring entries are protected by seqlocks: sequence is odd while
+// writing, readers retry (slot) or skip (ring) if sequence changed.
+
+namespace common {
+
+const uint32_t kShmPriceMagic = 0x48534550;  // "PESH"
+// 2: fair value is exact (mantissa and scale).
+const uint32_t kShmPriceVersion = 2;
+// Including terminating '\0', longer names are not registered.
+const size_t kShmSymbolNameSize = 16;
+
+struct ShmPriceRecord {
+  uint32_t symbol_id;
+  char symbol_name[kShmSymbolNameSize];
+  // Number of updates of this symbol.
+  uint64_t sequence;
+  // Wall clock, milliseconds since unix epoch.
+  uint64_t timestamp;
+  // Fair value = mantissa / 10^scale, exact (see |common::Decimal| and
+  // |ShmPriceReader::GetFairValue()|).
+  int64_t fair_value_mantissa;
+  uint8_t fair_value_scale;
+  double moving_average;
+  double standard_deviation_ratio;
+};
+
+struct alignas(64) ShmPriceSlot {
+  std::atomic<uint64_t> seqlock;
+  ShmPriceRecord record;
+};
+
+struct alignas(64) ShmPriceEntry {
+  // 2 * index + 1 while writing, 2 * index + 2 after written, which |index|
+  // is position of entry in stream.
+  std::atomic<uint64_t> seqlock;
+  ShmPriceRecord record;
+};
+
+struct alignas(64) ShmPriceHeader {
+  // Written last when initializing, readers must check it.
+  std::atomic<uint32_t> magic;
+  uint32_t version;
+  uint32_t max_symbols;
+  uint32_t ring_size;
+  std::atomic<uint32_t> symbol_count;
+  // Position of next entry which is written to ring.
+  alignas(64) std::atomic<uint64_t> write_index;
+};
+
+inline size_t GetShmPriceBufferSize(uint32_t max_symbols, uint32_t ring_size) {
+  return sizeof(ShmPriceHeader) +
+         sizeof(ShmPriceSlot) * max_symbols +
+         sizeof(ShmPriceEntry) * ring_size;
+}
+
+inline ShmPriceSlot* GetShmPriceSlots(ShmPriceHeader* header) {
+  return reinterpret_cast<ShmPriceSlot*>(header + 1);
+}
+
+inline ShmPriceEntry* GetShmPriceRing(ShmPriceHeader* header) {
+  return reinterpret_cast<ShmPriceEntry*>(
+      GetShmPriceSlots(header) + header->max_symbols);
+}
+
+} // namespace common
+
+#endif  // COMMON_SHM_PRICE_LAYOUT_H_
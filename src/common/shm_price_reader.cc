@@ -0,0 +1,151 @@
+#include "common/shm_price_reader.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstring>
+
+namespace common {
+
+ShmPriceReader::ShmPriceReader()
+    : header_(nullptr), size_(0), read_index_(0), lost_count_(0) {}
+
+ShmPriceReader::~ShmPriceReader() {
+  Close();
+}
+
+bool ShmPriceReader::Open(const std::string& name) {
+  Close();
+
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0)
+    return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      static_cast<size_t>(st.st_size) < sizeof(ShmPriceHeader)) {
+    close(fd);
+    return false;
+  }
+
+  void* address = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (address == MAP_FAILED)
+    return false;
+
+  header_ = static_cast<ShmPriceHeader*>(address);
+  size_ = st.st_size;
+
+  // Writer may be initializing buffer, or buffer is written by another
+  // version of PE.
+  if (header_->magic.load(std::memory_order_acquire) != kShmPriceMagic ||
+      header_->version != kShmPriceVersion ||
+      size_ < GetShmPriceBufferSize(header_->max_symbols,
+                                    header_->ring_size)) {
+    Close();
+    return false;
+  }
+
+  read_index_ = header_->write_index.load(std::memory_order_acquire);
+  lost_count_ = 0;
+  return true;
+}
+
+void ShmPriceReader::Close() {
+  if (header_ == nullptr)
+    return;
+
+  munmap(header_, size_);
+  header_ = nullptr;
+  size_ = 0;
+}
+
+uint32_t ShmPriceReader::GetSymbolCount() const {
+  if (header_ == nullptr)
+    return 0;
+
+  return header_->symbol_count.load(std::memory_order_acquire);
+}
+
+int ShmPriceReader::FindSymbol(const std::string& symbol_name) const {
+  // Writer does not register longer names (see |kShmSymbolNameSize|).
+  if (header_ == nullptr || symbol_name.empty() ||
+      symbol_name.size() >= kShmSymbolNameSize)
+    return -1;
+
+  uint32_t count = GetSymbolCount();
+  ShmPriceSlot* slots = GetShmPriceSlots(header_);
+  for (uint32_t i = 0; i < count; i++) {
+    if (strncmp(slots[i].record.symbol_name, symbol_name.c_str(),
+                kShmSymbolNameSize) == 0)
+      return i;
+  }
+
+  return -1;
+}
+
+bool ShmPriceReader::GetLatest(int symbol_id, ShmPriceRecord& record) const {
+  if (symbol_id < 0 ||
+      static_cast<uint32_t>(symbol_id) >= GetSymbolCount())
+    return false;
+
+  const ShmPriceSlot& slot = GetShmPriceSlots(header_)[symbol_id];
+  while (true) {
+    uint64_t begin = slot.seqlock.load(std::memory_order_acquire);
+    // Not written yet.
+    if (begin == 0)
+      return false;
+    // Writer is updating this slot.
+    if (begin & 1)
+      continue;
+
+    memcpy(&record, &slot.record, sizeof(ShmPriceRecord));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    // Cleared slot, or not written since it is given to a symbol.
+    if (slot.seqlock.load(std::memory_order_relaxed) == begin)
+      return record.symbol_name[0] != '\0' && record.sequence > 0;
+  }
+}
+
+bool ShmPriceReader::Poll(ShmPriceRecord& record) {
+  if (header_ == nullptr)
+    return false;
+
+  ShmPriceEntry* ring = GetShmPriceRing(header_);
+  uint32_t ring_size = header_->ring_size;
+  while (true) {
+    uint64_t write_index =
+        header_->write_index.load(std::memory_order_acquire);
+    if (read_index_ >= write_index)
+      return false;
+
+    // Skip entries which are overwritten.
+    if (write_index - read_index_ > ring_size) {
+      lost_count_ += write_index - ring_size - read_index_;
+      read_index_ = write_index - ring_size;
+    }
+
+    const ShmPriceEntry& entry = ring[read_index_ % ring_size];
+    uint64_t expected = 2 * read_index_ + 2;
+    uint64_t begin = entry.seqlock.load(std::memory_order_acquire);
+    // Position is claimed but writer has not finished writing yet.
+    if (begin < expected)
+      return false;
+
+    if (begin == expected) {
+      memcpy(&record, &entry.record, sizeof(ShmPriceRecord));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (entry.seqlock.load(std::memory_order_relaxed) == expected) {
+        read_index_++;
+        return true;
+      }
+    }
+
+    // Entry is overwritten by a newer update while reading.
+    lost_count_++;
+    read_index_++;
+  }
+}
+
+} // namespace common
@@ -0,0 +1,69 @@
+#ifndef COMMON_SHM_PRICE_READER_H_
+#define COMMON_SHM_PRICE_READER_H_
+
+#include <string>
+#include "common/decimal.h"
+#include "common/shm_price_layout.h"
+
+namespace common {
+
+// Read prices from shared memory buffer written by PE.
+// Usage:
+//    common::ShmPriceReader reader;
+//    reader.Open("/pe_prices");
+//    // Latest price of a symbol.
+//    common::ShmPriceRecord record;
+//    int id = reader.FindSymbol("ethbtc");
+//    if (reader.GetLatest(id, record))
+//      common::Decimal price = common::ShmPriceReader::GetFairValue(record);
+//    // Or all updates, in order.
+//    while (reader.Poll(record)) ...
+// A reader must be used by one thread only.
+class ShmPriceReader {
+public:
+  ShmPriceReader();
+  virtual ~ShmPriceReader();
+
+  ShmPriceReader(const ShmPriceReader&) = delete;
+  ShmPriceReader& operator=(const ShmPriceReader&) = delete;
+
+  // Map shared memory object |name|. Stream is read from current position.
+  bool Open(const std::string& name);
+  void Close();
+
+  // Number of symbols registered by writer.
+  uint32_t GetSymbolCount() const;
+
+  // Return id of |symbol_name|, -1 if not registered (yet).
+  int FindSymbol(const std::string& symbol_name) const;
+
+  // Copy latest price of |symbol_id| into |record|.
+  // Return false if symbol is not registered or has no price yet. Symbol of
+  // an id can be removed and its id given to another symbol, check
+  // |record.symbol_name|.
+  bool GetLatest(int symbol_id, ShmPriceRecord& record) const;
+
+  // Get next update in stream. Return false if there is no new update.
+  // If reader is too slow and updates are overwritten, they are skipped and
+  // counted in |GetLostCount()|.
+  bool Poll(ShmPriceRecord& record);
+
+  uint64_t GetLostCount() const { return lost_count_; }
+
+  // Exact fair value of |record|.
+  static Decimal GetFairValue(const ShmPriceRecord& record) {
+    return Decimal(record.fair_value_mantissa, record.fair_value_scale);
+  }
+
+private:
+  ShmPriceHeader* header_;
+  size_t size_;
+
+  // Position of next entry to read in stream.
+  uint64_t read_index_;
+  uint64_t lost_count_;
+};
+
+} // namespace common
+
+#endif  // COMMON_SHM_PRICE_READER_H_
@@ -0,0 +1,200 @@
+#include "common/shm_price_writer.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include "glog/logging.h"
+
+namespace common {
+
+namespace {
+
+void CopyRecord(const ShmPriceRecord& from, ShmPriceRecord& to) {
+  memcpy(&to, &from, sizeof(ShmPriceRecord));
+}
+
+// Give |slot| to symbol |symbol_name| (cleared if empty), readers may be
+// reading it.
+void ResetSlot(ShmPriceSlot& slot, uint32_t symbol_id,
+               const std::string& symbol_name) {
+  uint64_t seq = slot.seqlock.load(std::memory_order_relaxed);
+  slot.seqlock.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  memset(&slot.record, 0, sizeof(ShmPriceRecord));
+  slot.record.symbol_id = symbol_id;
+  memcpy(slot.record.symbol_name, symbol_name.data(), symbol_name.size());
+  slot.seqlock.store(seq + 2, std::memory_order_release);
+}
+
+} // namespace
+
+ShmPriceWriter::ShmPriceWriter() : header_(nullptr), size_(0) {}
+
+ShmPriceWriter::~ShmPriceWriter() {
+  Close();
+}
+
+bool ShmPriceWriter::Open(const std::string& name,
+                          uint32_t max_symbols,
+                          uint32_t ring_size) {
+  Close();
+  if (max_symbols == 0 || ring_size == 0)
+    return false;
+
+  // Always re-create object, readers which are mapping old object keep
+  // working with it until they re-open.
+  shm_unlink(name.c_str());
+  int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+  if (fd < 0) {
+    LOG(ERROR) << "Cannot create shared memory " << name << ": "
+               << strerror(errno);
+    return false;
+  }
+
+  size_t size = GetShmPriceBufferSize(max_symbols, ring_size);
+  if (ftruncate(fd, size) != 0) {
+    LOG(ERROR) << "Cannot resize shared memory " << name << ": "
+               << strerror(errno);
+    close(fd);
+    return false;
+  }
+
+  void* address =
+      mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (address == MAP_FAILED) {
+    LOG(ERROR) << "Cannot map shared memory " << name << ": "
+               << strerror(errno);
+    return false;
+  }
+
+  // Memory of new object is zero-filled, just construct header.
+  header_ = new (address) ShmPriceHeader();
+  header_->version = kShmPriceVersion;
+  header_->max_symbols = max_symbols;
+  header_->ring_size = ring_size;
+  header_->symbol_count.store(0, std::memory_order_relaxed);
+  header_->write_index.store(0, std::memory_order_relaxed);
+  header_->magic.store(kShmPriceMagic, std::memory_order_release);
+
+  name_ = name;
+  size_ = size;
+  LOG(INFO) << "Shared memory price buffer " << name << " is created: "
+            << max_symbols << " symbols, " << ring_size << " entries.";
+  return true;
+}
+
+void ShmPriceWriter::Close() {
+  if (header_ == nullptr)
+    return;
+
+  munmap(header_, size_);
+  shm_unlink(name_.c_str());
+  header_ = nullptr;
+  size_ = 0;
+  symbol_ids_.clear();
+  reference_counts_.clear();
+  free_ids_.clear();
+}
+
+int ShmPriceWriter::RegisterSymbol(const std::string& symbol_name) {
+  std::lock_guard<std::mutex> lock(register_mutex_);
+  if (header_ == nullptr)
+    return -1;
+
+  auto it = symbol_ids_.find(symbol_name);
+  if (it != symbol_ids_.end()) {
+    reference_counts_[it->second]++;
+    return it->second;
+  }
+
+  // Readers find symbols by whole name.
+  if (symbol_name.empty() || symbol_name.size() >= kShmSymbolNameSize) {
+    LOG(ERROR) << "Symbol name is too long for shared memory price buffer ("
+               << kShmSymbolNameSize - 1 << " characters at most), cannot "
+               << "register " << symbol_name;
+    return -1;
+  }
+
+  uint32_t id = 0;
+  if (!free_ids_.empty()) {
+    id = free_ids_.back();
+    free_ids_.pop_back();
+    ResetSlot(GetShmPriceSlots(header_)[id], id, symbol_name);
+  } else {
+    id = header_->symbol_count.load(std::memory_order_relaxed);
+    if (id >= header_->max_symbols) {
+      LOG(ERROR) << "Shared memory price buffer is full, cannot register "
+                 << symbol_name;
+      return -1;
+    }
+
+    // Name is written before |symbol_count| is increased, so readers always
+    // see name of registered symbols.
+    ShmPriceRecord& record = GetShmPriceSlots(header_)[id].record;
+    record.symbol_id = id;
+    memcpy(record.symbol_name, symbol_name.data(), symbol_name.size());
+    header_->symbol_count.store(id + 1, std::memory_order_release);
+    reference_counts_.push_back(0);
+  }
+
+  reference_counts_[id] = 1;
+  symbol_ids_[symbol_name] = id;
+  return id;
+}
+
+void ShmPriceWriter::UnregisterSymbol(int symbol_id) {
+  std::lock_guard<std::mutex> lock(register_mutex_);
+  if (header_ == nullptr || symbol_id < 0 ||
+      static_cast<size_t>(symbol_id) >= reference_counts_.size() ||
+      reference_counts_[symbol_id] == 0)
+    return;
+  if (--reference_counts_[symbol_id] > 0)
+    return;
+
+  ShmPriceSlot& slot = GetShmPriceSlots(header_)[symbol_id];
+  symbol_ids_.erase(std::string(
+      slot.record.symbol_name,
+      strnlen(slot.record.symbol_name, kShmSymbolNameSize)));
+  ResetSlot(slot, symbol_id, std::string());
+  free_ids_.push_back(symbol_id);
+}
+
+void ShmPriceWriter::Write(int symbol_id,
+                           uint64_t timestamp,
+                           const Decimal& fair_value,
+                           double moving_average,
+                           double standard_deviation_ratio) {
+  if (header_ == nullptr || symbol_id < 0 ||
+      static_cast<uint32_t>(symbol_id) >= header_->max_symbols)
+    return;
+
+  // Latest price slot. Only one thread writes a symbol, so no need to use
+  // read-modify-write operations here.
+  ShmPriceSlot& slot = GetShmPriceSlots(header_)[symbol_id];
+  uint64_t seq = slot.seqlock.load(std::memory_order_relaxed);
+  slot.seqlock.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.record.sequence++;
+  slot.record.timestamp = timestamp;
+  slot.record.fair_value_mantissa = fair_value.mantissa();
+  slot.record.fair_value_scale = static_cast<uint8_t>(fair_value.scale());
+  slot.record.moving_average = moving_average;
+  slot.record.standard_deviation_ratio = standard_deviation_ratio;
+  slot.seqlock.store(seq + 2, std::memory_order_release);
+
+  // Update stream. Many threads can write into ring at the same time, each
+  // one claims its own position.
+  uint64_t index =
+      header_->write_index.fetch_add(1, std::memory_order_relaxed);
+  ShmPriceEntry& entry = GetShmPriceRing(header_)[index % header_->ring_size];
+  entry.seqlock.store(2 * index + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  CopyRecord(slot.record, entry.record);
+  entry.seqlock.store(2 * index + 2, std::memory_order_release);
+}
+
+} // namespace common
@@ -0,0 +1,58 @@
+#ifndef COMMON_SHM_PRICE_WRITER_H_
+#define COMMON_SHM_PRICE_WRITER_H_
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "common/decimal.h"
+#include "common/shm_price_layout.h"
+
+namespace common {
+
+// Write prices to shared memory buffer (see shm_price_layout.h).
+// A writer can be shared between threads, as long as each symbol is only
+// written by one thread.
+class ShmPriceWriter {
+public:
+  ShmPriceWriter();
+  virtual ~ShmPriceWriter();
+
+  ShmPriceWriter(const ShmPriceWriter&) = delete;
+  ShmPriceWriter& operator=(const ShmPriceWriter&) = delete;
+
+  // Create (or re-create) shared memory object |name| (ex: "/pe_prices").
+  bool Open(const std::string& name, uint32_t max_symbols, uint32_t ring_size);
+  void Close();
+
+  // Get id of |symbol_name|, register it if necessary (each call must be
+  // paired with |UnregisterSymbol()|). Return -1 if buffer is full or not
+  // opened, or name is longer than |kShmSymbolNameSize| - 1.
+  int RegisterSymbol(const std::string& symbol_name);
+  // Release |symbol_id|, its slot is cleared and reused when it is not
+  // registered anymore. Symbol must not be written after that.
+  void UnregisterSymbol(int symbol_id);
+
+  // Update latest price of symbol and append it to update stream.
+  void Write(int symbol_id,
+             uint64_t timestamp,
+             const Decimal& fair_value,
+             double moving_average,
+             double standard_deviation_ratio);
+
+private:
+  std::string name_;
+  ShmPriceHeader* header_;
+  size_t size_;
+
+  // Protect symbol registration.
+  std::mutex register_mutex_;
+  std::map<std::string, int> symbol_ids_;
+  // Number of registrations of each id, ids of cleared slots.
+  std::vector<uint32_t> reference_counts_;
+  std::vector<uint32_t> free_ids_;
+};
+
+} // namespace common
+
+#endif  // COMMON_SHM_PRICE_WRITER_H_
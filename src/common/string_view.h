@@ -0,0 +1,48 @@
+#ifndef COMMON_STRING_VIEW_H_
+#define COMMON_STRING_VIEW_H_
+
+#include <cstddef>
+#include <cstring>
+#include <ostream>
+#include <string>
+
+namespace common {
+
+// Non-owning reference to characters (like std::string_view, which is not
+// available in C++11). Used to read strings in place (ex: inside redis
+// replies) without copying them. Referred memory must outlive the view.
+class StringView {
+public:
+  StringView() : data_(nullptr), size_(0) {}
+  StringView(const char* data, size_t size) : data_(data), size_(size) {}
+  StringView(const char* str)
+      : data_(str), size_(str != nullptr ? strlen(str) : 0) {}
+  StringView(const std::string& str) : data_(str.data()), size_(str.size()) {}
+
+  const char* data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  const char* begin() const { return data_; }
+  const char* end() const { return data_ + size_; }
+  char operator[](size_t i) const { return data_[i]; }
+
+  std::string ToString() const { return std::string(data_, size_); }
+
+  bool operator==(StringView other) const {
+    return size_ == other.size_ &&
+           (size_ == 0 || memcmp(data_, other.data_, size_) == 0);
+  }
+  bool operator!=(StringView other) const { return !(*this == other); }
+
+private:
+  const char* data_;
+  size_t size_;
+};
+
+inline std::ostream& operator<<(std::ostream& os, StringView view) {
+  return os.write(view.data(), view.size());
+}
+
+} // namespace common
+
+#endif  // COMMON_STRING_VIEW_H_
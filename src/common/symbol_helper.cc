@@ -10,9 +10,4 @@ std::string GetCodeFromSymbol(const std::string& symbol, int pos) {
   return pos == 1 ? symbol.substr(0, 3) : symbol.substr(3, 3);
 }
 
-uint64_t GetCurrentTimestamp() {
-  using std::chrono::system_clock;
-  return static_cast<uint64_t>(system_clock::to_time_t(system_clock::now()));
-}
-
 } // namespace common
\ No newline at end of file
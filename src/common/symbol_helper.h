@@ -9,8 +9,6 @@ namespace common {
 // |pos| is position of code in symbol, 1 mean first code, 2 mean second code.
 std::string GetCodeFromSymbol(const std::string& symbol, int pos);
 
-uint64_t GetCurrentTimestamp();
-
 } // namespace common
 
 #endif  // COMMON_SYMBOL_HELPER_H_
\ No newline at end of file
@@ -0,0 +1,92 @@
+#include "common/thread_helper.h"
+
+#include <pthread.h>
+#if defined(__linux__)
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include <cerrno>
+#include <cstring>
+#include "glog/logging.h"
+
+namespace common {
+
+bool SetCurrentThreadAffinity(int cpu) {
+#if defined(__linux__)
+  if (cpu < 0)
+    return false;
+
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  CPU_SET(cpu, &cpu_set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) == 0;
+#else
+  // macOS does not support pinning a thread to a specific core.
+  return false;
+#endif
+}
+
+bool SetCurrentThreadRealtimePriority(int priority) {
+#if defined(__linux__)
+  struct sched_param param;
+  memset(&param, 0, sizeof(param));
+  param.sched_priority = priority;
+  int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+  // Report error by |errno|, like |SetCurrentThreadNice()|.
+  if (error != 0)
+    errno = error;
+  return error == 0;
+#else
+  return false;
+#endif
+}
+
+bool SetCurrentThreadNice(int nice) {
+#if defined(__linux__)
+  // Nice value is per thread on Linux (not POSIX), set by thread id.
+  pid_t tid = static_cast<pid_t>(syscall(SYS_gettid));
+  return setpriority(PRIO_PROCESS, tid, nice) == 0;
+#else
+  return false;
+#endif
+}
+
+void ConfigureCurrentThread(const std::string& name,
+                            int cpu,
+                            int realtime_priority,
+                            int nice) {
+  if (cpu >= 0) {
+    if (SetCurrentThreadAffinity(cpu))
+      LOG(INFO) << name << " is pinned to cpu " << cpu << ".";
+    else
+      LOG(ERROR) << "Cannot pin " << name << " to cpu " << cpu << ".";
+  }
+
+  if (realtime_priority > 0) {
+    if (SetCurrentThreadRealtimePriority(realtime_priority))
+      LOG(INFO) << name << " runs at real-time priority "
+                << realtime_priority << ".";
+    else
+      LOG(ERROR) << "Cannot set real-time priority " << realtime_priority
+                 << " of " << name << ": " << strerror(errno);
+  } else if (nice != 0) {
+    if (SetCurrentThreadNice(nice))
+      LOG(INFO) << name << " runs at nice " << nice << ".";
+    else
+      LOG(ERROR) << "Cannot set nice " << nice << " of " << name << ": "
+                 << strerror(errno);
+  }
+}
+
+void SetCurrentThreadName(const std::string& name) {
+#if defined(__linux__)
+  // Linux limits thread name to 16 characters (include '\0').
+  pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+#elif defined(__APPLE__)
+  pthread_setname_np(name.c_str());
+#endif
+}
+
+} // namespace common
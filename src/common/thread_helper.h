@@ -0,0 +1,44 @@
+#ifndef COMMON_THREAD_HELPER_H_
+#define COMMON_THREAD_HELPER_H_
+
+#include <string>
+
+namespace common {
+
+// Pin calling thread to cpu core |cpu|.
+// Return false if failed or not supported on this platform.
+bool SetCurrentThreadAffinity(int cpu);
+
+// Run calling thread by real-time scheduler (SCHED_FIFO) at |priority|
+// (1-99). Needs CAP_SYS_NICE or RLIMIT_RTPRIO.
+// Return false if failed or not supported on this platform.
+bool SetCurrentThreadRealtimePriority(int priority);
+
+// Set nice value (-20 to 19) of calling thread only. Negative values need
+// CAP_SYS_NICE. Return false if failed or not supported on this platform.
+bool SetCurrentThreadNice(int nice);
+
+// Apply scheduling settings to calling thread (|name| is used in logs):
+// pin it to |cpu| if it is not negative, then run it by real-time scheduler
+// if |realtime_priority| is positive, otherwise set |nice| if it is not 0.
+void ConfigureCurrentThread(const std::string& name,
+                            int cpu,
+                            int realtime_priority,
+                            int nice);
+
+// Set name of calling thread (shown in top, gdb, etc.).
+void SetCurrentThreadName(const std::string& name);
+
+// Tell cpu that calling thread is spinning on a condition (PAUSE on x86),
+// saves power and lets sibling hyper-thread run.
+inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield" ::: "memory");
+#endif
+}
+
+} // namespace common
+
+#endif  // COMMON_THREAD_HELPER_H_
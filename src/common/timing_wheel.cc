@@ -0,0 +1,166 @@
+#include "common/timing_wheel.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace common {
+
+const int TimingWheel::kLevelNumber;
+const int TimingWheel::kSlotBits;
+const int TimingWheel::kSlotNumber;
+const uint64_t TimingWheel::kSlotMask;
+
+TimingWheel::TimingWheel(uint64_t current_tick) {
+  Reset(current_tick);
+}
+
+void TimingWheel::Reset(uint64_t current_tick) {
+  current_tick_ = current_tick;
+  item_number_ = 0;
+  nodes_.clear();
+  for (int level = 0; level < kLevelNumber; level++) {
+    std::fill(heads_[level], heads_[level] + kSlotNumber, -1);
+    occupied_[level] = 0;
+  }
+}
+
+void TimingWheel::Schedule(uint32_t id, uint64_t expire_tick) {
+  if (id >= nodes_.size()) {
+    Node node;
+    node.level = -1;
+    nodes_.resize(id + 1, node);
+  }
+  if (IsScheduled(id))
+    Unlink(id);
+
+  // Delay is at least 1 tick, and is limited by the highest level.
+  const uint64_t max_delay = (1ULL << (kSlotBits * kLevelNumber)) - 1;
+  expire_tick = std::max(expire_tick, current_tick_ + 1);
+  expire_tick = std::min(expire_tick, current_tick_ + max_delay);
+  nodes_[id].expire_tick = expire_tick;
+  Insert(id);
+}
+
+void TimingWheel::Cancel(uint32_t id) {
+  if (IsScheduled(id))
+    Unlink(id);
+}
+
+void TimingWheel::Advance(uint64_t tick, std::vector<uint32_t>& expired) {
+  while (current_tick_ < tick) {
+    if (item_number_ == 0) {
+      current_tick_ = tick;
+      return;
+    }
+
+    // Level 0 slots of ticks (current_tick_, limit] in current window.
+    uint64_t limit = std::min(tick, current_tick_ | kSlotMask);
+    while (current_tick_ < limit) {
+      uint64_t first = (current_tick_ + 1) & kSlotMask;
+      uint64_t last = limit & kSlotMask;
+      uint64_t bits = occupied_[0] & (~0ULL << first) &
+                      (~0ULL >> (kSlotMask - last));
+      if (bits == 0) {
+        current_tick_ = limit;
+        break;
+      }
+      current_tick_ = (current_tick_ & ~kSlotMask) | __builtin_ctzll(bits);
+      ExpireCurrentSlot(expired);
+    }
+    if (current_tick_ == tick)
+      return;
+
+    // Start of next window: move items of higher levels whose time comes
+    // (highest first, they may be moved into a slot which is cascaded
+    // next), then expire items of first slot.
+    current_tick_++;
+    for (int level = kLevelNumber - 1; level > 0; level--) {
+      uint64_t level_mask = (1ULL << (kSlotBits * level)) - 1;
+      if ((current_tick_ & level_mask) == 0)
+        Cascade(level, (current_tick_ >> (kSlotBits * level)) & kSlotMask);
+    }
+    ExpireCurrentSlot(expired);
+  }
+}
+
+uint64_t TimingWheel::GetNextTick() const {
+  if (item_number_ == 0)
+    return std::numeric_limits<uint64_t>::max();
+
+  // Next item in current window of level 0.
+  uint64_t slot = current_tick_ & kSlotMask;
+  if (slot < kSlotMask) {
+    uint64_t bits = occupied_[0] & (~0ULL << (slot + 1));
+    if (bits != 0)
+      return (current_tick_ & ~kSlotMask) | __builtin_ctzll(bits);
+  }
+
+  // Other items of level 0 are in next window. Items of higher levels may
+  // be cascaded at start of next window.
+  uint64_t next_window = (current_tick_ | kSlotMask) + 1;
+  if ((occupied_[1] | occupied_[2] | occupied_[3]) == 0 && occupied_[0] != 0)
+    return next_window | __builtin_ctzll(occupied_[0]);
+  return next_window;
+}
+
+void TimingWheel::Insert(uint32_t id) {
+  Node& node = nodes_[id];
+  uint64_t delay = node.expire_tick - current_tick_;
+  int level = 0;
+  while (level < kLevelNumber - 1 &&
+         delay >= (1ULL << (kSlotBits * (level + 1))))
+    level++;
+  uint64_t slot = (node.expire_tick >> (kSlotBits * level)) & kSlotMask;
+
+  node.level = level;
+  node.slot = static_cast<uint8_t>(slot);
+  node.prev = -1;
+  node.next = heads_[level][slot];
+  if (node.next >= 0)
+    nodes_[node.next].prev = id;
+  heads_[level][slot] = id;
+  occupied_[level] |= 1ULL << slot;
+  item_number_++;
+}
+
+void TimingWheel::Unlink(uint32_t id) {
+  Node& node = nodes_[id];
+  if (node.prev >= 0)
+    nodes_[node.prev].next = node.next;
+  else
+    heads_[node.level][node.slot] = node.next;
+  if (node.next >= 0)
+    nodes_[node.next].prev = node.prev;
+  if (heads_[node.level][node.slot] < 0)
+    occupied_[node.level] &= ~(1ULL << node.slot);
+
+  node.level = -1;
+  item_number_--;
+}
+
+void TimingWheel::Cascade(int level, uint64_t slot) {
+  int32_t id = heads_[level][slot];
+  heads_[level][slot] = -1;
+  occupied_[level] &= ~(1ULL << slot);
+  while (id >= 0) {
+    int32_t next = nodes_[id].next;
+    item_number_--;
+    Insert(id);
+    id = next;
+  }
+}
+
+void TimingWheel::ExpireCurrentSlot(std::vector<uint32_t>& expired) {
+  uint64_t slot = current_tick_ & kSlotMask;
+  int32_t id = heads_[0][slot];
+  heads_[0][slot] = -1;
+  occupied_[0] &= ~(1ULL << slot);
+  while (id >= 0) {
+    nodes_[id].level = -1;
+    item_number_--;
+    expired.push_back(id);
+    id = nodes_[id].next;
+  }
+}
+
+} // namespace common
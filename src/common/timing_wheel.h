@@ -0,0 +1,90 @@
+#ifndef COMMON_TIMING_WHEEL_H_
+#define COMMON_TIMING_WHEEL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace common {
+
+// Hierarchical timing wheel: schedules items (identified by small integer
+// ids, ex: index of symbol) to expire at a tick (ex: millisecond of
+// monotonic clock).
+//
+// 4 levels of 64 slots, level k has resolution of 64^k ticks. An item is put
+// into the level which covers its delay, and moved down to lower levels
+// (cascaded) when its time comes near. So scheduling and cancelling are O(1),
+// and advancing the wheel costs O(1) per expired item (plus at most 3
+// cascades per item), not depending on the number of scheduled items. Empty
+// slots are skipped by bitmaps.
+//
+// Delays are limited to 64^4 - 1 ticks (about 4.6 hours in milliseconds).
+// Not thread-safe.
+class TimingWheel {
+public:
+  // Wheel starts at |current_tick|.
+  explicit TimingWheel(uint64_t current_tick = 0);
+
+  TimingWheel(const TimingWheel&) = delete;
+  TimingWheel& operator=(const TimingWheel&) = delete;
+
+  // Remove all items and move wheel to |current_tick|.
+  void Reset(uint64_t current_tick);
+
+  // Schedule item |id| to expire at |expire_tick|, replacing its current
+  // schedule. Expired at next tick if |expire_tick| is already passed.
+  void Schedule(uint32_t id, uint64_t expire_tick);
+  // Remove item |id| if it is scheduled.
+  void Cancel(uint32_t id);
+  bool IsScheduled(uint32_t id) const {
+    return id < nodes_.size() && nodes_[id].level >= 0;
+  }
+
+  // Advance wheel to |tick|, append items which expire at or before |tick|
+  // to |expired| (in order of expire tick). Expired items are not scheduled
+  // anymore.
+  void Advance(uint64_t tick, std::vector<uint32_t>& expired);
+
+  uint64_t GetCurrentTick() const { return current_tick_; }
+  size_t GetItemNumber() const { return item_number_; }
+  // Tick to call |Advance()| next time: expire tick of next item, or the
+  // next tick which items may be cascaded at (no item expires before it).
+  // Max value of uint64_t if wheel is empty.
+  uint64_t GetNextTick() const;
+
+private:
+  static const int kLevelNumber = 4;
+  static const int kSlotBits = 6;
+  static const int kSlotNumber = 1 << kSlotBits;
+  static const uint64_t kSlotMask = kSlotNumber - 1;
+
+  struct Node {
+    uint64_t expire_tick;
+    int32_t prev;
+    int32_t next;
+    // Position in wheel, |level| is -1 if item is not scheduled.
+    int8_t level;
+    uint8_t slot;
+  };
+
+  // Put scheduled item into slot of its expire tick. Items of current tick
+  // are put into level 0 (only while cascading).
+  void Insert(uint32_t id);
+  void Unlink(uint32_t id);
+  // Move items of slot |slot| of |level| into lower levels.
+  void Cascade(int level, uint64_t slot);
+  // Expire all items of level 0 slot of |current_tick_|.
+  void ExpireCurrentSlot(std::vector<uint32_t>& expired);
+
+  uint64_t current_tick_;
+  size_t item_number_;
+  std::vector<Node> nodes_;
+  // First item of each slot, -1 if slot is empty.
+  int32_t heads_[kLevelNumber][kSlotNumber];
+  // Bit |slot| is set if slot is not empty.
+  uint64_t occupied_[kLevelNumber];
+};
+
+} // namespace common
+
+#endif  // COMMON_TIMING_WHEEL_H_
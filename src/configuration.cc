@@ -1,13 +1,79 @@
 #include "configuration.h"
 
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
 #include "common/config_file_parser.h"
+#include "common/string_helper.h"
 #include "configuration_key.h"
+#include "redis_key.h"
 
 namespace {
 
 // Configuration file name.
 const char kConfigurationFileName[] = "pe.ini";
 
+// Default number of digits after decimal point of fair values.
+const int kDefaultPrecision = 6;
+
+// Default size of shared memory price buffer.
+const uint32_t kDefaultShmMaxSymbols = 4096;
+const uint32_t kDefaultShmRingSize = 65536;
+
+// Default output buffer size of a price stream client. (bytes)
+const uint32_t kDefaultStreamMaxOutputBuffer = 262144;
+
+// Default TTL of multicast datagrams, they do not leave local network.
+const int kDefaultMulticastTTL = 1;
+
+// Default cluster settings. (milliseconds)
+const uint64_t kDefaultLeaseTime = 3000;
+const uint64_t kDefaultRenewInterval = 1000;
+const uint64_t kDefaultSnapshotInterval = 1000;
+
+// Parse statistic setting "type:window" (ex: "sma:1000").
+bool ParseStatistic(const std::string& item, StatisticInformation& statistic) {
+  std::vector<std::string> pair = common::Split(item, ':');
+  int window = 0;
+  if (pair.size() != 2 ||
+      !common::StringToInt(common::Trim(pair[1]), window) ||
+      window <= 0)
+    return false;
+
+  std::string type = common::Trim(pair[0]);
+  if (type == "sma")
+    statistic.type = STATISTIC_SMA;
+  else if (type == "ewma")
+    statistic.type = STATISTIC_EWMA;
+  else if (type == "min")
+    statistic.type = STATISTIC_MIN;
+  else if (type == "max")
+    statistic.type = STATISTIC_MAX;
+  else
+    return false;
+
+  statistic.window = window;
+  statistic.name = type + "_" + std::to_string(window);
+  return true;
+}
+
+// Read scheduling of a thread. Thread is not pinned if |cpu_key| is empty or
+// not set.
+ThreadInformation GetThreadInfo(common::ConfigFileParser& config_file_parser,
+                                const std::string& cpu_key,
+                                const std::string& realtime_priority_key,
+                                const std::string& nice_key) {
+  ThreadInformation thread;
+  thread.cpu = cpu_key.empty() || config_file_parser.GetValue(cpu_key).empty()
+      ? -1
+      : config_file_parser.GetInt(cpu_key);
+  thread.realtime_priority = std::min(
+      std::max(config_file_parser.GetInt(realtime_priority_key), 0), 99);
+  thread.nice =
+      std::min(std::max(config_file_parser.GetInt(nice_key), -20), 19);
+  return thread;
+}
+
 }
 
 // static
@@ -24,23 +90,105 @@ Configuration::Configuration() {
 void Configuration::LoadConfig(const std::string& file_name) {
   // Use ConfigFileParser to get all settings from configuration file.
   common::ConfigFileParser config_file_parser(file_name);
+  file_name_ = file_name;
 
   // Get redis information.
   redis_server_.host = config_file_parser.GetValue(kRedisServerHost);
   redis_server_.port = config_file_parser.GetInt(kRedisServerPort);
   redis_server_.password = config_file_parser.GetValue(kRedisServerPassword);
+  redis_server_.unix_socket =
+      config_file_parser.GetValue(kRedisServerUnixSocket);
+  redis_server_.connect_timeout =
+      std::max(config_file_parser.GetInt(kRedisConnectTimeout), 0);
+  redis_server_.command_timeout =
+      std::max(config_file_parser.GetInt(kRedisCommandTimeout), 0);
+  redis_server_.tcp_nodelay =
+      config_file_parser.GetValue(kRedisTcpNoDelay) != "0";
+  redis_server_.keepalive = config_file_parser.GetInt(kRedisKeepAlive) == 1;
+  redis_server_.send_buffer_size =
+      std::max(config_file_parser.GetInt(kRedisSendBufferSize), 0);
+  redis_server_.receive_buffer_size =
+      std::max(config_file_parser.GetInt(kRedisReceiveBufferSize), 0);
+  redis_server_.cluster = config_file_parser.GetInt(kRedisCluster) == 1;
+  redis_server_.cluster_nodes =
+      config_file_parser.GetListString(kRedisClusterNodes);
+  std::string client_cache = config_file_parser.GetValue(kRedisClientCache);
+  redis_server_.client_cache = client_cache == "broadcast"
+      ? CLIENT_CACHE_BROADCAST
+      : client_cache == "default" ? CLIENT_CACHE_DEFAULT : CLIENT_CACHE_OFF;
+  redis_server_.client_cache_prefixes =
+      config_file_parser.GetListString(kRedisClientCachePrefixes);
+  if (redis_server_.client_cache_prefixes.empty()) {
+    redis_server_.client_cache_prefixes = {kPEConfigPrefix,
+                                           kFairValuePrefix};
+  }
 
   // Get all group settings.
   int group_number = config_file_parser.GetInt(kGroupNumber);
+  group_info_.clear();
   for (int i = 0; i < group_number; i++) {
     std::string prefix = std::string(kGroupPrefix) + std::to_string(i);
     GroupInformation group_info;
+    group_info.name = prefix;
     group_info.base_symbol =
         config_file_parser.GetValue(prefix + kBaseSymbolKey);
     group_info.price_sources =
         config_file_parser.GetListString(prefix + kPriceSourcesKey);
     group_info.symbols =
         config_file_parser.GetListString(prefix + kSymbolsKey);
+    group_info.pricing_core =
+        config_file_parser.GetValue(prefix + kPricingCoreKey) == "soa"
+        ? PRICING_CORE_SOA
+        : PRICING_CORE_OBJECT;
+
+    // Precision: "group_N.precision = 8" and
+    // "group_N.symbol_precision = xrpbtc:10,btcjpy:0".
+    std::string precision = config_file_parser.GetValue(prefix + kPrecisionKey);
+    group_info.precision = precision.empty()
+        ? kDefaultPrecision
+        : config_file_parser.GetInt(prefix + kPrecisionKey);
+    for (auto& item : config_file_parser.GetListString(
+             prefix + kSymbolPrecisionKey)) {
+      std::vector<std::string> pair = common::Split(item, ':');
+      int symbol_precision = 0;
+      if (pair.size() == 2 &&
+          common::StringToInt(common::Trim(pair[1]), symbol_precision)) {
+        group_info.symbol_precisions[common::Trim(pair[0])] =
+            symbol_precision;
+      }
+    }
+
+    // Statistics: "group_N.statistics = sma:1000,ewma:5000,max:60000".
+    for (auto& item : config_file_parser.GetListString(
+             prefix + kStatisticsKey)) {
+      StatisticInformation statistic;
+      if (ParseStatistic(item, statistic))
+        group_info.statistics.push_back(statistic);
+    }
+
+    // Refresh intervals: "group_N.loop_interval = 100" and
+    // "group_N.symbol_interval = btcjpy:20,icojpy:1000".
+    group_info.loop_interval = static_cast<uint64_t>(
+        std::max(config_file_parser.GetInt(prefix + kGroupLoopIntervalKey), 0));
+    for (auto& item : config_file_parser.GetListString(
+             prefix + kSymbolIntervalKey)) {
+      std::vector<std::string> pair = common::Split(item, ':');
+      int interval = 0;
+      if (pair.size() == 2 &&
+          common::StringToInt(common::Trim(pair[1]), interval) &&
+          interval > 0) {
+        group_info.symbol_intervals[common::Trim(pair[0])] = interval;
+      }
+    }
+
+    // Scheduling of loop thread: "group_N.cpu = 4",
+    // "group_N.realtime_priority = 50" or "group_N.nice = -10",
+    // "group_N.busy_poll = 1".
+    group_info.thread = GetThreadInfo(
+        config_file_parser, prefix + kThreadCpuKey,
+        prefix + kThreadRealtimePriorityKey, prefix + kThreadNiceKey);
+    group_info.busy_poll =
+        config_file_parser.GetInt(prefix + kBusyPollKey) == 1;
 
     group_info_.push_back(group_info);
   }
@@ -48,4 +196,87 @@ void Configuration::LoadConfig(const std::string& file_name) {
   // Other settings.
   diff_time_max_ = config_file_parser.GetInt(kDiffTimeMax);
   loop_interval_ = config_file_parser.GetInt(kLoopInterval);
+  auto_reload_ = config_file_parser.GetInt(kConfigAutoReload) == 1;
+  config_cache_file_name_ = config_file_parser.GetValue(kConfigCacheFile);
+
+  // Output settings.
+  redis_write_mode_ =
+      config_file_parser.GetValue(kRedisWriteMode) == "script"
+      ? REDIS_WRITE_SCRIPT
+      : REDIS_WRITE_LEGACY;
+  std::string redis_storage = config_file_parser.GetValue(kRedisStorage);
+  if (redis_storage == "hash")
+    redis_storage_mode_ = REDIS_STORAGE_HASH;
+  else if (redis_storage == "both")
+    redis_storage_mode_ = REDIS_STORAGE_BOTH;
+  else
+    redis_storage_mode_ = REDIS_STORAGE_JSON;
+  std::string publish_mode = config_file_parser.GetValue(kPublishMode);
+  if (publish_mode == "json")
+    publish_mode_ = PUBLISH_BATCH_JSON;
+  else if (publish_mode == "msgpack")
+    publish_mode_ = PUBLISH_BATCH_MSGPACK;
+  else
+    publish_mode_ = PUBLISH_SYMBOL_NAME;
+  redis_output_enabled_ =
+      config_file_parser.GetValue(kRedisOutputEnabled) != "0";
+  shm_output_.name = config_file_parser.GetValue(kShmName);
+  int shm_max_symbols = config_file_parser.GetInt(kShmMaxSymbols);
+  int shm_ring_size = config_file_parser.GetInt(kShmRingSize);
+  shm_output_.max_symbols =
+      shm_max_symbols > 0 ? shm_max_symbols : kDefaultShmMaxSymbols;
+  shm_output_.ring_size =
+      shm_ring_size > 0 ? shm_ring_size : kDefaultShmRingSize;
+  stream_output_.address = config_file_parser.GetValue(kStreamAddress);
+  int stream_max_output_buffer =
+      config_file_parser.GetInt(kStreamMaxOutputBuffer);
+  stream_output_.max_output_buffer = stream_max_output_buffer > 0
+      ? stream_max_output_buffer
+      : kDefaultStreamMaxOutputBuffer;
+  multicast_output_.address = config_file_parser.GetValue(kMulticastAddress);
+  multicast_output_.interface =
+      config_file_parser.GetValue(kMulticastInterface);
+  int multicast_ttl = config_file_parser.GetInt(kMulticastTTL);
+  multicast_output_.ttl =
+      multicast_ttl > 0 ? multicast_ttl : kDefaultMulticastTTL;
+  multicast_output_.snapshot_address =
+      config_file_parser.GetValue(kMulticastSnapshotAddress);
+  journal_file_name_ = config_file_parser.GetValue(kJournalFile);
+
+  // Cluster settings.
+  cluster_.enabled = config_file_parser.GetInt(kClusterEnabled) == 1;
+  cluster_.instance_id = config_file_parser.GetValue(kClusterInstanceId);
+  if (cluster_.instance_id.empty()) {
+    char host_name[256] = {0};
+    gethostname(host_name, sizeof(host_name) - 1);
+    cluster_.instance_id =
+        std::string(host_name) + ":" + std::to_string(getpid());
+  }
+  int lease_time = config_file_parser.GetInt(kClusterLeaseTime);
+  int renew_interval = config_file_parser.GetInt(kClusterRenewInterval);
+  int snapshot_interval = config_file_parser.GetInt(kClusterSnapshotInterval);
+  cluster_.lease_time = lease_time > 0 ? lease_time : kDefaultLeaseTime;
+  cluster_.renew_interval =
+      renew_interval > 0 ? renew_interval : kDefaultRenewInterval;
+  // Lease must survive at least one failed renewal.
+  if (cluster_.renew_interval * 2 > cluster_.lease_time)
+    cluster_.renew_interval = cluster_.lease_time / 2;
+  cluster_.snapshot_interval =
+      snapshot_interval > 0 ? snapshot_interval : kDefaultSnapshotInterval;
+
+  // IO runtime settings. Use one event loop if not set.
+  io_loop_number_ = std::max(config_file_parser.GetInt(kIOLoopNumber), 1);
+  io_cpu_affinity_ = config_file_parser.GetListInt(kIOCpuAffinity);
+  io_thread_ = GetThreadInfo(config_file_parser, std::string(),
+                             kIORealtimePriority, kIONice);
+}
+
+bool Configuration::ReloadConfig() {
+  // Keep current settings if file is removed (or being replaced).
+  std::ifstream file(file_name_);
+  if (!file)
+    return false;
+
+  LoadConfig(file_name_);
+  return true;
 }
@@ -1,19 +1,192 @@
 #ifndef CONFIGURATION_H_
 #define CONFIGURATION_H_
 
+#include <atomic>
+#include <map>
 #include <string>
 #include <vector>
 
+// Client-side caching of GET replies, invalidated by redis server ('CLIENT
+// TRACKING', redis 6+).
+enum ClientCacheMode {
+  CLIENT_CACHE_OFF = 0,
+  // Server remembers cached keys read by each connection (OPTIN) and
+  // invalidates them.
+  CLIENT_CACHE_DEFAULT,
+  // Server invalidates every key of cached prefixes, whoever read it.
+  CLIENT_CACHE_BROADCAST
+};
+
 struct RedisServerInformation {
   std::string host;
   int port;
   std::string password;
+  // Connect by unix domain socket (redis on the same host) instead of TCP
+  // |host|:|port|, if not empty.
+  std::string unix_socket;
+  // Timeouts of connecting and of commands on synchronous connections
+  // (milliseconds), 0 if not used. A connection is re-created after its
+  // command timed out.
+  int connect_timeout;
+  int command_timeout;
+  // TCP socket options. Buffer sizes are system default if 0.
+  bool tcp_nodelay;
+  bool keepalive;
+  int send_buffer_size;
+  int receive_buffer_size;
+  // Server is a node of redis cluster: keys are read/written on nodes which
+  // serve their hash slots. Slots are discovered from |host|:|port| or from
+  // other |cluster_nodes| ("host:port" list).
+  bool cluster;
+  std::vector<std::string> cluster_nodes;
+  // Values of keys which start with one of |client_cache_prefixes| are
+  // cached in process (see |redis::client::ClientCache|), GET only: hashes
+  // (HMGET) are not cached. Not supported on a redis cluster.
+  ClientCacheMode client_cache;
+  std::vector<std::string> client_cache_prefixes;
+};
+
+// Way to calculate fair values of symbols in a group.
+enum PricingCoreType {
+  // Symbol by symbol, by |Symbol| objects.
+  PRICING_CORE_OBJECT = 0,
+  // Whole group at once, by |PricingCore| (structure of arrays + SIMD).
+  PRICING_CORE_SOA
+};
+
+// Statistics of fair value, which are calculated in addition to moving
+// average of NOP setting (see |SymbolStatistics|).
+enum StatisticType {
+  // Simple moving average over a time window.
+  STATISTIC_SMA = 0,
+  // Exponentially weighted moving average, window is half-life.
+  STATISTIC_EWMA,
+  // Min/max over a time window.
+  STATISTIC_MIN,
+  STATISTIC_MAX
+};
+
+struct StatisticInformation {
+  StatisticType type;
+  // Window (or half-life) in milliseconds.
+  uint64_t window;
+  // Field name in fair value data (ex: "sma_1000").
+  std::string name;
+};
+
+// Scheduling of a thread (loop of a group, event loop).
+struct ThreadInformation {
+  // Cpu core which thread is pinned to, -1 if not pinned.
+  int cpu;
+  // Real-time priority (SCHED_FIFO, 1-99), 0 if thread is not real-time.
+  int realtime_priority;
+  // Nice value (-20 to 19) of non real-time thread.
+  int nice;
 };
 
 struct GroupInformation {
+  // Name of group in configuration file (group_0, group_1, etc.).
+  std::string name;
   std::string base_symbol;
   std::vector<std::string> price_sources;
   std::vector<std::string> symbols;
+  PricingCoreType pricing_core;
+  // Number of digits after decimal point of fair values, default of group
+  // and of specific symbols.
+  int precision;
+  std::map<std::string, int> symbol_precisions;
+  // Statistics published with fair value of all symbols, empty if not used.
+  std::vector<StatisticInformation> statistics;
+  // Fair value of each symbol is calculated every refresh interval
+  // (milliseconds): interval of group (0 if not set, 'common.loop_interval'
+  // is used), or of specific symbols. Refresh interval in PE config of a
+  // symbol overrides both.
+  uint64_t loop_interval;
+  std::map<std::string, uint64_t> symbol_intervals;
+  // Scheduling of loop thread, applied when loop is started.
+  ThreadInformation thread;
+  // Loop thread spins (instead of sleeping) until next loop, for lower
+  // jitter. It uses a whole cpu core, pin it with |thread.cpu|.
+  bool busy_poll;
+};
+
+struct ShmOutputInformation {
+  // Name of shared memory object (ex: "/pe_prices"), empty if not used.
+  std::string name;
+  uint32_t max_symbols;
+  uint32_t ring_size;
+};
+
+// TCP price stream server for downstream consumers (see
+// |PriceStreamServer|).
+struct StreamOutputInformation {
+  // Listening address, "host:port" (ex: "0.0.0.0:9100"), empty if not used.
+  std::string address;
+  // Updates of a client are conflated while its output buffer has more than
+  // this many bytes.
+  uint32_t max_output_buffer;
+};
+
+// UDP multicast price feed (see |PriceMulticastPublisher|).
+struct MulticastOutputInformation {
+  // Multicast group, "address:port" (ex: "239.1.1.1:9200"), empty if not
+  // used.
+  std::string address;
+  // Local IPv4 address of sending interface, default interface if empty.
+  std::string interface;
+  int ttl;
+  // Snapshot service which receivers recover from after a gap, "host:port"
+  // or path of unix socket. Not used if empty.
+  std::string snapshot_address;
+};
+
+// Horizontal sharding of groups across PE instances (see
+// |ClusterCoordinator|).
+struct ClusterInformation {
+  bool enabled;
+  // Unique id of this instance, default is "hostname:pid".
+  std::string instance_id;
+  // Time (milliseconds) an owned group is kept without renewal, and interval
+  // of renewal. A group of a failed instance is taken over after at most
+  // |lease_time| + |renew_interval|.
+  uint64_t lease_time;
+  uint64_t renew_interval;
+  // Interval (milliseconds) of saving history of groups to redis, used to
+  // warm start a taken over group.
+  uint64_t snapshot_interval;
+};
+
+// The way to write fair value data to redis.
+enum RedisWriteMode {
+  // SET data and PUBLISH symbol name for each symbol.
+  REDIS_WRITE_LEGACY = 0,
+  // Execute one lua script (EVALSHA) for all updated symbols of a loop. Data
+  // is set and a notification listing all updated symbols is published
+  // atomically.
+  REDIS_WRITE_SCRIPT
+};
+
+// Layout of fair value records in redis.
+enum RedisStorageMode {
+  // JSON string at price_engine_data_<symbol>, values are strings.
+  REDIS_STORAGE_JSON = 0,
+  // Hash at price_engine_hash_<symbol>, one plain number per field, so
+  // fields are read/written without JSON.
+  REDIS_STORAGE_HASH,
+  // Both records are written, while consumers move from JSON to hash. Hash
+  // is read first, JSON if hash is not existed.
+  REDIS_STORAGE_BOTH
+};
+
+// Content of notification which is published on fair value channel.
+enum PublishMode {
+  // Symbol name only, subscribers read data from redis by themselves.
+  PUBLISH_SYMBOL_NAME = 0,
+  // One message per loop, contains all fair value data of updated symbols,
+  // encoded as json array.
+  PUBLISH_BATCH_JSON,
+  // Same as |PUBLISH_BATCH_JSON|, but encoded as MessagePack.
+  PUBLISH_BATCH_MSGPACK
 };
 
 // This class contains all settings of this application.
@@ -30,6 +203,15 @@ public:
   // Load all settings from config file.
   void LoadConfig(const std::string& file_name);
 
+  // Load settings again from the last loaded file.
+  // Return false if file is not existed.
+  // Only group settings, |diff_time_max_| and |loop_interval_| are applied
+  // without restart, other settings are used by new groups only.
+  bool ReloadConfig();
+
+  const std::string& GetConfigFileName() { return file_name_; }
+  bool IsAutoReloadEnabled() { return auto_reload_; }
+
   // Get settings.
   RedisServerInformation GetRedisServerInfo() { return redis_server_; }
   const std::vector<GroupInformation>& GetGroupInfo() {
@@ -37,17 +219,56 @@ public:
   }
   uint64_t GetDiffTimeMax() { return diff_time_max_; }
   uint64_t GetLoopInterval() { return loop_interval_; }
+  RedisWriteMode GetRedisWriteMode() { return redis_write_mode_; }
+  RedisStorageMode GetRedisStorageMode() { return redis_storage_mode_; }
+  PublishMode GetPublishMode() { return publish_mode_; }
+  bool IsRedisOutputEnabled() { return redis_output_enabled_; }
+  ShmOutputInformation GetShmOutputInfo() { return shm_output_; }
+  StreamOutputInformation GetStreamOutputInfo() { return stream_output_; }
+  MulticastOutputInformation GetMulticastOutputInfo() {
+    return multicast_output_;
+  }
+  // Empty if tick journal is not used.
+  std::string GetJournalFileName() { return journal_file_name_; }
+  // Empty if PE config cache is not used.
+  std::string GetConfigCacheFileName() { return config_cache_file_name_; }
+  ClusterInformation GetClusterInfo() { return cluster_; }
+  int GetIOLoopNumber() { return io_loop_number_; }
+  const std::vector<int>& GetIOCpuAffinity() { return io_cpu_affinity_; }
+  // Scheduling of all event loop threads (cpu is not used, see
+  // |GetIOCpuAffinity()|).
+  ThreadInformation GetIOThreadInfo() { return io_thread_; }
 
 private:
   // Private instance to avoid instancing.
   Configuration();
   ~Configuration() = default;
 
+  // File which settings are loaded from.
+  std::string file_name_;
+
   // Settings.
   RedisServerInformation redis_server_;
   std::vector<GroupInformation> group_info_;
-  uint64_t diff_time_max_;
-  uint64_t loop_interval_;
+  // Used by loop threads while configuration can be reloaded.
+  std::atomic<uint64_t> diff_time_max_;
+  std::atomic<uint64_t> loop_interval_;
+  // Reload configuration when file is modified.
+  bool auto_reload_;
+  RedisWriteMode redis_write_mode_;
+  // Also used by loop threads (to read base fair values).
+  std::atomic<RedisStorageMode> redis_storage_mode_;
+  PublishMode publish_mode_;
+  bool redis_output_enabled_;
+  ShmOutputInformation shm_output_;
+  StreamOutputInformation stream_output_;
+  MulticastOutputInformation multicast_output_;
+  std::string journal_file_name_;
+  std::string config_cache_file_name_;
+  ClusterInformation cluster_;
+  int io_loop_number_;
+  std::vector<int> io_cpu_affinity_;
+  ThreadInformation io_thread_;
 };
 
 #endif  // CONFIGURATION_H_
\ No newline at end of file
@@ -4,6 +4,17 @@
 const char kRedisServerHost[] = "redis_server.host";
 const char kRedisServerPort[] = "redis_server.port";
 const char kRedisServerPassword[] = "redis_server.password";
+const char kRedisServerUnixSocket[] = "redis_server.unix_socket";
+const char kRedisConnectTimeout[] = "redis_server.connect_timeout";
+const char kRedisCommandTimeout[] = "redis_server.command_timeout";
+const char kRedisTcpNoDelay[] = "redis_server.tcp_nodelay";
+const char kRedisKeepAlive[] = "redis_server.keepalive";
+const char kRedisSendBufferSize[] = "redis_server.send_buffer_size";
+const char kRedisReceiveBufferSize[] = "redis_server.receive_buffer_size";
+const char kRedisCluster[] = "redis_server.cluster";
+const char kRedisClusterNodes[] = "redis_server.cluster_nodes";
+const char kRedisClientCache[] = "redis_server.client_cache";
+const char kRedisClientCachePrefixes[] = "redis_server.client_cache_prefixes";
 
 // Group settings.
 const char kGroupNumber[] = "group.group_number";
@@ -11,7 +22,48 @@ const char kGroupPrefix[] = "group_";
 const char kBaseSymbolKey[] = ".base_symbol";
 const char kPriceSourcesKey[] = ".price_sources";
 const char kSymbolsKey[] = ".symbols";
+const char kPricingCoreKey[] = ".pricing_core";
+const char kPrecisionKey[] = ".precision";
+const char kSymbolPrecisionKey[] = ".symbol_precision";
+const char kStatisticsKey[] = ".statistics";
+const char kGroupLoopIntervalKey[] = ".loop_interval";
+const char kSymbolIntervalKey[] = ".symbol_interval";
+const char kThreadCpuKey[] = ".cpu";
+const char kThreadRealtimePriorityKey[] = ".realtime_priority";
+const char kThreadNiceKey[] = ".nice";
+const char kBusyPollKey[] = ".busy_poll";
+
+// IO runtime settings.
+const char kIOLoopNumber[] = "io.loop_number";
+const char kIOCpuAffinity[] = "io.cpu_affinity";
+const char kIORealtimePriority[] = "io.realtime_priority";
+const char kIONice[] = "io.nice";
+
+// Output settings.
+const char kRedisWriteMode[] = "output.redis_write_mode";
+const char kRedisStorage[] = "output.redis_storage";
+const char kPublishMode[] = "output.publish_mode";
+const char kRedisOutputEnabled[] = "output.redis_enabled";
+const char kShmName[] = "output.shm_name";
+const char kShmMaxSymbols[] = "output.shm_max_symbols";
+const char kShmRingSize[] = "output.shm_ring_size";
+const char kStreamAddress[] = "output.stream_address";
+const char kStreamMaxOutputBuffer[] = "output.stream_max_output_buffer";
+const char kMulticastAddress[] = "output.multicast_address";
+const char kMulticastInterface[] = "output.multicast_interface";
+const char kMulticastTTL[] = "output.multicast_ttl";
+const char kMulticastSnapshotAddress[] = "output.multicast_snapshot_address";
+const char kJournalFile[] = "output.journal_file";
+
+// Cluster settings.
+const char kClusterEnabled[] = "cluster.enabled";
+const char kClusterInstanceId[] = "cluster.instance_id";
+const char kClusterLeaseTime[] = "cluster.lease_time";
+const char kClusterRenewInterval[] = "cluster.renew_interval";
+const char kClusterSnapshotInterval[] = "cluster.snapshot_interval";
 
 // Common settings.
 const char kDiffTimeMax[] = "common.diff_time_max";
 const char kLoopInterval[] = "common.loop_interval";
+const char kConfigAutoReload[] = "common.config_auto_reload";
+const char kConfigCacheFile[] = "common.config_cache_file";
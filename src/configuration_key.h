@@ -7,6 +7,25 @@
 extern const char kRedisServerHost[];
 extern const char kRedisServerPort[];
 extern const char kRedisServerPassword[];
+// Unix socket path, used instead of host/port if set.
+extern const char kRedisServerUnixSocket[];
+// Connect/command timeouts (milliseconds), no timeout if not set.
+extern const char kRedisConnectTimeout[];
+extern const char kRedisCommandTimeout[];
+// TCP_NODELAY (1/0, default 1) and SO_KEEPALIVE (1/0, default 0).
+extern const char kRedisTcpNoDelay[];
+extern const char kRedisKeepAlive[];
+// SO_SNDBUF/SO_RCVBUF (bytes), system default if not set.
+extern const char kRedisSendBufferSize[];
+extern const char kRedisReceiveBufferSize[];
+// Redis cluster (1/0, default 0), and other nodes to discover it from
+// ("host:port" list).
+extern const char kRedisCluster[];
+extern const char kRedisClusterNodes[];
+// Client-side cache mode (off/default/broadcast, default off), and prefixes
+// of cached keys (default PE config and fair value keys).
+extern const char kRedisClientCache[];
+extern const char kRedisClientCachePrefixes[];
 
 // Group settings.
 extern const char kGroupNumber[];
@@ -14,11 +33,89 @@ extern const char kGroupPrefix[];
 extern const char kBaseSymbolKey[];
 extern const char kPriceSourcesKey[];
 extern const char kSymbolsKey[];
+// "object" (default) or "soa", see |PricingCoreType|.
+extern const char kPricingCoreKey[];
+// Number of digits after decimal point of fair values (default of group), and
+// of specific symbols ("symbol:precision" list).
+extern const char kPrecisionKey[];
+extern const char kSymbolPrecisionKey[];
+// Statistics of fair values ("type:window" list, type is sma, ewma, min or
+// max, window is in milliseconds).
+extern const char kStatisticsKey[];
+// Refresh interval of symbols of group, and of specific symbols
+// ("symbol:interval" list). (milliseconds)
+extern const char kGroupLoopIntervalKey[];
+extern const char kSymbolIntervalKey[];
+// Scheduling of loop thread: cpu core, real-time priority (SCHED_FIFO, 1-99)
+// or nice value (-20 to 19), and busy poll (1/0, spin instead of sleeping
+// between loops).
+extern const char kThreadCpuKey[];
+extern const char kThreadRealtimePriorityKey[];
+extern const char kThreadNiceKey[];
+extern const char kBusyPollKey[];
+
+// IO runtime settings.
+// Number of event loops (threads) which drive async redis connections.
+extern const char kIOLoopNumber[];
+// Cpu core of each event loop thread (comma separated list).
+extern const char kIOCpuAffinity[];
+// Real-time priority (SCHED_FIFO, 1-99) or nice value (-20 to 19) of all
+// event loop threads.
+extern const char kIORealtimePriority[];
+extern const char kIONice[];
+
+// Output settings.
+// How fair value is written to redis: "legacy" (SET + PUBLISH per symbol) or
+// "script" (one EVALSHA per loop).
+extern const char kRedisWriteMode[];
+// Layout of fair value records: "json" (default), "hash", or "both" (JSON
+// is kept for consumers which are not migrated yet).
+extern const char kRedisStorage[];
+// Content of notification on fair value channel: "name" (symbol names),
+// "json" or "msgpack" (one message per loop with all fair value data).
+extern const char kPublishMode[];
+// Write fair value to redis or not (1/0). Default is 1.
+extern const char kRedisOutputEnabled[];
+// Shared memory price buffer, for co-located consumers. Disabled if name is
+// empty.
+extern const char kShmName[];
+extern const char kShmMaxSymbols[];
+extern const char kShmRingSize[];
+// Price stream server: listening "host:port" (disabled if empty), and output
+// buffer size of a client (bytes) before its updates are conflated.
+extern const char kStreamAddress[];
+extern const char kStreamMaxOutputBuffer[];
+// Multicast price feed: group "address:port" (disabled if empty), local
+// address of sending interface, TTL, and snapshot service address of
+// receivers ("host:port", or path of unix socket).
+extern const char kMulticastAddress[];
+extern const char kMulticastInterface[];
+extern const char kMulticastTTL[];
+extern const char kMulticastSnapshotAddress[];
+// Tick journal file, disabled if not set.
+extern const char kJournalFile[];
+
+// Cluster settings.
+// Share groups with other PE instances (1/0). Default is 0.
+extern const char kClusterEnabled[];
+// Unique id of instance, default is "hostname:pid".
+extern const char kClusterInstanceId[];
+// Lease time and renew interval of owned groups. (milliseconds)
+extern const char kClusterLeaseTime[];
+extern const char kClusterRenewInterval[];
+// Interval of saving history snapshots of groups. (milliseconds)
+extern const char kClusterSnapshotInterval[];
 
 // Common settings.
 // extern const char kServerType[];
 extern const char kDiffTimeMax[];
 // Interval time of loop, which generated price for all symbols. (milliseconds)
 extern const char kLoopInterval[];
+// Reload configuration file when it is modified (1/0). Configuration is also
+// reloaded when application receives SIGHUP.
+extern const char kConfigAutoReload[];
+// Local file which keeps last known good PE configs of symbols, disabled if
+// not set.
+extern const char kConfigCacheFile[];
 
 #endif  // CONFIGURATION_KEY_H_
\ No newline at end of file
@@ -1,7 +1,13 @@
 #include "group.h"
 
-#include "common/symbol_helper.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <event2/event.h>
+#include "common/clock.h"
+#include "common/thread_helper.h"
 #include "glog/logging.h"
+#include "hiredis/adapters/libevent.h"
 #include "nlohmann/json.hpp"
 #include "redis_key.h"
 
@@ -10,6 +16,232 @@ namespace {
 // Time to reconnect to redis after fail connection. (milliseconds)
 const int kReconnectTime = 1000;
 
+// Config update notifications which arrive within this time are refreshed
+// together, by one MGET. (milliseconds)
+const int kConfigRefreshDelay = 20;
+
+// Set fair value data of all updated symbols, then publish one notification
+// listing them (comma separated), in one atomic step.
+// KEYS: fair value JSON keys, then fair value hash keys.
+// ARGV: channel, message, number of JSON keys, number of hash fields, names
+// of hash fields, JSON data of JSON keys, then values of fields of each hash
+// key.
+const char kSetAndPublishScript[] =
+    "local json_number = tonumber(ARGV[3])\n"
+    "local field_number = tonumber(ARGV[4])\n"
+    "local arg = 5 + field_number\n"
+    "for i = 1, json_number do\n"
+    "  redis.call('SET', KEYS[i], ARGV[arg])\n"
+    "  arg = arg + 1\n"
+    "end\n"
+    "for i = json_number + 1, #KEYS do\n"
+    "  local hash = {}\n"
+    "  for j = 1, field_number do\n"
+    "    hash[2 * j - 1] = ARGV[4 + j]\n"
+    "    hash[2 * j] = ARGV[arg]\n"
+    "    arg = arg + 1\n"
+    "  end\n"
+    "  redis.call('HSET', KEYS[i], unpack(hash))\n"
+    "end\n"
+    "redis.call('PUBLISH', ARGV[1], ARGV[2])\n"
+    "return #KEYS\n";
+
+// Snapshots of fair value history are kept this time after their group is
+// stopped. (milliseconds)
+const uint64_t kSnapshotExpireTime = 60000;
+
+// Digits after decimal point of standard deviation ratio (percent).
+const int kStdDevRatioScale = 6;
+
+// Schedule id of whole group, when all symbols are calculated together.
+const uint32_t kGroupScheduleId = 0;
+
+// Interval of reporting loop jitter. (seconds)
+const int kJitterReportInterval = 60;
+
+// Length of json string of fair value data without values: 4 keys (39
+// bytes), quotes, colons, commas and braces.
+const size_t kFairValueJsonSyntaxLength = 64;
+// Max length of json string of fair value data (without statistics): 3
+// decimals and timestamp, each may be followed by '\0' while it is written.
+const size_t kMaxFairValueJsonLength = kFairValueJsonSyntaxLength +
+                                       3 * common::Decimal::kMaxStringLength +
+                                       common::kMaxUint64StringLength;
+// Buffer of a single value holds timestamp too.
+static_assert(common::Decimal::kMaxStringLength >=
+                  common::kMaxUint64StringLength,
+              "buffer of a formatted value is too small");
+
+// Append |str| to |buffer| at |length|.
+void AppendString(const char* str, char* buffer, size_t& length) {
+  while (*str != '\0')
+    buffer[length++] = *str++;
+}
+
+// Append "\"|key|\":\"|value|\"" to |buffer| at |length|. |value| is written
+// by |format|.
+template <typename Formatter>
+void AppendJsonField(const char* key, Formatter format,
+                     char* buffer, size_t& length) {
+  buffer[length++] = '"';
+  AppendString(key, buffer, length);
+  AppendString("\":\"", buffer, length);
+  length += format(buffer + length);
+  buffer[length++] = '"';
+}
+
+// Convert fair value data to json string, which is saved in redis. Values are
+// strings with fixed number of digits (precision of symbol), keys are sorted
+// like previous nlohmann::json output. Written into a stack buffer, so no
+// intermediate allocation. Configured |statistics| are appended after them.
+std::string FairValueDataToJson(const FairValueData& data,
+                                const SymbolStatistics::Config& statistics) {
+  int precision = data.fair_value.scale();
+  common::Decimal moving_average =
+      common::Decimal::FromDouble(data.moving_average, precision);
+  common::Decimal ratio = common::Decimal::FromDouble(
+      data.standard_deviation_ratio, kStdDevRatioScale);
+
+  char buffer[kMaxFairValueJsonLength];
+  size_t length = 0;
+  buffer[length++] = '{';
+  AppendJsonField(kFairValueKey, [&data](char* out) {
+    return data.fair_value.Format(out);
+  }, buffer, length);
+  buffer[length++] = ',';
+  AppendJsonField(kFairValueMVKey, [&moving_average](char* out) {
+    return moving_average.Format(out);
+  }, buffer, length);
+  buffer[length++] = ',';
+  AppendJsonField(kStdDevRatioKey, [&ratio](char* out) {
+    return ratio.Format(out);
+  }, buffer, length);
+  buffer[length++] = ',';
+  AppendJsonField(kTimestampKey, [&data](char* out) {
+    return common::FormatUint64(data.timestamp, out);
+  }, buffer, length);
+  if (data.statistics.empty()) {
+    buffer[length++] = '}';
+    return std::string(buffer, length);
+  }
+
+  std::string json(buffer, length);
+  for (size_t i = 0; i < data.statistics.size(); i++) {
+    common::Decimal value =
+        common::Decimal::FromDouble(data.statistics[i], precision);
+    json += ",\"";
+    json += statistics[i].name;
+    json += "\":\"";
+    json.append(buffer, value.Format(buffer));
+    json += '"';
+  }
+  json += '}';
+  return json;
+}
+
+// Fair value records of a loop, in layouts of storage mode.
+struct FairValueRecords {
+  std::vector<std::string> json_keys;
+  std::vector<std::string> json_values;
+  std::vector<std::string> hash_keys;
+  // Fields of all hashes, then values of each hash in order of fields.
+  std::vector<std::string> hash_fields;
+  std::vector<std::string> hash_values;
+};
+
+// Append values of hash of fair value data, in order of fields of
+// |BuildFairValueRecords()|. Values are plain numbers, formatted like JSON
+// strings.
+void AppendFairValueFields(const FairValueData& data,
+                           std::vector<std::string>& values) {
+  int precision = data.fair_value.scale();
+  char buffer[common::Decimal::kMaxStringLength];
+  values.emplace_back(buffer, data.fair_value.Format(buffer));
+  values.emplace_back(
+      buffer,
+      common::Decimal::FromDouble(data.moving_average, precision)
+          .Format(buffer));
+  values.emplace_back(
+      buffer,
+      common::Decimal::FromDouble(data.standard_deviation_ratio,
+                                  kStdDevRatioScale).Format(buffer));
+  values.emplace_back(buffer, common::FormatUint64(data.timestamp, buffer));
+  for (double statistic : data.statistics) {
+    values.emplace_back(
+        buffer,
+        common::Decimal::FromDouble(statistic, precision).Format(buffer));
+  }
+}
+
+void BuildFairValueRecords(const std::vector<FairValueData>& data_list,
+                           const SymbolStatistics::Config& statistics,
+                           RedisStorageMode storage,
+                           FairValueRecords& records) {
+  if (storage != REDIS_STORAGE_HASH) {
+    records.json_keys.reserve(data_list.size());
+    records.json_values.reserve(data_list.size());
+    for (auto& data : data_list) {
+      records.json_keys.push_back(
+          std::string(kFairValuePrefix) + data.symbol_name);
+      records.json_values.push_back(FairValueDataToJson(data, statistics));
+    }
+  }
+  if (storage == REDIS_STORAGE_JSON)
+    return;
+
+  records.hash_fields = {kFairValueKey, kFairValueMVKey, kStdDevRatioKey,
+                         kTimestampKey};
+  for (auto& statistic : statistics)
+    records.hash_fields.push_back(statistic.name);
+  records.hash_keys.reserve(data_list.size());
+  records.hash_values.reserve(data_list.size() * records.hash_fields.size());
+  for (auto& data : data_list) {
+    records.hash_keys.push_back(
+        std::string(kFairValueHashPrefix) + data.symbol_name);
+    AppendFairValueFields(data, records.hash_values);
+  }
+}
+
+// Build one notification message which contains all fair value data of a
+// loop. Values are numbers (not string) to keep message compact, except fair
+// value which is exact decimal string (same as records).
+std::string BuildBatchNotification(const std::vector<FairValueData>& data_list,
+                                   const SymbolStatistics::Config& statistics,
+                                   PublishMode publish_mode) {
+  nlohmann::json json = nlohmann::json::array();
+  for (auto& data : data_list) {
+    nlohmann::json item;
+    item[kSymbolNameKey] = data.symbol_name;
+    item[kTimestampKey] = data.timestamp;
+    item[kFairValueKey] = data.fair_value.ToString();
+    item[kFairValueMVKey] = data.moving_average;
+    item[kStdDevRatioKey] = data.standard_deviation_ratio;
+    for (size_t i = 0; i < data.statistics.size(); i++)
+      item[statistics[i].name] = data.statistics[i];
+    json.push_back(item);
+  }
+
+  if (publish_mode == PUBLISH_BATCH_MSGPACK) {
+    std::vector<uint8_t> msgpack = nlohmann::json::to_msgpack(json);
+    return std::string(msgpack.begin(), msgpack.end());
+  }
+
+  return json.dump();
+}
+
+// Return true if |a| and |b| have the same statistics (so history of
+// statistics can be kept).
+bool IsSameStatistics(const SymbolStatistics::Config& a,
+                      const SymbolStatistics::Config& b) {
+  if (a.size() != b.size())
+    return false;
+  for (size_t i = 0; i < a.size(); i++) {
+    if (a[i].type != b[i].type || a[i].window != b[i].window)
+      return false;
+  }
+  return true;
+}
+
 } // namespace
 
 Group::Group() {
@@ -17,22 +249,40 @@ Group::Group() {
 
 Group::Group(const RedisServerInformation& redis_info,
              const GroupInformation& group,
-             struct event_base* event_base) {
-  Initialize(redis_info, group, event_base);
+             IORuntime* io_runtime,
+             const GroupOutputs& outputs)
+    : name_(group.name),
+      redis_info_(redis_info),
+      pricing_core_type_(group.pricing_core),
+      io_runtime_(io_runtime),
+      io_loop_index_(io_runtime->GetLoopIndex(group.name)),
+      precision_(group.precision),
+      symbol_precisions_(group.symbol_precisions),
+      loop_interval_(group.loop_interval),
+      symbol_intervals_(group.symbol_intervals),
+      outputs_(outputs),
+      statistics_config_(new SymbolStatistics::Config(group.statistics)),
+      thread_info_(group.thread),
+      busy_poll_(group.busy_poll) {
+  if (pricing_core_type_ == PRICING_CORE_SOA && !symbol_intervals_.empty())
+    LOG(WARNING) << "All symbols of group " << name_ << " are calculated "
+                 << "together (soa), intervals of symbols are ignored.";
+  Initialize(redis_info, group);
 }
 
 Group::~Group() {
+  if (loop_thread_.joinable())
+    StopLoop();
+  StopConfigReader();
 }
 
 void Group::Initialize(
     const RedisServerInformation& redis_info,
-    const GroupInformation& group,
-    struct event_base* event_base) {
-  // Connect to redis server.
-  redis_client_ =
-      redis::client::CreateRedisClient(redis_info.host, redis_info.port);
-  if (redis_client_ == nullptr ||
-      !redis::client::Authenticate(redis_client_, redis_info.password)) {
+    const GroupInformation& group) {
+  // Connect to redis server. Connection is owned by calling thread, loop
+  // thread uses its own one.
+  redis::client::Client* redis_client = GetRedisClient();
+  if (redis_client == nullptr) {
     // TODO(hoangpq): Setup a timer to reconnect. (Re-initialize)
     // Try to do not exit everytime cannot establish connection to redis.
 
@@ -41,48 +291,445 @@ void Group::Initialize(
     //   // Initialize(redis_info, group, event_base);
     // }).detach();
 
-    // Plz change to LOG(ERROR) if you don't want to receive failure stack to
-    // log file when authenticate failed.
-    LOG(FATAL) << "Cannot establish connection to redis! Exit.";
-    std::exit(EXIT_FAILURE);
+    // Symbols can be created from local config cache (loop thread connects
+    // again by itself when it writes fair values).
+    if (outputs_.config_cache != nullptr) {
+      LOG(ERROR) << "Cannot establish connection to redis, start group "
+                 << group.name << " with cached PE configs.";
+    } else {
+      // Plz change to LOG(ERROR) if you don't want to receive failure stack
+      // to log file when authenticate failed.
+      LOG(FATAL) << "Cannot establish connection to redis! Exit.";
+      std::exit(EXIT_FAILURE);
+      return;
+    }
+  }
+
+  ClusterInformation cluster = Configuration::GetInstance()->GetClusterInfo();
+  snapshot_interval_ = std::chrono::milliseconds(
+      cluster.enabled ? cluster.snapshot_interval : 0);
+  publish_mode_ = Configuration::GetInstance()->GetPublishMode();
+  redis_output_enabled_ =
+      Configuration::GetInstance()->IsRedisOutputEnabled();
+
+  redis_storage_mode_ = Configuration::GetInstance()->GetRedisStorageMode();
+
+  // Prepare lua script if fair value is written by script.
+  redis_write_mode_ = Configuration::GetInstance()->GetRedisWriteMode();
+  if (redis_write_mode_ == REDIS_WRITE_SCRIPT && redis_info.cluster) {
+    // Keys of a script must be in one slot of redis cluster, fair values of
+    // symbols are spread over slots.
+    LOG(WARNING) << "Script write mode is not supported on redis cluster, "
+                 << "use legacy write mode for group " << group.name << ".";
+    redis_write_mode_ = REDIS_WRITE_LEGACY;
+  }
+  if (redis_write_mode_ == REDIS_WRITE_SCRIPT) {
+    set_and_publish_script_.source = kSetAndPublishScript;
+    if (redis_client == nullptr ||
+        !redis::client::ScriptLoad(redis_client, set_and_publish_script_)) {
+      LOG(ERROR) << "Cannot load set and publish script, "
+                 << "use legacy write mode for group " << group.name << ".";
+      redis_write_mode_ = REDIS_WRITE_LEGACY;
+    }
+  }
+
+  if (redis_info.cluster)
+    config_reader_thread_ = std::thread(&Group::RunConfigReader, this);
+
+  // hiredis async context is not thread-safe, so it is created and used on
+  // its event loop thread only. Symbols do not wait for it, it is created
+  // again later if redis is not available.
+  io_runtime_->Post(io_loop_index_, [this]() {
+    InitializeAsyncConnect();
+  });
+
+  // Create |Symbol| objects correspond with symbol list in the setting file.
+  std::vector<std::string> cached_names;
+  SymbolList created_symbols =
+      CreateSymbols(redis_client, group.symbols, cached_names);
+  std::shared_ptr<SymbolList> symbols(new SymbolList());
+  for (auto& symbol : created_symbols) {
+    // Save instances of |Symbol| into a vector to refer later.
+    if (symbol)
+      symbols->push_back(symbol);
+  }
+  std::atomic_store(&symbols_,
+                    std::shared_ptr<const SymbolList>(std::move(symbols)));
+  RevalidatePEConfigs(cached_names);
+}
+
+Group::SymbolList Group::CreateSymbols(
+    redis::client::Client* redis_client,
+    const std::vector<std::string>& symbol_names,
+    std::vector<std::string>& cached_names) {
+  // Get fair value configuration at the first time: from local cache, or by
+  // one round trip for all symbols which are not cached.
+  std::vector<FairValueConfig> configs(symbol_names.size());
+  std::vector<bool> found(symbol_names.size(), false);
+  std::vector<size_t> missing;
+  std::vector<std::string> keys;
+  for (size_t i = 0; i < symbol_names.size(); i++) {
+    if (outputs_.config_cache != nullptr &&
+        outputs_.config_cache->Get(symbol_names[i], configs[i])) {
+      found[i] = true;
+      cached_names.push_back(symbol_names[i]);
+      continue;
+    }
+    missing.push_back(i);
+    keys.push_back(std::string(kPEConfigPrefix) + symbol_names[i]);
+  }
+
+  if (!missing.empty() && redis_client != nullptr) {
+    std::vector<std::string> values = redis::client::MGet(redis_client, keys);
+    for (size_t i = 0; i < values.size() && i < missing.size(); i++) {
+      size_t index = missing[i];
+      if (values[i].empty() || !ParsePEConfig(values[i], configs[index]))
+        continue;
+      found[index] = true;
+      if (outputs_.config_cache != nullptr)
+        outputs_.config_cache->Put(symbol_names[index], configs[index]);
+    }
+  }
+  if (!cached_names.empty()) {
+    LOG(INFO) << "Create " << cached_names.size() << " symbol(s) of group "
+              << name_ << " with cached PE configs.";
+  }
+
+  SymbolList symbols(symbol_names.size());
+  for (size_t i = 0; i < symbol_names.size(); i++) {
+    if (!found[i]) {
+      LOG(ERROR) << "Cannot get PE config for symbol " << symbol_names[i]
+                 << ". Ignore this symbol, please reload configuration or "
+                 << "restart application.";
+      continue;
+    }
+    symbols[i] = CreateSymbol(symbol_names[i], configs[i]);
+  }
+  return symbols;
+}
+
+std::shared_ptr<Symbol> Group::CreateSymbol(
+    const std::string& symbol_name,
+    const FairValueConfig& fair_value_config) {
+  std::shared_ptr<Symbol> symbol(
+      new Symbol(symbol_name, fair_value_config,
+                 GetSymbolPrecision(symbol_name)));
+  symbol->SetRefreshInterval(GetSymbolRefreshInterval(symbol_name));
+  if (outputs_.shm_writer != nullptr) {
+    symbol->SetShmSymbolId(outputs_.shm_writer,
+                           outputs_.shm_writer->RegisterSymbol(symbol_name));
+  }
+  if (outputs_.tick_journal != nullptr) {
+    symbol->SetJournalSymbolId(
+        outputs_.tick_journal->RegisterSymbol(symbol_name));
+  }
+  return symbol;
+}
+
+int Group::GetSymbolPrecision(const std::string& symbol_name) const {
+  auto it = symbol_precisions_.find(symbol_name);
+  return it != symbol_precisions_.end() ? it->second : precision_;
+}
+
+uint64_t Group::GetSymbolRefreshInterval(
+    const std::string& symbol_name) const {
+  auto it = symbol_intervals_.find(symbol_name);
+  return it != symbol_intervals_.end() ? it->second : 0;
+}
+
+uint64_t Group::GetLoopInterval() const {
+  uint64_t interval = loop_interval_;
+  if (interval == 0)
+    interval = Configuration::GetInstance()->GetLoopInterval();
+  return std::max<uint64_t>(interval, 1);
+}
+
+uint64_t Group::GetRefreshInterval(Symbol& symbol) const {
+  uint64_t interval =
+      symbol.GetFairValueConfigSnapshot()->config.refresh_interval;
+  if (interval == 0)
+    interval = symbol.GetRefreshInterval();
+  return interval > 0 ? interval : GetLoopInterval();
+}
+
+void Group::UpdateSymbols(const GroupInformation& group) {
+  const std::vector<std::string>& symbol_names = group.symbols;
+  precision_ = group.precision;
+  symbol_precisions_ = group.symbol_precisions;
+  loop_interval_ = group.loop_interval;
+  symbol_intervals_ = group.symbol_intervals;
+  if (!IsSameStatistics(*GetStatisticsConfig(), group.statistics)) {
+    LOG(INFO) << "Update statistics of group " << name_;
+    std::atomic_store(&statistics_config_,
+        std::shared_ptr<const SymbolStatistics::Config>(
+            new SymbolStatistics::Config(group.statistics)));
+  }
+
+  std::shared_ptr<const SymbolList> old_symbols = GetSymbols();
+  std::shared_ptr<SymbolList> new_symbols(new SymbolList());
+
+  auto find_old_symbol = [&old_symbols](const std::string& symbol_name) {
+    return std::find_if(old_symbols->begin(), old_symbols->end(),
+        [&symbol_name](const std::shared_ptr<Symbol>& symbol) {
+          return symbol->GetSymbolName() == symbol_name;
+        });
+  };
+
+  // Config of new symbols is read by connection of main thread (if they are
+  // not cached).
+  std::vector<std::string> added_names;
+  for (auto& symbol_name : symbol_names) {
+    if (find_old_symbol(symbol_name) == old_symbols->end())
+      added_names.push_back(symbol_name);
+  }
+  std::vector<std::string> cached_names;
+  SymbolList added_symbols;
+  if (!added_names.empty()) {
+    redis::client::Client* redis_client = GetRedisClient();
+    if (redis_client == nullptr && outputs_.config_cache == nullptr) {
+      LOG(ERROR) << "Cannot connect to redis, symbols of group " << name_
+                 << " are not updated.";
+      return;
+    }
+    added_symbols = CreateSymbols(redis_client, added_names, cached_names);
+  }
+
+  size_t added_index = 0;
+  for (auto& symbol_name : symbol_names) {
+    auto it = find_old_symbol(symbol_name);
+    if (it != old_symbols->end()) {
+      (*it)->SetPrecision(GetSymbolPrecision(symbol_name));
+      (*it)->SetRefreshInterval(GetSymbolRefreshInterval(symbol_name));
+      new_symbols->push_back(*it);
+      continue;
+    }
+
+    std::shared_ptr<Symbol>& symbol = added_symbols[added_index++];
+    if (symbol) {
+      LOG(INFO) << "Add symbol " << symbol_name << " to group " << name_;
+      new_symbols->push_back(symbol);
+    }
+  }
+
+  for (auto& symbol : *old_symbols) {
+    if (std::find(symbol_names.begin(), symbol_names.end(),
+                  symbol->GetSymbolName()) == symbol_names.end())
+      LOG(INFO) << "Remove symbol " << symbol->GetSymbolName()
+                << " from group " << name_;
+  }
+
+  // Retired symbols are released when loop and event threads are done with
+  // old list.
+  std::atomic_store(&symbols_,
+                    std::shared_ptr<const SymbolList>(std::move(new_symbols)));
+  RevalidatePEConfigs(cached_names);
+}
+
+void Group::SaveSnapshot() {
+  if (!HoldsLease())
     return;
+  redis::client::Client* redis_client = GetRedisClient();
+  if (redis_client == nullptr)
+    return;
+
+  // History is where it is calculated: in |pricing_core_| or in symbols.
+  // Saved as array of doubles (native byte order, same as tick journal).
+  std::vector<std::string> keys;
+  std::vector<std::string> values;
+  auto add = [&keys, &values](const std::string& symbol_name,
+                              const std::vector<double>& history) {
+    keys.push_back(kClusterSnapshotPrefix + symbol_name);
+    values.push_back(std::string(
+        reinterpret_cast<const char*>(history.data()),
+        history.size() * sizeof(double)));
+  };
+  if (pricing_core_type_ == PRICING_CORE_SOA) {
+    for (size_t row = 0; row < pricing_core_symbols_.size(); row++)
+      add(pricing_core_.GetSymbolName(row), pricing_core_.GetHistory(row));
+  } else {
+    for (auto& symbol : *GetSymbols())
+      add(symbol->GetSymbolName(), symbol->GetFairValueHistory());
   }
 
-  // Create async connect to redis server.
-  async_connect_ = redis::async_connect::CreateAsyncConnect(
-      redis_info.host, redis_info.port);
-  if (async_connect_ == nullptr)
+  redis::client::SetMany(redis_client, keys, values, kSnapshotExpireTime);
+}
+
+void Group::LoadSnapshot() {
+  redis::client::Client* redis_client = GetRedisClient();
+  if (redis_client == nullptr)
     return;
 
-  // Attach the redisAsyncContext to event_base of libevent.
-  redisLibeventAttach(async_connect_, event_base);
+  std::shared_ptr<const SymbolList> symbols = GetSymbols();
+  std::vector<std::string> keys;
+  for (auto& symbol : *symbols)
+    keys.push_back(kClusterSnapshotPrefix + symbol->GetSymbolName());
+
+  // Rows of |pricing_core_| take history from symbols when they are added.
+  std::vector<std::string> values = redis::client::MGet(redis_client, keys);
+  size_t count = 0;
+  for (size_t i = 0; i < values.size() && i < symbols->size(); i++) {
+    const std::string& value = values[i];
+    if (value.empty() || value.size() % sizeof(double) != 0)
+      continue;
+
+    std::vector<double> history(value.size() / sizeof(double));
+    memcpy(history.data(), value.data(), value.size());
+    (*symbols)[i]->LoadFairValueHistory(history);
+    count++;
+  }
+  LOG(INFO) << "Load history of " << count << " symbol(s) of group "
+            << name_ << " from snapshot.";
+}
+
+// static
+void Group::Retire(std::unique_ptr<Group> group) {
+  LOG(INFO) << "Retire group " << group->GetName();
+  group->StopLoop();
+  // Configs which are read already are applied before |group| is deleted
+  // (tasks of a loop run in order).
+  group->StopConfigReader();
+
+  // Async connection and its callbacks (which refer to |group|) are only
+  // touched on event loop thread, so release them there.
+  IORuntime* io_runtime = group->io_runtime_;
+  size_t io_loop_index = group->io_loop_index_;
+  Group* retired_group = group.release();
+  io_runtime->Post(io_loop_index, [retired_group]() {
+    // Callbacks of pending commands and subscription are called (without
+    // reply) right now, not after |retired_group| is deleted. Disconnect
+    // callbacks do not touch |retired_group|.
+    for (redisAsyncContext* async_connect :
+         {retired_group->async_connect_, retired_group->config_connect_}) {
+      if (async_connect == nullptr)
+        continue;
+      async_connect->data = nullptr;
+      redisAsyncFree(async_connect);
+    }
+    if (retired_group->config_refresh_timer_ != nullptr)
+      event_free(retired_group->config_refresh_timer_);
+    if (retired_group->reconnect_timer_ != nullptr)
+      event_free(retired_group->reconnect_timer_);
+    delete retired_group;
+  });
+}
+
+void Group::InitializeAsyncConnect() {
+  struct event_base* event_base = io_runtime_->GetEventBase(io_loop_index_);
+  config_refresh_timer_ = evtimer_new(
+      event_base,
+      [](evutil_socket_t, short, void* group) {
+        static_cast<Group*>(group)->RefreshPEConfigs();
+      },
+      this);
+  reconnect_timer_ = evtimer_new(
+      event_base,
+      [](evutil_socket_t, short, void* group) {
+        static_cast<Group*>(group)->ConnectAsync(true);
+      },
+      this);
+  ConnectAsync(false);
+}
+
+void Group::ConnectAsync(bool reconnect) {
+  bool subscribed = false;
+  if (async_connect_ == nullptr) {
+    async_connect_ = CreateAsyncConnect();
+    if (async_connect_ != nullptr) {
+      using namespace std::placeholders;
+      redis::async_connect::Subscribe(
+          async_connect_, kPEConfigChannel,
+          std::bind(&Group::OnPEConfigUpdated, this, _1));
+      subscribed = true;
+    }
+  }
+
+  // Subscribing connection cannot send other commands, so updated configs
+  // are read on another one.
+  if (config_connect_ == nullptr)
+    config_connect_ = CreateAsyncConnect();
+
+  if (async_connect_ == nullptr || config_connect_ == nullptr)
+    ScheduleReconnect();
+  // Refreshes which waited for |config_connect_|.
+  if (config_connect_ != nullptr && !pending_config_symbols_.empty())
+    SchedulePEConfigRefresh(std::vector<std::string>());
+
+  // Notifications are missed while there is no subscription, so configs of
+  // all symbols are read again.
+  if (reconnect && subscribed) {
+    std::vector<std::string> symbol_names;
+    for (auto& symbol : *GetSymbols())
+      symbol_names.push_back(symbol->GetSymbolName());
+    SchedulePEConfigRefresh(symbol_names);
+  }
+}
+
+redisAsyncContext* Group::CreateAsyncConnect() {
+  redisAsyncContext* async_connect =
+      redis::async_connect::CreateAsyncConnect(redis_info_);
+  if (async_connect == nullptr)
+    return nullptr;
+
+  // Attach the redisAsyncContext to event_base of libevent. Pub/sub
+  // messages (to all groups) are parsed into pooled replies.
+  redisLibeventAttach(async_connect,
+                      io_runtime_->GetEventBase(io_loop_index_));
+  redis::async_connect::UsePooledReplies(async_connect);
+
+  // hiredis frees connection by itself if it cannot connect or it is lost,
+  // callbacks forget it then.
+  async_connect->data = this;
+  redisAsyncSetConnectCallback(async_connect, &Group::OnAsyncConnected);
+  redisAsyncSetDisconnectCallback(async_connect, &Group::OnAsyncDisconnected);
 
-  // Register all callbacks for async connection here, before
-  // |event_base_dispatch()| function is called on main().
   using namespace std::placeholders;
   redis::async_connect::Authenticate(
-      async_connect_, redis_info.password,
+      async_connect, redis_info_.password,
       std::bind(&Group::OnAsyncConnectAuthenticated, this, _1));
+  return async_connect;
+}
 
-  redis::async_connect::Subscribe(
-      async_connect_, kPEConfigChannel,
-      std::bind(&Group::OnPEConfigUpdated, this, _1));
+// static
+void Group::OnAsyncConnected(const redisAsyncContext* context, int status) {
+  if (status == REDIS_OK)
+    return;
 
-  // Create |Symbol| objects correspond with symbol list in the setting file.
-  for (auto& symbol_name : group.symbols) {
-    // Get fair value configuration at the first time.
-    FairValueConfig fair_value_config;
-    if (!GetPEConfigFromRedis(symbol_name, fair_value_config)) {
-      LOG(ERROR) << "Cannot get PE config for symbol " << symbol_name
-                 << ". Ignore this symbol, please restart application.";
-      continue;
-    }
+  Group* group = static_cast<Group*>(context->data);
+  if (group == nullptr)
+    return;
+  LOG(ERROR) << "Cannot connect async connection of group " << group->name_
+             << ": " << context->errstr;
+  group->ForgetAsyncConnect(context);
+}
 
-    // Save instances of |Symbol| into a vector to refer later.
-    std::unique_ptr<Symbol> symbol(
-        new Symbol(symbol_name, fair_value_config, redis_client_));
-    symbols_.push_back(std::move(symbol));
-  }
+// static
+void Group::OnAsyncDisconnected(const redisAsyncContext* context,
+                                int status) {
+  // |data| is cleared when group is retired.
+  Group* group = static_cast<Group*>(context->data);
+  if (group == nullptr)
+    return;
+  LOG(ERROR) << "Async connection of group " << group->name_
+             << " is lost: " << context->errstr << ", reconnect.";
+  group->ForgetAsyncConnect(context);
+}
+
+void Group::ForgetAsyncConnect(const redisAsyncContext* context) {
+  // hiredis frees |context| after callback.
+  if (context == async_connect_)
+    async_connect_ = nullptr;
+  else if (context == config_connect_)
+    config_connect_ = nullptr;
+  ScheduleReconnect();
+}
+
+void Group::ScheduleReconnect() {
+  if (reconnect_timer_ == nullptr ||
+      evtimer_pending(reconnect_timer_, nullptr))
+    return;
+  struct timeval delay = {kReconnectTime / 1000,
+                          (kReconnectTime % 1000) * 1000};
+  evtimer_add(reconnect_timer_, &delay);
 }
 
 void Group::StartLoop() {
@@ -94,7 +741,8 @@ void Group::StartLoop() {
 
 void Group::StopLoop() {
   stop_loop_ = true;
-  loop_thread_.join();
+  if (loop_thread_.joinable())
+    loop_thread_.join();
 }
 
 void Group::OnAsyncConnectAuthenticated(redisReply* reply) {
@@ -110,40 +758,179 @@ void Group::OnPEConfigUpdated(redisReply* reply) {
   LOG(INFO) << "OnPEConfigUpdated()";
 
   // Small check to be sure that data is valid.
-  if (reply == nullptr ||
-      reply->type != REDIS_REPLY_ARRAY ||
-      reply->elements != 3)
+  redis::ReplyView view(reply);
+  if (view.Size() != 3)
     return;
 
   // In some cases, message can be NULL. So a judgment is necessary.
-  if (reply->element[2]->str == nullptr)
+  // Message is read in place, no copy for symbols of other groups.
+  common::StringView message = view.Element(2).String();
+  if (message.empty())
     return;
-  std::string message = std::string(reply->element[2]->str);
 
   // This callback is notified to all symbols eventhough we just update
   // a symbol, so we just update which symbol is named in message.
-  for (auto& symbol : symbols_) {
-    if (message == symbol->GetSymbolName()) {
-      FairValueConfig fair_value_config;
-      if (GetPEConfigFromRedis(message, fair_value_config))
-        symbol->UpdateFairValueConfig(fair_value_config);
+  std::shared_ptr<const SymbolList> symbols = GetSymbols();
+  auto it = std::find_if(symbols->begin(), symbols->end(),
+      [&message](const std::shared_ptr<Symbol>& symbol) {
+        return message == symbol->GetSymbolName();
+      });
+  if (it == symbols->end())
+    return;
+
+  // NOP saves many symbols at once, wait a little to refresh them together.
+  SchedulePEConfigRefresh(
+      std::vector<std::string>(1, (*it)->GetSymbolName()));
+}
+
+void Group::SchedulePEConfigRefresh(
+    const std::vector<std::string>& symbol_names) {
+  pending_config_symbols_.insert(symbol_names.begin(), symbol_names.end());
+  if (config_refresh_timer_ != nullptr &&
+      !evtimer_pending(config_refresh_timer_, nullptr)) {
+    struct timeval delay = {0, kConfigRefreshDelay * 1000};
+    evtimer_add(config_refresh_timer_, &delay);
+  }
+}
 
+void Group::RevalidatePEConfigs(const std::vector<std::string>& cached_names) {
+  if (cached_names.empty())
+    return;
+
+  // Tasks of the loop run in order, so timer of |InitializeAsyncConnect()| is
+  // created already.
+  io_runtime_->Post(io_loop_index_, [this, cached_names]() {
+    SchedulePEConfigRefresh(cached_names);
+  });
+}
+
+void Group::RefreshPEConfigs() {
+  if (pending_config_symbols_.empty())
+    return;
+
+  std::vector<std::string> symbol_names(pending_config_symbols_.begin(),
+                                        pending_config_symbols_.end());
+  if (config_reader_thread_.joinable()) {
+    pending_config_symbols_.clear();
+    std::lock_guard<std::mutex> lock(config_reader_mutex_);
+    config_reader_symbols_.insert(config_reader_symbols_.end(),
+                                  symbol_names.begin(), symbol_names.end());
+    config_reader_condition_.notify_one();
+    return;
+  }
+  if (config_connect_ == nullptr)
+    return;
+
+  std::vector<std::string> args;
+  pending_config_symbols_.clear();
+  args.reserve(symbol_names.size() + 1);
+  args.push_back("MGET");
+  for (auto& symbol_name : symbol_names)
+    args.push_back(std::string(kPEConfigPrefix) + symbol_name);
+
+  VLOG(1) << "Refresh PE config of " << symbol_names.size()
+          << " symbol(s) in group " << name_;
+  redis::async_connect::Command(config_connect_, args,
+      [this, symbol_names](redisReply* reply) {
+        OnPEConfigsReceived(symbol_names, reply);
+      });
+}
+
+void Group::RunConfigReader() {
+  common::SetCurrentThreadName("pe_cfg_" + name_);
+  std::unique_lock<std::mutex> lock(config_reader_mutex_);
+  while (true) {
+    config_reader_condition_.wait(lock, [this]() {
+      return stop_config_reader_ || !config_reader_symbols_.empty();
+    });
+    if (stop_config_reader_)
+      return;
+
+    std::vector<std::string> symbol_names;
+    symbol_names.swap(config_reader_symbols_);
+    lock.unlock();
+
+    // Pipelines to nodes in parallel.
+    std::vector<std::string> keys;
+    keys.reserve(symbol_names.size());
+    for (auto& symbol_name : symbol_names)
+      keys.push_back(std::string(kPEConfigPrefix) + symbol_name);
+    VLOG(1) << "Refresh PE config of " << symbol_names.size()
+            << " symbol(s) in group " << name_;
+    redis::client::Client* redis_client = GetRedisClient();
+    std::shared_ptr<std::vector<std::string>> values(
+        new std::vector<std::string>());
+    if (redis_client != nullptr)
+      *values = redis::client::MGet(redis_client, keys);
+    if (values->size() != symbol_names.size()) {
+      LOG(ERROR) << "Cannot read PE config of group " << name_;
+    } else {
+      io_runtime_->Post(io_loop_index_, [this, symbol_names, values]() {
+        std::shared_ptr<const SymbolList> symbols = GetSymbols();
+        for (size_t i = 0; i < symbol_names.size(); i++)
+          UpdatePEConfig(*symbols, symbol_names[i], (*values)[i]);
+      });
+    }
+    lock.lock();
+  }
+}
+
+void Group::StopConfigReader() {
+  if (!config_reader_thread_.joinable())
+    return;
+  {
+    std::lock_guard<std::mutex> lock(config_reader_mutex_);
+    stop_config_reader_ = true;
+  }
+  config_reader_condition_.notify_one();
+  config_reader_thread_.join();
+}
+
+void Group::OnPEConfigsReceived(const std::vector<std::string>& symbol_names,
+                                redisReply* reply) {
+  redis::ReplyView view(reply);
+  if (view.Size() != symbol_names.size()) {
+    LOG(ERROR) << "Cannot read PE config of group " << name_ << ": "
+               << view.String();
+    return;
+  }
+
+  std::shared_ptr<const SymbolList> symbols = GetSymbols();
+  for (size_t i = 0; i < symbol_names.size(); i++)
+    UpdatePEConfig(*symbols, symbol_names[i], view.Element(i).String());
+}
+
+void Group::UpdatePEConfig(const SymbolList& symbols,
+                           const std::string& symbol_name,
+                           common::StringView value) {
+  FairValueConfig fair_value_config;
+  if (value.empty() || !ParsePEConfig(value, fair_value_config)) {
+    LOG(ERROR) << "Cannot get PE config for symbol " << symbol_name;
+    return;
+  }
+
+  // Symbols get new snapshots, loop thread uses them from next calculation.
+  for (auto& symbol : symbols) {
+    if (symbol->GetSymbolName() == symbol_name) {
+      symbol->UpdateFairValueConfig(fair_value_config);
       break;
     }
   }
+  if (outputs_.config_cache != nullptr)
+    outputs_.config_cache->Put(symbol_name, fair_value_config);
 }
 
-bool Group::GetPEConfigFromRedis(const std::string& symbol_name,
-                                 FairValueConfig& fair_value_config) {
-  // Read value of PE configuration key from redis.
-  std::string message =
-      redis::client::Get(redis_client_,
-          std::string(kPEConfigPrefix) + symbol_name);
-  if (message.empty())
+// static
+bool Group::ParsePEConfig(common::StringView message,
+                          FairValueConfig& fair_value_config) {
+  // Extract setting values from json value, parsed in place.
+  nlohmann::json json =
+      nlohmann::json::parse(message.begin(), message.end(), nullptr, false);
+  if (json.is_discarded()) {
+    LOG(ERROR) << "Invalid PE config: " << message;
     return false;
+  }
 
-  // Extract setting values from json value.
-  nlohmann::json json = nlohmann::json::parse(message);
   try {
     // TODO(hoangpq): Currently, calculate_method and fixed_price send from NOP
     // are string. Plz change to number for easy handling.
@@ -181,6 +968,14 @@ bool Group::GetPEConfigFromRedis(const std::string& symbol_name,
     fair_value_config.skew_percent = skew[kSkewPercentKey].get<double>();
 
     fair_value_config.moving_average = json[kMovingAverageKey].get<int>();
+
+    // Optional, interval of configuration file is used if not set.
+    auto interval = json.find(kRefreshIntervalKey);
+    fair_value_config.refresh_interval =
+        interval != json.end() && interval->is_number() &&
+        interval->get<double>() > 0
+        ? static_cast<uint64_t>(interval->get<double>())
+        : 0;
   } catch (std::exception e) {
     LOG(ERROR) << "Error while reading PE config from redis: \n"
                << "message = " << json;
@@ -190,68 +985,473 @@ bool Group::GetPEConfigFromRedis(const std::string& symbol_name,
   return true;
 }
 
+redis::client::Client* Group::GetRedisClient() {
+  return redis::client::GetThreadClient(redis_info_);
+}
+
 void Group::SendFairValueToRedis(
-    const std::string& symbol_name,
-    double fair_value,
-    double moving_average,
-    double standard_deviation_ratio) {
-  nlohmann::json json;
+    redis::client::Client* redis_client,
+    const std::vector<FairValueData>& data_list) {
+  if (data_list.empty())
+    return;
+
+  // In batch publish modes, one message contains data of all symbols.
+  std::string batch_message;
+  if (publish_mode_ != PUBLISH_SYMBOL_NAME)
+    batch_message = BuildBatchNotification(data_list, *loop_statistics_config_,
+                                           publish_mode_);
+
+  FairValueRecords records;
+  BuildFairValueRecords(data_list, *loop_statistics_config_,
+                        redis_storage_mode_, records);
+
+  if (redis_write_mode_ == REDIS_WRITE_SCRIPT) {
+    // One command for all symbols, data and notification are sent on the
+    // same connection, so subscribers always read the new data.
+    std::vector<std::string> keys;
+    std::vector<std::string> args;
+    std::string message;
+    keys.reserve(records.json_keys.size() + records.hash_keys.size());
+    keys.insert(keys.end(), records.json_keys.begin(),
+                records.json_keys.end());
+    keys.insert(keys.end(), records.hash_keys.begin(),
+                records.hash_keys.end());
+    args.reserve(records.hash_fields.size() + records.json_values.size() +
+                 records.hash_values.size() + 4);
+    args.push_back(kFairValueChannel);
+    args.push_back(std::string());
+    args.push_back(std::to_string(records.json_keys.size()));
+    args.push_back(std::to_string(records.hash_fields.size()));
+    args.insert(args.end(), records.hash_fields.begin(),
+                records.hash_fields.end());
+    args.insert(args.end(), records.json_values.begin(),
+                records.json_values.end());
+    args.insert(args.end(), records.hash_values.begin(),
+                records.hash_values.end());
+    for (auto& data : data_list) {
+      if (!message.empty())
+        message += ',';
+      message += data.symbol_name;
+    }
+    args[1] = publish_mode_ == PUBLISH_SYMBOL_NAME ? message : batch_message;
 
-  // Set data to json.
-  uint64_t now = common::GetCurrentTimestamp();
-  json[kTimestampKey] = std::to_string(now);
-  json[kFairValueKey] = std::to_string(fair_value);
-  json[kFairValueMVKey] = std::to_string(moving_average);
-  json[kStdDevRatioKey] = std::to_string(standard_deviation_ratio);
+    redis::client::EvalSha(redis_client, set_and_publish_script_, keys, args);
+    return;
+  }
+
+  // Send data of all symbols to redis in one pipeline (one per node of a
+  // redis cluster).
+  if (records.hash_keys.empty()) {
+    redis::client::SetMany(redis_client, records.json_keys,
+                           records.json_values, 0);
+  } else {
+    // SET of JSON records (if they are kept), then HSET of hashes.
+    size_t field_number = records.hash_fields.size();
+    std::vector<std::vector<common::StringView>> commands;
+    commands.reserve(records.json_keys.size() + records.hash_keys.size());
+    for (size_t i = 0; i < records.json_keys.size(); i++)
+      commands.push_back({"SET", records.json_keys[i],
+                          records.json_values[i]});
+    for (size_t i = 0; i < records.hash_keys.size(); i++) {
+      commands.emplace_back();
+      std::vector<common::StringView>& command = commands.back();
+      command.reserve(field_number * 2 + 2);
+      command.push_back("HSET");
+      command.push_back(records.hash_keys[i]);
+      for (size_t j = 0; j < field_number; j++) {
+        command.push_back(records.hash_fields[j]);
+        command.push_back(records.hash_values[i * field_number + j]);
+      }
+    }
 
-  // Send data to redis.
-  redis::client::Set(redis_client_,
-      std::string(kFairValuePrefix) + symbol_name,
-      json.dump());
+    std::vector<redis::Reply> replies =
+        redis::client::Pipeline(redis_client, commands);
+    for (size_t i = 0; i < replies.size(); i++) {
+      if (!replies[i] || replies[i].IsError()) {
+        LOG(ERROR) << "Cannot write fair value record " << commands[i][1]
+                   << ": " << replies[i].String();
+        break;
+      }
+    }
+  }
+
+  // Hand publish commands off to event loop thread of this group, they are
+  // pipelined on the command connection of that loop (|async_connect_| is
+  // subscribing, it cannot publish).
+  std::vector<std::string> messages;
+  if (publish_mode_ != PUBLISH_SYMBOL_NAME) {
+    messages.push_back(std::move(batch_message));
+  } else {
+    messages.reserve(data_list.size());
+    for (auto& data : data_list)
+      messages.push_back(data.symbol_name);
+  }
 
-  redis::async_connect::Publish(async_connect_,
-      std::string(kFairValueChannel),
-      symbol_name,
-      nullptr);
+  // |this| is valid, it is deleted on the same loop after loop thread is
+  // stopped (see |Retire()|).
+  io_runtime_->Post(io_loop_index_, [this, messages]() {
+    redis::async_connect::GetThreadCommandConnection(
+        redis_info_, io_runtime_->GetEventBase(io_loop_index_))
+        ->Publish(kFairValueChannel, messages);
+  });
+}
+
+void Group::CalculateBySymbols(redis::client::Client* redis_client,
+                               const SymbolList& symbols,
+                               std::vector<FairValueData>& data_list) {
+  FairValueInputs inputs;
+  for (auto& symbol : symbols) {
+    symbol->ReadInputs(redis_client, redis_storage_mode_,
+                       loop_time_.GetWallClockMs(), inputs);
+    common::Decimal fv = symbol->CalculateFairValue(inputs);
+
+    double mv = 0.0;
+    double std_dev = 0.0;
+    double std_dev_ratio = 0.0;
+    if (fv.IsPositive())
+      symbol->CalculateMovingAverage(mv, std_dev, std_dev_ratio);
+
+    FairValueData data;
+    data.symbol_name = symbol->GetSymbolName();
+    data.shm_symbol_id = symbol->GetShmSymbolId();
+    data.timestamp = common::ToUint64(loop_time_.GetWallClockMs());
+    data.fair_value = fv;
+    data.moving_average = mv;
+    data.standard_deviation_ratio = std_dev_ratio;
+    // Ticks which have no fair value are recorded too.
+    if (outputs_.tick_journal != nullptr)
+      AddJournalRecord(symbol.get(), inputs, data);
+    if (!fv.IsPositive())
+      continue;
+
+    // Logging
+    LOG(INFO) << "Generated fair value for [" << symbol->GetSymbolName()
+              << "]: fair_value = " << fv.ToString() << ", "
+              << "moving_average = " << mv << ", "
+              << "std_dev = " << std_dev << ", "
+              << "std_dev_ratio = " << std_dev_ratio;
+
+    UpdateStatistics(symbol.get(), data);
+    data_list.push_back(data);
+  }
+}
+
+void Group::SyncPricingCore(
+    const std::shared_ptr<const SymbolList>& symbols) {
+  // Remove rows of retired symbols, keep the others (and their history).
+  for (size_t row = pricing_core_symbols_.size(); row-- > 0;) {
+    if (std::find(symbols->begin(), symbols->end(),
+                  pricing_core_symbols_[row]) != symbols->end())
+      continue;
+
+    pricing_core_.RemoveSymbol(row);
+    pricing_core_symbols_[row] = pricing_core_symbols_.back();
+    pricing_core_symbols_.pop_back();
+    pricing_core_config_versions_[row] = pricing_core_config_versions_.back();
+    pricing_core_config_versions_.pop_back();
+    pricing_core_configs_[row] = pricing_core_configs_.back();
+    pricing_core_configs_.pop_back();
+  }
+
+  // Add rows of new symbols.
+  for (auto& symbol : *symbols) {
+    if (std::find(pricing_core_symbols_.begin(), pricing_core_symbols_.end(),
+                  symbol) != pricing_core_symbols_.end())
+      continue;
+
+    std::shared_ptr<const FairValueConfigSnapshot> snapshot =
+        symbol->GetFairValueConfigSnapshot();
+    pricing_core_config_versions_.push_back(snapshot->version);
+    pricing_core_configs_.push_back(snapshot->config);
+    size_t row = pricing_core_.AddSymbol(symbol->GetSymbolName(),
+                                         pricing_core_configs_.back());
+    pricing_core_symbols_.push_back(symbol);
+    // History loaded from snapshot (see |LoadSnapshot()|).
+    std::vector<double> history = symbol->GetFairValueHistory();
+    if (!history.empty())
+      pricing_core_.LoadHistory(row, history);
+  }
+
+  pricing_core_symbol_list_ = symbols;
+}
+
+void Group::CalculateByPricingCore(
+    redis::client::Client* redis_client,
+    const std::shared_ptr<const SymbolList>& symbols,
+    std::vector<FairValueData>& data_list) {
+  if (symbols != pricing_core_symbol_list_)
+    SyncPricingCore(symbols);
+
+  // Apply settings which are updated by NOP.
+  for (size_t row = 0; row < pricing_core_symbols_.size(); row++) {
+    Symbol* symbol = pricing_core_symbols_[row].get();
+    uint64_t version = symbol->GetConfigVersion();
+    if (version != pricing_core_config_versions_[row]) {
+      std::shared_ptr<const FairValueConfigSnapshot> snapshot =
+          symbol->GetFairValueConfigSnapshot();
+      pricing_core_config_versions_[row] = snapshot->version;
+      pricing_core_configs_[row] = snapshot->config;
+      pricing_core_.UpdateConfig(row, pricing_core_configs_[row]);
+    }
+  }
+
+  // Each leg is read once, even if it is used by many symbols.
+  pricing_core_leg_prices_.resize(pricing_core_.GetLegNumber());
+  for (size_t leg = 0; leg < pricing_core_.GetLegNumber(); leg++) {
+    pricing_core_leg_prices_[leg] = Symbol::GetBaseCurrencyFairValue(
+        redis_client, redis_storage_mode_, pricing_core_.GetLegName(leg),
+        loop_time_.GetWallClockMs());
+    pricing_core_.SetLegPrice(leg, pricing_core_leg_prices_[leg].ToDouble());
+  }
+
+  pricing_core_.Calculate();
+
+  uint64_t now = common::ToUint64(loop_time_.GetWallClockMs());
+  for (size_t row = 0; row < pricing_core_symbols_.size(); row++) {
+    // Values are calculated in double, then rounded to precision of symbol.
+    Symbol* symbol = pricing_core_symbols_[row].get();
+    int precision = symbol->GetPrecision();
+    common::Decimal fv = common::Decimal::FromDouble(
+        pricing_core_.GetFairValue(row), precision);
+
+    FairValueData data;
+    data.symbol_name = pricing_core_.GetSymbolName(row);
+    data.shm_symbol_id = symbol->GetShmSymbolId();
+    data.timestamp = now;
+    data.fair_value = fv;
+    data.moving_average = pricing_core_.GetMovingAverage(row);
+    data.standard_deviation_ratio =
+        pricing_core_.GetStandardDeviationRatio(row);
+
+    if (outputs_.tick_journal != nullptr) {
+      FairValueInputs inputs;
+      inputs.config = pricing_core_configs_[row];
+      inputs.config_version = pricing_core_config_versions_[row];
+      inputs.precision = precision;
+      int32_t leg1 = pricing_core_.GetFirstLeg(row);
+      int32_t leg2 = pricing_core_.GetSecondLeg(row);
+      inputs.leg1 = leg1 >= 0 ? pricing_core_leg_prices_[leg1]
+                              : common::Decimal();
+      inputs.leg2 = leg2 >= 0 ? pricing_core_leg_prices_[leg2]
+                              : common::Decimal();
+      AddJournalRecord(symbol, inputs, data);
+    }
+    if (!fv.IsPositive())
+      continue;
+    UpdateStatistics(symbol, data);
+    VLOG(1) << "Generated fair value for [" << data.symbol_name
+            << "]: fair_value = " << fv.ToString() << ", "
+            << "moving_average = " << data.moving_average << ", "
+            << "std_dev_ratio = " << data.standard_deviation_ratio;
+    data_list.push_back(data);
+  }
+}
+
+void Group::UpdateStatistics(Symbol* symbol, FairValueData& data) {
+  SymbolStatistics& statistics = symbol->GetStatistics();
+  if (statistics.GetConfig() != loop_statistics_config_)
+    statistics.Configure(loop_statistics_config_);
+  statistics.Add(common::ToUint64(loop_time_.GetMonotonicMs()),
+                 data.fair_value.ToDouble(), data.statistics);
+}
+
+void Group::AddJournalRecord(Symbol* symbol, const FairValueInputs& inputs,
+                             const FairValueData& data) {
+  TickJournalRecord record;
+  memset(&record, 0, sizeof(record));
+  record.symbol_id = symbol->GetJournalSymbolId();
+  record.pricing_core = pricing_core_type_;
+  strncpy(record.symbol_name, data.symbol_name.c_str(),
+          kTickJournalSymbolNameSize);
+  record.timestamp = data.timestamp;
+  SetTickJournalInputs(inputs, record);
+  record.fair_value_mantissa = data.fair_value.mantissa();
+  record.fair_value_scale = data.fair_value.scale();
+  record.moving_average = data.moving_average;
+  record.standard_deviation_ratio = data.standard_deviation_ratio;
+  journal_records_.push_back(record);
 }
 
 void Group::Loop() {
-  uint64_t loop_interval = Configuration::GetInstance()->GetLoopInterval();
+  common::SetCurrentThreadName("pe_" + name_);
+  common::ConfigureCurrentThread("Loop of group " + name_, thread_info_.cpu,
+                                 thread_info_.realtime_priority,
+                                 thread_info_.nice);
+  if (busy_poll_)
+    LOG(INFO) << "Loop of group " << name_ << " is busy polling.";
 
-  // Each |loop_interval| milliseconds, loop run and generate price for all
-  // symbols.
+  // Loop runs when symbols are due (each symbol is refreshed every its
+  // refresh interval), and generates price of them.
+  std::vector<FairValueData> data_list;
+  common::MonotonicNs next_loop_time = common::GetMonotonicNs();
+  last_jitter_report_time_ = next_loop_time;
+  loop_delays_.clear();
+  schedule_.Reset(common::ToUint64(
+      std::chrono::time_point_cast<std::chrono::milliseconds>(
+          next_loop_time)));
+  scheduled_symbols_.clear();
+  schedule_ids_.clear();
+  free_schedule_ids_.clear();
+  scheduled_symbol_list_.reset();
   while (!stop_loop_) {
-    uint64_t start_time = common::GetCurrentTimestamp();
+    // Intervals and symbol list can be changed by reloading configuration.
+    std::shared_ptr<const SymbolList> symbols = GetSymbols();
+    loop_statistics_config_ = GetStatisticsConfig();
+    loop_time_.Update();
+    uint64_t now = common::ToUint64(loop_time_.GetMonotonicMs());
 
-    for (auto& symbol : symbols_) {
-      double fv = symbol->CalculateFairValue();
-      if (fv <= 0)
-        continue;
+    // Connection of loop thread, it is re-created if it is broken.
+    redis::client::Client* redis_client = GetRedisClient();
+    if (redis_client == nullptr) {
+      LOG(ERROR) << "Cannot connect to redis, skip loop of group " << name_;
+      std::this_thread::sleep_for(std::chrono::milliseconds(kReconnectTime));
+      next_loop_time = common::GetMonotonicNs();
+      continue;
+    }
 
-      double mv = 0.0;
-      double std_dev = 0.0;
-      double std_dev_ratio = 0.0;
-      symbol->CalculateMovingAverage(mv, std_dev, std_dev_ratio);
+    RecordLoopDelay(loop_time_.GetMonotonicNs() - next_loop_time);
+    data_list.clear();
+
+    if (pricing_core_type_ == PRICING_CORE_SOA) {
+      due_ids_.clear();
+      schedule_.Advance(now, due_ids_);
+      if (!schedule_.IsScheduled(kGroupScheduleId)) {
+        CalculateByPricingCore(redis_client, symbols, data_list);
+        schedule_.Schedule(kGroupScheduleId, now + GetLoopInterval());
+      }
+    } else {
+      SyncSchedule(symbols, now);
+      if (CollectDueSymbols(now))
+        CalculateBySymbols(redis_client, due_symbols_, data_list);
+    }
+
+    // Main thread may be blocked while lease of group expires, nothing is
+    // written after another instance can acquire it.
+    if (!HoldsLease()) {
+      LOG_EVERY_N(ERROR, 100) << "Lease of group " << name_
+                              << " may be expired, skip writing.";
+      data_list.clear();
+      journal_records_.clear();
+    }
+
+    // Co-located consumers get price first.
+    if (outputs_.shm_writer != nullptr) {
+      for (auto& data : data_list) {
+        outputs_.shm_writer->Write(data.shm_symbol_id, data.timestamp,
+                                   data.fair_value,
+                                   data.moving_average,
+                                   data.standard_deviation_ratio);
+      }
+    }
+
+    if (outputs_.stream_server != nullptr)
+      outputs_.stream_server->Publish(data_list);
+    if (outputs_.multicast_publisher != nullptr)
+      outputs_.multicast_publisher->Publish(data_list);
+
+    if (outputs_.tick_journal != nullptr) {
+      outputs_.tick_journal->Append(journal_records_);
+      journal_records_.clear();
+    }
+
+    // Send data of all updated symbols to redis.
+    if (redis_output_enabled_)
+      SendFairValueToRedis(redis_client, data_list);
+
+    if (snapshot_interval_.count() > 0 &&
+        loop_time_.GetMonotonicMs() >=
+            last_snapshot_time_ + snapshot_interval_) {
+      last_snapshot_time_ = loop_time_.GetMonotonicMs();
+      SaveSnapshot();
+    }
+
+    // Wait until next symbols are due (or right now if they are already).
+    // Loop runs at least every interval of group, to apply new symbol list.
+    uint64_t next_time = std::min(schedule_.GetNextTick(),
+                                  now + GetLoopInterval());
+    next_loop_time = common::MonotonicNs(std::chrono::milliseconds(next_time));
+    WaitUntil(next_loop_time);
+  }
+}
+
+bool Group::HoldsLease() const {
+  return common::ToUint64(common::GetMonotonicMs()) < lease_deadline_;
+}
+
+void Group::SyncSchedule(const std::shared_ptr<const SymbolList>& symbols,
+                         uint64_t now) {
+  if (symbols == scheduled_symbol_list_)
+    return;
+  scheduled_symbol_list_ = symbols;
 
-      // Logging
-      LOG(INFO) << "Generated fair value for [" << symbol->GetSymbolName()
-                << "]: fair_value = " << fv << ", "
-                << "moving_average = " << mv << ", "
-                << "std_dev = " << std_dev << ", "
-                << "std_dev_ratio = " << std_dev_ratio;
+  std::set<const Symbol*> current;
+  for (auto& symbol : *symbols) {
+    current.insert(symbol.get());
+    if (schedule_ids_.count(symbol.get()) != 0)
+      continue;
 
-      // Send data to redis.
-      SendFairValueToRedis(symbol->GetSymbolName(),
-                           fv, mv, std_dev_ratio);
+    uint32_t id;
+    if (free_schedule_ids_.empty()) {
+      id = scheduled_symbols_.size();
+      scheduled_symbols_.push_back(symbol);
+    } else {
+      id = free_schedule_ids_.back();
+      free_schedule_ids_.pop_back();
+      scheduled_symbols_[id] = symbol;
     }
+    schedule_ids_[symbol.get()] = id;
+    schedule_.Schedule(id, now);
+  }
 
-    // Use these values to analyze performance when necessary.
-    uint64_t stop_time = common::GetCurrentTimestamp();
-    uint64_t execution_time = stop_time - start_time;
-    uint64_t sleep_time =
-        (execution_time >= loop_interval) ? 0 : (loop_interval - execution_time);
+  for (auto it = schedule_ids_.begin(); it != schedule_ids_.end();) {
+    if (current.count(it->first) != 0) {
+      ++it;
+      continue;
+    }
+    schedule_.Cancel(it->second);
+    scheduled_symbols_[it->second].reset();
+    free_schedule_ids_.push_back(it->second);
+    it = schedule_ids_.erase(it);
+  }
+}
 
-    // Wait until next loop.
-    std::this_thread::sleep_for(std::chrono::milliseconds(sleep_time));
+bool Group::CollectDueSymbols(uint64_t now) {
+  due_ids_.clear();
+  schedule_.Advance(now, due_ids_);
+  due_symbols_.clear();
+  for (uint32_t id : due_ids_) {
+    std::shared_ptr<Symbol>& symbol = scheduled_symbols_[id];
+    due_symbols_.push_back(symbol);
+    schedule_.Schedule(id, now + GetRefreshInterval(*symbol));
   }
-}
\ No newline at end of file
+  return !due_symbols_.empty();
+}
+
+void Group::WaitUntil(common::MonotonicNs time) {
+  if (!busy_poll_) {
+    std::this_thread::sleep_until(time);
+    return;
+  }
+
+  // No sleep/wake up latency, and no migration while waiting.
+  while (!stop_loop_ && common::GetMonotonicNs() < time)
+    common::CpuRelax();
+}
+
+void Group::RecordLoopDelay(std::chrono::nanoseconds delay) {
+  loop_delays_.push_back(delay.count());
+  if (loop_time_.GetMonotonicNs() - last_jitter_report_time_ <
+      std::chrono::seconds(kJitterReportInterval))
+    return;
+  last_jitter_report_time_ = loop_time_.GetMonotonicNs();
+
+  // Percentiles of delays (microseconds).
+  std::sort(loop_delays_.begin(), loop_delays_.end());
+  size_t n = loop_delays_.size();
+  LOG(INFO) << "Loop jitter of group " << name_ << " (" << n << " loops, "
+            << (busy_poll_ ? "busy poll" : "sleep") << "): p50 = "
+            << loop_delays_[n / 2] / 1000.0 << " us, p99 = "
+            << loop_delays_[n * 99 / 100] / 1000.0 << " us, max = "
+            << loop_delays_[n - 1] / 1000.0 << " us";
+  loop_delays_.clear();
+}
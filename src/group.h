@@ -1,26 +1,82 @@
 #ifndef GROUP_H_
 #define GROUP_H_
 
+#include <atomic>
+#include <condition_variable>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <string>
 #include <thread>
 #include <vector>
+#include "common/clock.h"
+#include "common/timing_wheel.h"
+#include "common/shm_price_writer.h"
 #include "configuration.h"
-#include "hiredis/adapters/libevent.h"
+#include "io_runtime.h"
+#include "pe_config_cache.h"
+#include "price_multicast_publisher.h"
+#include "price_stream_server.h"
+#include "pricing_core.h"
 #include "redis_controller.h"
 #include "symbol.h"
+#include "tick_journal.h"
+
+// Outputs (other than redis) which fair value data is written to, and local
+// cache of PE configs. They are owned by main() and shared between groups,
+// nullptr if not used.
+struct GroupOutputs {
+  common::ShmPriceWriter* shm_writer = nullptr;
+  TickJournalWriter* tick_journal = nullptr;
+  PEConfigCache* config_cache = nullptr;
+  PriceStreamServer* stream_server = nullptr;
+  PriceMulticastPublisher* multicast_publisher = nullptr;
+};
 
 class Group {
 public:
+  typedef std::vector<std::shared_ptr<Symbol>> SymbolList;
+
   Group();
   Group(const RedisServerInformation& redis_info,
         const GroupInformation& group_info,
-        struct event_base* event_base);
+        IORuntime* io_runtime,
+        const GroupOutputs& outputs);
   virtual ~Group();
 
   // Control generated price loop.
   void StartLoop();
   void StopLoop();
 
+  const std::string& GetName() { return name_; }
+
+  // Apply new symbol list of this group (after configuration file is
+  // reloaded). New symbols are created, removed symbols are retired, and
+  // existing symbols are kept as is (with their fair value history, only
+  // precision is updated). Loop is not paused, it uses new list from next
+  // loop.
+  // Called on main thread.
+  void UpdateSymbols(const GroupInformation& group_info);
+
+  // Save fair value history of all symbols to redis (snapshot), so this
+  // group can be warm started by another PE instance (cluster mode). Called
+  // periodically by loop, or after loop is stopped.
+  void SaveSnapshot();
+  // Load fair value history of all symbols from redis. Called before loop is
+  // started.
+  void LoadSnapshot();
+
+  // Limit writes of this group to time before |deadline| (monotonic,
+  // milliseconds), when its cluster lease may expire. Not limited by default
+  // (not in cluster mode). Called on main thread, by each update of lease.
+  void SetLeaseDeadline(uint64_t deadline) { lease_deadline_ = deadline; }
+
+  // Stop |group| and release it. Async connection is disconnected on its
+  // event loop thread, then |group| is deleted there.
+  static void Retire(std::unique_ptr<Group> group);
+
 private:
   // Event functions of async connection.
   // Called after send command authenticate to redis server.
@@ -28,46 +84,264 @@ private:
   // Called when received notify from NOP that dealer updated configuration.
   // These configuration is set on NOP (not configuration read from file).
   void OnPEConfigUpdated(redisReply* reply);
+  // Read configs of all symbols which are notified by |OnPEConfigUpdated()|
+  // recently, by one MGET on |config_connect_| (by |config_reader_thread_|
+  // on a redis cluster).
+  void RefreshPEConfigs();
+  // Add |symbol_names| to |pending_config_symbols_|, they are refreshed
+  // shortly. Must be run on the event loop thread.
+  void SchedulePEConfigRefresh(const std::vector<std::string>& symbol_names);
+  // Called with reply of MGET which is sent by |RefreshPEConfigs()|.
+  void OnPEConfigsReceived(const std::vector<std::string>& symbol_names,
+                           redisReply* reply);
+  // Thread function of |config_reader_thread_|: read configs of
+  // |config_reader_symbols_|, and apply them on event loop thread.
+  void RunConfigReader();
+  // Stop |config_reader_thread_|. Configs which it read are applied by tasks
+  // which are already posted to event loop.
+  void StopConfigReader();
+  // Apply PE config |value| (json, empty if not read) of |symbol_name| to
+  // its symbol in |symbols| and to config cache.
+  void UpdatePEConfig(const SymbolList& symbols,
+                      const std::string& symbol_name,
+                      common::StringView value);
 
   // Establish connection to redis server, and create |Symbol| objects.
   void Initialize(const RedisServerInformation& redis_info,
-                  const GroupInformation& group_info,
-                  struct event_base* event_base);
+                  const GroupInformation& group_info);
+
+  // Create timers of event loop, and async connections. Must be run on the
+  // event loop thread.
+  void InitializeAsyncConnect();
+  // Create async connections which are not connected, attach them to event
+  // loop of this group and register callbacks. Retried by |reconnect_timer_|
+  // if it failed, configs of all symbols are read again after |reconnect|.
+  // Must be run on the event loop thread.
+  void ConnectAsync(bool reconnect);
+  void ScheduleReconnect();
+  // Create async connection which forgets itself (and schedules reconnect)
+  // when it is closed by hiredis, nullptr if failed.
+  redisAsyncContext* CreateAsyncConnect();
+  void ForgetAsyncConnect(const redisAsyncContext* context);
+  static void OnAsyncConnected(const redisAsyncContext* context, int status);
+  static void OnAsyncDisconnected(const redisAsyncContext* context,
+                                  int status);
 
-  // Read fair value config from redis server.
-  bool GetPEConfigFromRedis(const std::string& symbol_name,
+  // Extract fair value config from json |message| (value of PE config key).
+  static bool ParsePEConfig(common::StringView message,
                             FairValueConfig& fair_value_config);
 
-  // Send fair value data (fair value, moving average, bid, ask, etc.) to redis.
-  void SendFairValueToRedis(const std::string& symbol_name,
-                            double fair_value,
-                            double moving_average,
-                            double standard_deviation_ratio);
+  // Create |Symbol| objects of |symbol_names| (same order, nullptr if config
+  // of symbol cannot be got). Configs are taken from |outputs_.config_cache|
+  // if possible (names of these symbols are appended to |cached_names|, they
+  // must be revalidated), others are read by one MGET on |redis_client| (can
+  // be nullptr if redis is not available).
+  SymbolList CreateSymbols(redis::client::Client* redis_client,
+                           const std::vector<std::string>& symbol_names,
+                           std::vector<std::string>& cached_names);
+  // Create |Symbol| object with |fair_value_config|.
+  std::shared_ptr<Symbol> CreateSymbol(
+      const std::string& symbol_name,
+      const FairValueConfig& fair_value_config);
+  // Read configs of |cached_names| from redis in background (on event loop
+  // thread), symbols are updated if they are changed.
+  void RevalidatePEConfigs(const std::vector<std::string>& cached_names);
+
+  // Precision of |symbol_name| in configuration file.
+  int GetSymbolPrecision(const std::string& symbol_name) const;
+  // Refresh interval of |symbol_name| in configuration file, 0 if not set.
+  uint64_t GetSymbolRefreshInterval(const std::string& symbol_name) const;
+
+  // Refresh interval of group (milliseconds).
+  uint64_t GetLoopInterval() const;
+  // Refresh interval of |symbol| (milliseconds): from its PE config, from
+  // configuration file, or interval of group.
+  uint64_t GetRefreshInterval(Symbol& symbol) const;
+
+  // Get current symbol list. Used by loop and event threads, list can be
+  // replaced by |UpdateSymbols()| at any time.
+  std::shared_ptr<const SymbolList> GetSymbols() const {
+    return std::atomic_load(&symbols_);
+  }
+
+  // Get current statistics config, it is replaced by |UpdateSymbols()| when
+  // statistics are changed.
+  std::shared_ptr<const SymbolStatistics::Config> GetStatisticsConfig() const {
+    return std::atomic_load(&statistics_config_);
+  }
+
+  // Get redis connection of calling thread (see
+  // |redis::client::GetThreadClient()|), nullptr if cannot connect.
+  redis::client::Client* GetRedisClient();
+
+  // Send fair value data (fair value, moving average, bid, ask, etc.) of all
+  // symbols updated in a loop to redis.
+  void SendFairValueToRedis(redis::client::Client* redis_client,
+                            const std::vector<FairValueData>& data_list);
+
+  // Calculate fair value of all symbols, one by one.
+  void CalculateBySymbols(redis::client::Client* redis_client,
+                          const SymbolList& symbols,
+                          std::vector<FairValueData>& data_list);
+  // Calculate fair value of all symbols at once, by |pricing_core_|.
+  void CalculateByPricingCore(
+      redis::client::Client* redis_client,
+      const std::shared_ptr<const SymbolList>& symbols,
+      std::vector<FairValueData>& data_list);
+  // Add/remove rows of |pricing_core_| after symbol list is changed.
+  void SyncPricingCore(const std::shared_ptr<const SymbolList>& symbols);
+  // Schedule new symbols (due at once) and cancel removed symbols after
+  // symbol list is changed (|PRICING_CORE_OBJECT| only).
+  void SyncSchedule(const std::shared_ptr<const SymbolList>& symbols,
+                    uint64_t now);
+  // Advance |schedule_| to |now|, collect symbols which are due into
+  // |due_symbols_| and schedule their next refresh. Return false if nothing
+  // is due.
+  bool CollectDueSymbols(uint64_t now);
+  // Add fair value of |data| to statistics of |symbol|, and write values of
+  // statistics to |data|.
+  void UpdateStatistics(Symbol* symbol, FairValueData& data);
+  // Record inputs and outputs of |symbol| in current loop, they are written
+  // to tick journal at the end of loop.
+  void AddJournalRecord(Symbol* symbol, const FairValueInputs& inputs,
+                        const FairValueData& data);
+
+  // Lease of this group is surely held now (see |SetLeaseDeadline()|).
+  bool HoldsLease() const;
 
   // Loop to generate price of all symbols in this group.
   void Loop();
+  // Wait until |time|, by sleeping or spinning (|busy_poll_|).
+  void WaitUntil(common::MonotonicNs time);
+  // Record how late current loop started (|delay| after its scheduled
+  // time), report distribution of delays periodically.
+  void RecordLoopDelay(std::chrono::nanoseconds delay);
 
   // Setting variables.
   // std::string base_symbol_;
   // std::vector<std::string> price_sources_;
   // std::vector<std::string> symbol_;
 
-  // Redis controller.
-  redisContext* redis_client_;
-  redisAsyncContext* async_connect_;
+  // Name of group in configuration file.
+  std::string name_;
+  RedisServerInformation redis_info_;
+
+  // Way to calculate fair values.
+  PricingCoreType pricing_core_type_ = PRICING_CORE_OBJECT;
+  // Used when |pricing_core_type_| is |PRICING_CORE_SOA|, only by loop
+  // thread. Each row of |pricing_core_| corresponds with a |Symbol|, which
+  // provides settings (applied when its config version is changed).
+  PricingCore pricing_core_;
+  std::vector<std::shared_ptr<Symbol>> pricing_core_symbols_;
+  std::vector<uint64_t> pricing_core_config_versions_;
+  // Settings which are applied to rows (recorded by tick journal).
+  std::vector<FairValueConfig> pricing_core_configs_;
+  // Prices of legs of |pricing_core_| in current loop.
+  std::vector<common::Decimal> pricing_core_leg_prices_;
+  // Symbol list which |pricing_core_| is synchronized with.
+  std::shared_ptr<const SymbolList> pricing_core_symbol_list_;
+
+  // Redis controller. Synchronous connections are owned by threads (loop
+  // thread, main thread), see |GetRedisClient()|.
+  // Async connection subscribes PE config channel. Fair values are published on
+  // command connection of event loop (shared by groups on that loop), see
+  // |redis::async_connect::GetThreadCommandConnection()|.
+  redisAsyncContext* async_connect_ = nullptr;
+  // Read configs which are updated by NOP (|async_connect_| is subscribing).
+  redisAsyncContext* config_connect_ = nullptr;
+  // Symbols which configs are updated, refreshed when |config_refresh_timer_|
+  // expires. Used on event loop thread only.
+  std::set<std::string> pending_config_symbols_;
+  struct event* config_refresh_timer_ = nullptr;
+  // Keys of configs are spread over nodes of a redis cluster, they are read
+  // by cluster client of this thread, so event loop is not blocked. Symbols
+  // which configs are being read are protected by |config_reader_mutex_|.
+  std::thread config_reader_thread_;
+  std::mutex config_reader_mutex_;
+  std::condition_variable config_reader_condition_;
+  std::vector<std::string> config_reader_symbols_;
+  bool stop_config_reader_ = false;
+  // Re-create async connections which are not connected.
+  struct event* reconnect_timer_ = nullptr;
+
+  // Event loops which drive |async_connect_|. All commands on
+  // |async_connect_| must be run on loop |io_loop_index_|.
+  IORuntime* io_runtime_;
+  size_t io_loop_index_;
 
-  // List all |Symbol| in this group.
-  std::vector<std::unique_ptr<Symbol>> symbols_;
+  // Default precision of fair values and precision of specific symbols. Only
+  // used on main thread (when symbols are created).
+  int precision_;
+  std::map<std::string, int> symbol_precisions_;
+  // Refresh interval of group (0 if 'common.loop_interval' is used), can be
+  // updated while loop is running. Intervals of specific symbols are only
+  // used on main thread.
+  std::atomic<uint64_t> loop_interval_{0};
+  std::map<std::string, uint64_t> symbol_intervals_;
 
-  // Other.
-  // Mutex to protect get/set price process inside group.
-  std::mutex price_mutex_;
+  // Refresh schedule of symbols, by time (monotonic, milliseconds). Ids are
+  // indexes of |scheduled_symbols_| (free ids are reused), or
+  // |kGroupScheduleId| for whole group when |pricing_core_type_| is
+  // |PRICING_CORE_SOA| (all rows are calculated together). Used by loop
+  // thread only.
+  common::TimingWheel schedule_;
+  std::vector<std::shared_ptr<Symbol>> scheduled_symbols_;
+  std::map<const Symbol*, uint32_t> schedule_ids_;
+  std::vector<uint32_t> free_schedule_ids_;
+  // Symbol list which |schedule_| is synchronized with.
+  std::shared_ptr<const SymbolList> scheduled_symbol_list_;
+  // Expired ids and due symbols of current loop.
+  std::vector<uint32_t> due_ids_;
+  SymbolList due_symbols_;
+
+  // The way to write fair value data to redis.
+  RedisWriteMode redis_write_mode_;
+  // Used when |redis_write_mode_| is |REDIS_WRITE_SCRIPT|.
+  redis::client::Script set_and_publish_script_;
+  // Layout of fair value records (JSON and/or hash), which are written and
+  // read (base currency prices) by this group.
+  RedisStorageMode redis_storage_mode_;
+
+  // Content of notification on fair value channel.
+  PublishMode publish_mode_;
+  // Write fair value to redis or not (only to other outputs).
+  bool redis_output_enabled_;
+
+  // Other outputs.
+  GroupOutputs outputs_;
+
+  // Statistics published with fair values of this group.
+  std::shared_ptr<const SymbolStatistics::Config> statistics_config_;
+  // Statistics config and time of current loop (clocks are sampled once per
+  // loop). Used by loop thread only.
+  std::shared_ptr<const SymbolStatistics::Config> loop_statistics_config_;
+  common::TickTime loop_time_;
+  // Interval of |SaveSnapshot()| by loop, 0 if disabled.
+  std::chrono::milliseconds snapshot_interval_{0};
+  common::MonotonicMs last_snapshot_time_;
+  // Tick journal records of current loop. Used by loop thread only.
+  std::vector<TickJournalRecord> journal_records_;
+
+  // List all |Symbol| in this group. It is never modified, but replaced by
+  // a new list (by |std::atomic_store()|) when symbols are added or removed.
+  std::shared_ptr<const SymbolList> symbols_;
 
   // This thread use to run |Loop()|.
   std::thread loop_thread_;
 
   // Use to stopping loop when necessary.
-  bool stop_loop_ = false;
+  std::atomic<bool> stop_loop_{false};
+  // See |SetLeaseDeadline()|.
+  std::atomic<uint64_t> lease_deadline_{
+      std::numeric_limits<uint64_t>::max()};
+
+  // Scheduling of |loop_thread_|.
+  ThreadInformation thread_info_ = {-1, 0, 0};
+  bool busy_poll_ = false;
+  // Start delays (nanoseconds) of loops since last report of jitter. Used by
+  // loop thread only.
+  std::vector<int64_t> loop_delays_;
+  common::MonotonicNs last_jitter_report_time_;
 };
 
 #endif  // GROUP_H_
\ No newline at end of file
@@ -0,0 +1,105 @@
+#include "io_runtime.h"
+
+#include <event2/event.h>
+#include <event2/thread.h>
+#include "common/thread_helper.h"
+#include "glog/logging.h"
+
+IORuntime::IORuntime(int loop_number, const std::vector<int>& cpus,
+                     int realtime_priority, int nice) {
+  // Libevent must be thread-safe because |event_active()| and
+  // |event_base_loopbreak()| are called from other threads.
+  static bool evthread_initialized = (evthread_use_pthreads() == 0);
+  if (!evthread_initialized)
+    LOG(ERROR) << "Cannot enable thread support of libevent.";
+
+  if (loop_number <= 0)
+    loop_number = 1;
+
+  for (int i = 0; i < loop_number; i++) {
+    std::unique_ptr<EventLoop> loop(new EventLoop());
+    loop->index = i;
+    loop->cpu = i < static_cast<int>(cpus.size()) ? cpus[i] : -1;
+    loop->realtime_priority = realtime_priority;
+    loop->nice = nice;
+    loop->base = event_base_new();
+    loop->wakeup_event =
+        event_new(loop->base, -1, EV_PERSIST, &IORuntime::OnWakeup,
+                  loop.get());
+    loop->wakeup_pending = false;
+    loops_.push_back(std::move(loop));
+  }
+}
+
+IORuntime::~IORuntime() {
+  Stop();
+
+  for (auto& loop : loops_) {
+    event_free(loop->wakeup_event);
+    event_base_free(loop->base);
+  }
+}
+
+void IORuntime::Start() {
+  if (running_)
+    return;
+
+  running_ = true;
+  for (auto& loop : loops_)
+    loop->thread = std::thread(&IORuntime::Run, loop.get());
+}
+
+void IORuntime::Stop() {
+  if (!running_)
+    return;
+
+  // Break loop from its own thread, so it works even if the loop has not
+  // started dispatching yet.
+  running_ = false;
+  for (auto& loop : loops_) {
+    struct event_base* base = loop->base;
+    Post(loop->index, [base]() { event_base_loopbreak(base); });
+    loop->thread.join();
+  }
+}
+
+size_t IORuntime::GetLoopIndex(const std::string& key) const {
+  return std::hash<std::string>()(key) % loops_.size();
+}
+
+struct event_base* IORuntime::GetEventBase(size_t loop_index) {
+  return loops_[loop_index % loops_.size()]->base;
+}
+
+void IORuntime::Post(size_t loop_index, Task task) {
+  EventLoop* loop = loops_[loop_index % loops_.size()].get();
+  loop->tasks.Push(std::move(task));
+
+  // Only wake up loop if it is not going to drain the queue already.
+  if (!loop->wakeup_pending.exchange(true, std::memory_order_acq_rel))
+    event_active(loop->wakeup_event, EV_READ, 0);
+}
+
+// static
+void IORuntime::OnWakeup(int fd, short events, void* arg) {
+  EventLoop* loop = static_cast<EventLoop*>(arg);
+
+  // Reset flag before draining, so tasks posted from now on will trigger
+  // another wake up.
+  loop->wakeup_pending.exchange(false, std::memory_order_acq_rel);
+
+  Task task;
+  while (loop->tasks.Pop(task))
+    task();
+}
+
+// static
+void IORuntime::Run(EventLoop* loop) {
+  common::SetCurrentThreadName("pe_io_" + std::to_string(loop->index));
+  common::ConfigureCurrentThread("IO loop " + std::to_string(loop->index),
+                                 loop->cpu, loop->realtime_priority,
+                                 loop->nice);
+
+  // Keep running even when there is no connection attached to this loop.
+  event_base_loop(loop->base, EVLOOP_NO_EXIT_ON_EMPTY);
+}
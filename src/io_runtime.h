@@ -0,0 +1,73 @@
+#ifndef IO_RUNTIME_H_
+#define IO_RUNTIME_H_
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "common/mpsc_queue.h"
+
+struct event;
+struct event_base;
+
+// Runs N libevent loops, each on its own thread (optionally pinned to a cpu
+// core). Async redis connections are attached to one of these loops, and
+// other threads hand work off to a loop by |Post()|.
+class IORuntime {
+public:
+  typedef std::function<void()> Task;
+
+  // |cpus| is cpu core of each loop thread, loop is not pinned if there is
+  // no corresponding item (or item is negative). All loop threads run at
+  // |realtime_priority| (SCHED_FIFO) if it is positive, or at |nice|.
+  IORuntime(int loop_number, const std::vector<int>& cpus,
+            int realtime_priority, int nice);
+  virtual ~IORuntime();
+
+  IORuntime(const IORuntime&) = delete;
+  IORuntime& operator=(const IORuntime&) = delete;
+
+  // Start/stop all loop threads.
+  void Start();
+  void Stop();
+
+  size_t GetLoopNumber() const { return loops_.size(); }
+
+  // Get index of loop which is in charge of |key| (group name, connection
+  // name, etc.). Same key is always assigned to same loop.
+  size_t GetLoopIndex(const std::string& key) const;
+
+  struct event_base* GetEventBase(size_t loop_index);
+
+  // Run |task| on thread of loop |loop_index|. Can be called from any thread,
+  // tasks posted from the same thread are run in order.
+  void Post(size_t loop_index, Task task);
+
+private:
+  struct EventLoop {
+    size_t index;
+    int cpu;
+    int realtime_priority;
+    int nice;
+    struct event_base* base;
+    // User-triggered event, used to wake up loop when there is new task.
+    struct event* wakeup_event;
+    // Avoid activating |wakeup_event| on every |Post()|.
+    std::atomic<bool> wakeup_pending;
+    common::MpscQueue<Task> tasks;
+    std::thread thread;
+  };
+
+  // Called on loop thread when |wakeup_event| is activated.
+  static void OnWakeup(int fd, short events, void* arg);
+
+  // Thread function of each loop.
+  static void Run(EventLoop* loop);
+
+  std::vector<std::unique_ptr<EventLoop>> loops_;
+  bool running_ = false;
+};
+
+#endif  // IO_RUNTIME_H_
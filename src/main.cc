@@ -1,20 +1,216 @@
+#include <sys/stat.h>
+#include <algorithm>
+#include <csignal>
+#include <cstdlib>
 #include <fstream>
 #include <thread>
 
+#include "benchmark.h"
+#include "cluster_coordinator.h"
+#include "replay.h"
+#include "common/shm_price_writer.h"
 #include "configuration.h"
 #include "glog/logging.h"
 #include "group.h"
-#include "hiredis/adapters/libevent.h"
+#include "io_runtime.h"
+#include "multicast_monitor.h"
+#include "pe_config_cache.h"
+#include "price_multicast_publisher.h"
+#include "price_stream_server.h"
 #include "redis_controller.h"
+#include "tick_journal.h"
+
+namespace {
+
+// Interval to check reload request. (milliseconds)
+const int kReloadCheckInterval = 200;
+
+// Set by SIGHUP handler.
+volatile sig_atomic_t reload_requested = 0;
+
+// Set by SIGTERM/SIGINT handler.
+volatile sig_atomic_t stop_requested = 0;
+
+void OnSignalHangUp(int signal) {
+  reload_requested = 1;
+}
+
+void OnSignalTerminate(int signal) {
+  stop_requested = 1;
+}
+
+// Get last modification time of |file_name|, 0 if failed.
+time_t GetModifiedTime(const std::string& file_name) {
+  struct stat st;
+  return stat(file_name.c_str(), &st) == 0 ? st.st_mtime : 0;
+}
+
+// Reload configuration file, then create/update/retire groups by comparing
+// new group settings with running groups. Running groups keep their symbols
+// (and fair value history) if they are still in configuration. New groups
+// are not created if |create_groups| is false (cluster mode, they are
+// created when they are acquired).
+void ReloadGroups(std::vector<std::unique_ptr<Group>>& groups,
+                  IORuntime* io_runtime,
+                  const GroupOutputs& outputs,
+                  bool create_groups) {
+  Configuration* configuration = Configuration::GetInstance();
+  if (!configuration->ReloadConfig()) {
+    LOG(ERROR) << "Cannot reload configuration file: "
+               << configuration->GetConfigFileName();
+    return;
+  }
+
+  LOG(INFO) << "Configuration is reloaded: loop_interval = "
+            << configuration->GetLoopInterval() << ", diff_time_max = "
+            << configuration->GetDiffTimeMax();
+
+  const std::vector<GroupInformation>& group_info =
+      configuration->GetGroupInfo();
+
+  // Retire groups which are removed from configuration.
+  for (auto it = groups.begin(); it != groups.end();) {
+    const std::string& name = (*it)->GetName();
+    if (std::none_of(group_info.begin(), group_info.end(),
+            [&name](const GroupInformation& info) {
+              return info.name == name;
+            })) {
+      Group::Retire(std::move(*it));
+      it = groups.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  // Update existing groups, create new ones.
+  for (auto& info : group_info) {
+    auto it = std::find_if(groups.begin(), groups.end(),
+        [&info](const std::unique_ptr<Group>& group) {
+          return group->GetName() == info.name;
+        });
+    if (it != groups.end()) {
+      (*it)->UpdateSymbols(info);
+      continue;
+    }
+    if (!create_groups)
+      continue;
+
+    LOG(INFO) << "Add group " << info.name;
+    std::unique_ptr<Group> group(new Group(
+        configuration->GetRedisServerInfo(), info, io_runtime, outputs));
+    group->StartLoop();
+    groups.push_back(std::move(group));
+  }
+}
+
+// Find running group |name|, return |groups.end()| if not found.
+std::vector<std::unique_ptr<Group>>::iterator FindGroup(
+    std::vector<std::unique_ptr<Group>>& groups, const std::string& name) {
+  return std::find_if(groups.begin(), groups.end(),
+      [&name](const std::unique_ptr<Group>& group) {
+        return group->GetName() == name;
+      });
+}
+
+// Start/stop groups by ownership changes of |coordinator|.
+void UpdateClusterGroups(ClusterCoordinator& coordinator,
+                         std::vector<std::unique_ptr<Group>>& groups,
+                         IORuntime* io_runtime,
+                         const GroupOutputs& outputs) {
+  Configuration* configuration = Configuration::GetInstance();
+  const std::vector<GroupInformation>& group_info =
+      configuration->GetGroupInfo();
+  std::vector<std::string> group_names;
+  for (auto& info : group_info)
+    group_names.push_back(info.name);
+
+  std::vector<std::string> acquired;
+  std::vector<std::string> lost;
+  std::vector<std::string> releasing;
+  coordinator.Update(group_names, acquired, lost, releasing);
+
+  // Lost groups may be run by another instance already, stop them without
+  // writing anything more.
+  for (auto& name : lost) {
+    auto it = FindGroup(groups, name);
+    if (it == groups.end())
+      continue;
+    Group::Retire(std::move(*it));
+    groups.erase(it);
+  }
+
+  // Hand released groups over with their latest history.
+  for (auto& name : releasing) {
+    auto it = FindGroup(groups, name);
+    if (it != groups.end()) {
+      (*it)->StopLoop();
+      (*it)->SaveSnapshot();
+      Group::Retire(std::move(*it));
+      groups.erase(it);
+    }
+    coordinator.Release(name);
+  }
+
+  for (auto& name : acquired) {
+    auto info = std::find_if(group_info.begin(), group_info.end(),
+        [&name](const GroupInformation& info) { return info.name == name; });
+    if (info == group_info.end() || FindGroup(groups, name) != groups.end())
+      continue;
+
+    LOG(INFO) << "Start group " << name;
+    std::unique_ptr<Group> group(new Group(
+        configuration->GetRedisServerInfo(), *info, io_runtime, outputs));
+    group->SetLeaseDeadline(coordinator.GetLeaseDeadline(name));
+    group->LoadSnapshot();
+    group->StartLoop();
+    groups.push_back(std::move(group));
+  }
+
+  // Groups stop writing by themselves if next renewal is late.
+  for (auto& group : groups)
+    group->SetLeaseDeadline(coordinator.GetLeaseDeadline(group->GetName()));
+}
+
+} // namespace
 
 int main(int argc, const char *argv[]) {
   signal(SIGPIPE, SIG_IGN);
+  signal(SIGHUP, OnSignalHangUp);
+  signal(SIGTERM, OnSignalTerminate);
+  signal(SIGINT, OnSignalTerminate);
 
   // Initialize Google's logging library.
   google::SetLogDestination(google::INFO, "./log/PE.log.");
   FLAGS_alsologtostderr = 1;
   google::InitGoogleLogging("PE");
 
+  // Benchmark mode: PE --benchmark [symbol_number]
+  if (argc >= 2 && std::string(argv[1]) == "--benchmark") {
+    const int kDefaultSymbolNumber = 10000;
+    return RunPricingCoreBenchmark(
+        argc >= 3 ? std::atoi(argv[2]) : kDefaultSymbolNumber);
+  }
+
+  // Redis benchmark: PE --benchmark-redis <config> [command_number]
+  if (argc >= 3 && std::string(argv[1]) == "--benchmark-redis") {
+    const int kDefaultCommandNumber = 100000;
+    Configuration::GetInstance()->LoadConfig(argv[2]);
+    return RunRedisBenchmark(
+        Configuration::GetInstance()->GetRedisServerInfo(),
+        argc >= 4 ? std::atoi(argv[3]) : kDefaultCommandNumber);
+  }
+
+  // Replay mode: PE --replay <journal>
+  if (argc == 3 && std::string(argv[1]) == "--replay")
+    return RunReplay(argv[2]);
+
+  // Multicast receiver: PE --receive-multicast <group> [interface] [snapshot]
+  if (argc >= 3 && argc <= 5 &&
+      std::string(argv[1]) == "--receive-multicast") {
+    return RunMulticastMonitor(argv[2], argc >= 4 ? argv[3] : "",
+                               argc >= 5 ? argv[4] : "", stop_requested);
+  }
+
   // Get configuration file name from input parameter.
   if (argc != 2) {
     LOG(ERROR) << "Parameter number is not correct!";
@@ -39,41 +235,139 @@ int main(int argc, const char *argv[]) {
   LOG(INFO) << "Redis server information: \n"
             << " - Host: " << redis_server.host << "\n"
             << " - Port: " << redis_server.port << "\n"
+            << " - Unix socket: " << redis_server.unix_socket << "\n"
             // << " - Password: " << redis_server.password << "\n"
             ;
+  LOG(INFO) << "IO runtime: " << configuration->GetIOLoopNumber()
+            << " event loop(s).";
 
   // Initialize.
-  // Setup event_base to listening event for async connection.
-  // TODO(hoangpq): Currently, we just use one event_base for all async
-  // connections. Please consider to use one event_base for each async
-  // conntections if there are too many async connections in the future.
-  struct event_base* base = event_base_new();
+  // Setup event loops to listening event for async connections. Each group
+  // is assigned to one loop by hash of its name.
+  ThreadInformation io_thread = configuration->GetIOThreadInfo();
+  IORuntime io_runtime(configuration->GetIOLoopNumber(),
+                       configuration->GetIOCpuAffinity(),
+                       io_thread.realtime_priority, io_thread.nice);
+
+  // Setup outputs other than redis, which are shared between groups.
+  GroupOutputs outputs;
+  common::ShmPriceWriter shm_writer;
+  ShmOutputInformation shm_output = configuration->GetShmOutputInfo();
+  if (!shm_output.name.empty()) {
+    if (shm_writer.Open(shm_output.name, shm_output.max_symbols,
+                        shm_output.ring_size))
+      outputs.shm_writer = &shm_writer;
+    else
+      LOG(ERROR) << "Cannot open shared memory price buffer, ignore it.";
+  }
+  std::unique_ptr<PriceStreamServer> stream_server;
+  StreamOutputInformation stream_output = configuration->GetStreamOutputInfo();
+  if (!stream_output.address.empty()) {
+    stream_server.reset(new PriceStreamServer(&io_runtime, stream_output));
+    if (stream_server->Open())
+      outputs.stream_server = stream_server.get();
+    else
+      LOG(ERROR) << "Cannot open price stream server, ignore it.";
+  }
+  std::unique_ptr<PriceMulticastPublisher> multicast_publisher;
+  MulticastOutputInformation multicast_output =
+      configuration->GetMulticastOutputInfo();
+  if (!multicast_output.address.empty()) {
+    multicast_publisher.reset(
+        new PriceMulticastPublisher(&io_runtime, multicast_output));
+    if (multicast_publisher->Open())
+      outputs.multicast_publisher = multicast_publisher.get();
+    else
+      LOG(ERROR) << "Cannot open multicast price feed, ignore it.";
+  }
+  TickJournalWriter tick_journal;
+  std::string journal_file_name = configuration->GetJournalFileName();
+  if (!journal_file_name.empty()) {
+    if (tick_journal.Open(journal_file_name))
+      outputs.tick_journal = &tick_journal;
+    else
+      LOG(ERROR) << "Cannot open tick journal, ignore it.";
+  }
+  // Cache is used even if it is empty (first run), it is filled by configs
+  // which are read from redis.
+  PEConfigCache config_cache;
+  std::string config_cache_file_name = configuration->GetConfigCacheFileName();
+  if (!config_cache_file_name.empty()) {
+    config_cache.Open(config_cache_file_name);
+    outputs.config_cache = &config_cache;
+  }
+
+  // In cluster mode, groups are started when they are acquired (see
+  // |UpdateClusterGroups()|).
+  ClusterInformation cluster = configuration->GetClusterInfo();
+  std::unique_ptr<ClusterCoordinator> coordinator;
+  if (cluster.enabled) {
+    LOG(INFO) << "Cluster mode: instance " << cluster.instance_id
+              << ", lease_time = " << cluster.lease_time
+              << ", renew_interval = " << cluster.renew_interval;
+    coordinator.reset(new ClusterCoordinator(redis_server, cluster));
+  }
 
   // Initialize for each group.
   std::vector<std::unique_ptr<Group>> groups;
   int count = 0;
   for (auto& group_info : configuration->GetGroupInfo()) {
+    if (coordinator)
+      break;
     LOG(INFO) << "Group " << ++count << ":";
-    std::unique_ptr<Group> group(new Group(redis_server, group_info, base));
+    std::unique_ptr<Group> group(
+        new Group(redis_server, group_info, &io_runtime, outputs));
     groups.push_back(std::move(group));
   }
 
-  // Run event_base_dispatch() on a seperate thread to do not
-  // disturb main thread.
-  std::thread async_event_thread = std::thread([&base]() {
-    event_base_dispatch(base);
-  });
+  // Run event loops on seperate threads to do not disturb main thread.
+  io_runtime.Start();
 
   // Main process.
   // Start generated price loop.
   for (auto& group : groups)
     group->StartLoop();
 
-  // Keep program running until receive exit signal.
-  // TODO(hoangpq): Plz catch SIGTERM signal to stop program.
-  while (true);
+  // Keep program running until receive exit signal (SIGTERM/SIGINT), reload
+  // configuration when receive SIGHUP (or file is modified, if auto reload
+  // is enabled).
+  time_t config_modified_time = GetModifiedTime(config_file_name);
+  while (!stop_requested) {
+    std::this_thread::sleep_for(
+        std::chrono::milliseconds(kReloadCheckInterval));
+
+    if (configuration->IsAutoReloadEnabled()) {
+      time_t modified_time = GetModifiedTime(config_file_name);
+      if (modified_time != 0 && modified_time != config_modified_time) {
+        config_modified_time = modified_time;
+        reload_requested = 1;
+      }
+    }
+
+    if (reload_requested) {
+      reload_requested = 0;
+      ReloadGroups(groups, &io_runtime, outputs, coordinator == nullptr);
+    }
 
-  // Releasing.
+    if (coordinator)
+      UpdateClusterGroups(*coordinator, groups, &io_runtime, outputs);
+  }
+
+  // Releasing. Stop all groups, then hand them over to other instances right
+  // now (not after their leases expire).
+  LOG(INFO) << "Stop program.";
+  for (auto& group : groups) {
+    group->StopLoop();
+    if (coordinator)
+      group->SaveSnapshot();
+    Group::Retire(std::move(group));
+  }
+  groups.clear();
+  if (coordinator)
+    coordinator->Leave();
+  io_runtime.Stop();
+  tick_journal.Close();
+  config_cache.Close();
 
   return 0;
 }
@@ -0,0 +1,64 @@
+#include "multicast_monitor.h"
+
+#include <chrono>
+#include <cstdlib>
+#include "common/price_multicast_receiver.h"
+#include "glog/logging.h"
+
+namespace {
+
+// Timeout of a poll, to check stop request. (milliseconds)
+const int kPollTimeout = 200;
+// Interval to log counters. (seconds)
+const int kCounterLogInterval = 10;
+
+void LogCounters(const common::PriceMulticastReceiver& receiver,
+                 uint64_t update_count) {
+  LOG(INFO) << "Multicast price feed: " << update_count << " updates, "
+            << "sequence " << receiver.GetSequence() << ", "
+            << receiver.GetGapCount() << " gaps, "
+            << receiver.GetRecoveryCount() << " recoveries, "
+            << receiver.GetInvalidCount() << " invalid.";
+}
+
+} // namespace
+
+int RunMulticastMonitor(const std::string& group,
+                        const std::string& interface,
+                        const std::string& snapshot_address,
+                        const volatile sig_atomic_t& stop_requested) {
+  common::PriceMulticastReceiver receiver;
+  if (!receiver.Open(group, interface, snapshot_address)) {
+    LOG(ERROR) << "Cannot join multicast group " << group
+               << (interface.empty() ? "" : " on ") << interface;
+    return EXIT_FAILURE;
+  }
+  LOG(INFO) << "Receive multicast price feed " << group << ", snapshot "
+            << "service " << (snapshot_address.empty() ? "(none)"
+                                                       : snapshot_address)
+            << ".";
+
+  uint64_t update_count = 0;
+  auto last_log_time = std::chrono::steady_clock::now();
+  auto handler = [&update_count](const common::PriceMulticastUpdate& update) {
+    update_count++;
+    LOG(INFO) << update.symbol_name << ": fair value " << update.fair_value.ToString()
+              << ", moving average " << update.moving_average
+              << ", standard deviation ratio "
+              << update.standard_deviation_ratio << ", timestamp "
+              << update.timestamp;
+  };
+  while (!stop_requested) {
+    if (!receiver.Poll(kPollTimeout, handler)) {
+      LOG(ERROR) << "Cannot receive multicast datagrams.";
+      return EXIT_FAILURE;
+    }
+    auto now = std::chrono::steady_clock::now();
+    if (now - last_log_time >= std::chrono::seconds(kCounterLogInterval)) {
+      last_log_time = now;
+      LogCounters(receiver, update_count);
+    }
+  }
+  LogCounters(receiver, update_count);
+  return EXIT_SUCCESS;
+}
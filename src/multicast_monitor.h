@@ -0,0 +1,17 @@
+#ifndef MULTICAST_MONITOR_H_
+#define MULTICAST_MONITOR_H_
+
+#include <csignal>
+#include <string>
+
+// Receive multicast price feed of another PE, run by
+// "PE --receive-multicast <group> [interface] [snapshot]" (arguments of
+// |common::PriceMulticastReceiver::Open()|, empty string for default).
+// Every update is logged, with counters of gaps and recoveries, until
+// |stop_requested| is set. Return exit code.
+int RunMulticastMonitor(const std::string& group,
+                        const std::string& interface,
+                        const std::string& snapshot_address,
+                        const volatile sig_atomic_t& stop_requested);
+
+#endif  // MULTICAST_MONITOR_H_
@@ -0,0 +1,341 @@
+#include "pe_config_cache.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include "common/clock.h"
+#include "common/string_view.h"
+#include "common/thread_helper.h"
+#include "glog/logging.h"
+
+namespace {
+
+// Updates within this interval are saved together. (milliseconds)
+const int kSaveInterval = 1000;
+
+uint64_t GetChecksum(const char* data, size_t size) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+template<typename T>
+void Append(std::string& output, T value) {
+  output.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void AppendString(std::string& output, common::StringView value) {
+  Append<uint32_t>(output, static_cast<uint32_t>(value.size()));
+  output.append(value.data(), value.size());
+}
+
+// Read values which are written by |Append()|, in the same order.
+class BufferReader {
+public:
+  BufferReader(const char* data, size_t size) : data_(data), size_(size) {}
+
+  template<typename T>
+  bool Read(T& value) {
+    if (size_ < sizeof(value))
+      return false;
+    memcpy(&value, data_, sizeof(value));
+    data_ += sizeof(value);
+    size_ -= sizeof(value);
+    return true;
+  }
+
+  bool ReadString(common::StringView& value) {
+    uint32_t size = 0;
+    if (!Read(size) || size_ < size)
+      return false;
+    value = common::StringView(data_, size);
+    data_ += size;
+    size_ -= size;
+    return true;
+  }
+
+  bool IsEnd() const { return size_ == 0; }
+
+private:
+  const char* data_;
+  size_t size_;
+};
+
+std::string SerializeConfig(const FairValueConfig& config) {
+  std::string output;
+  Append<int32_t>(output, config.calculate_method);
+  Append<uint32_t>(output,
+                   static_cast<uint32_t>(config.source_percentage.size()));
+  for (double percentage : config.source_percentage)
+    Append<double>(output, percentage);
+  Append<uint32_t>(output, static_cast<uint32_t>(config.source_type.size()));
+  for (SourceType type : config.source_type)
+    Append<int32_t>(output, type);
+  Append<double>(output, config.filter_ratio);
+  Append<int32_t>(output, config.lot_limit);
+  Append<double>(output, config.fixed_price);
+  AppendString(output, config.base_currency);
+  Append<uint8_t>(output, config.skew_active ? 1 : 0);
+  Append<int32_t>(output, config.skew_type);
+  Append<double>(output, config.skew_value);
+  Append<double>(output, config.skew_percent);
+  Append<int32_t>(output, config.moving_average);
+  Append<uint64_t>(output, config.refresh_interval);
+  return output;
+}
+
+bool ParseConfig(const std::string& input, FairValueConfig& config) {
+  BufferReader reader(input.data(), input.size());
+  int32_t calculate_method = 0;
+  uint32_t size = 0;
+  if (!reader.Read(calculate_method) || !reader.Read(size))
+    return false;
+  config.calculate_method =
+      static_cast<CalculateFairValueMethod>(calculate_method);
+  config.source_percentage.resize(size);
+  for (double& percentage : config.source_percentage) {
+    if (!reader.Read(percentage))
+      return false;
+  }
+
+  if (!reader.Read(size))
+    return false;
+  config.source_type.resize(size);
+  for (SourceType& type : config.source_type) {
+    int32_t value = 0;
+    if (!reader.Read(value))
+      return false;
+    type = static_cast<SourceType>(value);
+  }
+
+  int32_t lot_limit = 0;
+  common::StringView base_currency;
+  uint8_t skew_active = 0;
+  int32_t skew_type = 0;
+  int32_t moving_average = 0;
+  if (!reader.Read(config.filter_ratio) || !reader.Read(lot_limit) ||
+      !reader.Read(config.fixed_price) || !reader.ReadString(base_currency) ||
+      !reader.Read(skew_active) || !reader.Read(skew_type) ||
+      !reader.Read(config.skew_value) || !reader.Read(config.skew_percent) ||
+      !reader.Read(moving_average) || !reader.Read(config.refresh_interval) ||
+      !reader.IsEnd())
+    return false;
+  config.lot_limit = lot_limit;
+  config.base_currency = base_currency.ToString();
+  config.skew_active = skew_active != 0;
+  config.skew_type = skew_type;
+  config.moving_average = moving_average;
+  return true;
+}
+
+} // namespace
+
+PEConfigCache::PEConfigCache() : dirty_(false), stop_(false) {}
+
+PEConfigCache::~PEConfigCache() {
+  Close();
+}
+
+bool PEConfigCache::Open(const std::string& file_name) {
+  Close();
+
+  file_name_ = file_name;
+  entries_.clear();
+  bool loaded = Load();
+  if (!loaded)
+    entries_.clear();
+  dirty_ = false;
+  stop_ = false;
+  thread_ = std::thread(&PEConfigCache::Run, this);
+  return loaded;
+}
+
+void PEConfigCache::Close() {
+  if (!thread_.joinable())
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  condition_.notify_one();
+  thread_.join();
+}
+
+bool PEConfigCache::Get(const std::string& symbol_name,
+                        FairValueConfig& config) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = entries_.find(symbol_name);
+  if (it == entries_.end())
+    return false;
+  return ParseConfig(it->second, config);
+}
+
+void PEConfigCache::Put(const std::string& symbol_name,
+                        const FairValueConfig& config) {
+  std::string entry = SerializeConfig(config);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string& current = entries_[symbol_name];
+    if (current == entry)
+      return;
+    current.swap(entry);
+    dirty_ = true;
+  }
+  condition_.notify_one();
+}
+
+void PEConfigCache::Run() {
+  common::SetCurrentThreadName("pe-config-cache");
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    condition_.wait(lock, [this]() { return stop_ || dirty_; });
+    if (dirty_) {
+      // Save a copy, configs can be updated meanwhile.
+      std::map<std::string, std::string> entries(entries_);
+      dirty_ = false;
+      lock.unlock();
+      bool saved = Save(entries);
+      lock.lock();
+      // Try again after interval (ex: disk was full).
+      if (!saved)
+        dirty_ = true;
+    }
+    if (stop_)
+      break;
+
+    condition_.wait_for(lock, std::chrono::milliseconds(kSaveInterval),
+                        [this]() { return stop_; });
+  }
+}
+
+bool PEConfigCache::Save(const std::map<std::string, std::string>& entries) {
+  std::string data;
+  data.resize(sizeof(PEConfigCacheHeader));
+  for (auto& entry : entries) {
+    AppendString(data, entry.first);
+    AppendString(data, entry.second);
+  }
+
+  PEConfigCacheHeader header;
+  header.magic = kPEConfigCacheMagic;
+  header.version = kPEConfigCacheVersion;
+  header.entry_number = static_cast<uint32_t>(entries.size());
+  header.reserved = 0;
+  header.saved_time = common::ToUint64(common::GetWallClockMs());
+  header.checksum = GetChecksum(data.data() + sizeof(header),
+                                data.size() - sizeof(header));
+  memcpy(&data[0], &header, sizeof(header));
+
+  // Replace old file only after new one is completely on disk.
+  std::string temp_file_name = file_name_ + ".tmp";
+  int fd = open(temp_file_name.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0644);
+  if (fd < 0) {
+    LOG(ERROR) << "Cannot open PE config cache " << temp_file_name << ": "
+               << strerror(errno);
+    return false;
+  }
+
+  size_t offset = 0;
+  while (offset < data.size()) {
+    ssize_t written = write(fd, data.data() + offset, data.size() - offset);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      LOG(ERROR) << "Cannot write PE config cache " << temp_file_name << ": "
+                 << strerror(errno);
+      close(fd);
+      unlink(temp_file_name.c_str());
+      return false;
+    }
+    offset += written;
+  }
+
+  // File is closed even if it cannot be synchronized.
+  int error = fsync(fd) != 0 ? errno : 0;
+  if (close(fd) != 0 && error == 0)
+    error = errno;
+  if (error == 0 && rename(temp_file_name.c_str(), file_name_.c_str()) != 0)
+    error = errno;
+  if (error != 0) {
+    LOG(ERROR) << "Cannot save PE config cache " << file_name_ << ": "
+               << strerror(error);
+    unlink(temp_file_name.c_str());
+    return false;
+  }
+
+  VLOG(1) << "Save " << entries.size() << " PE config(s) to "
+          << file_name_;
+  return true;
+}
+
+bool PEConfigCache::Load() {
+  auto start = std::chrono::steady_clock::now();
+  int fd = open(file_name_.c_str(), O_RDONLY);
+  if (fd < 0) {
+    LOG(INFO) << "PE config cache " << file_name_ << " is not existed, "
+              << "configs are read from redis.";
+    return false;
+  }
+
+  struct stat st;
+  std::string data;
+  if (fstat(fd, &st) == 0)
+    data.resize(st.st_size);
+  size_t offset = 0;
+  while (offset < data.size()) {
+    ssize_t size = read(fd, &data[offset], data.size() - offset);
+    if (size < 0 && errno == EINTR)
+      continue;
+    if (size <= 0)
+      break;
+    offset += size;
+  }
+  close(fd);
+
+  PEConfigCacheHeader header;
+  if (offset != data.size() || data.size() < sizeof(header)) {
+    LOG(ERROR) << "Cannot read PE config cache " << file_name_ << ".";
+    return false;
+  }
+  memcpy(&header, data.data(), sizeof(header));
+  if (header.magic != kPEConfigCacheMagic ||
+      header.version != kPEConfigCacheVersion ||
+      header.checksum != GetChecksum(data.data() + sizeof(header),
+                                     data.size() - sizeof(header))) {
+    LOG(ERROR) << "PE config cache " << file_name_
+               << " is not supported or corrupted, ignore it.";
+    return false;
+  }
+
+  BufferReader reader(data.data() + sizeof(header),
+                      data.size() - sizeof(header));
+  for (uint32_t i = 0; i < header.entry_number; i++) {
+    common::StringView symbol_name;
+    common::StringView config;
+    if (!reader.ReadString(symbol_name) || !reader.ReadString(config)) {
+      LOG(ERROR) << "PE config cache " << file_name_
+                 << " is corrupted, ignore it.";
+      return false;
+    }
+    entries_[symbol_name.ToString()] = config.ToString();
+  }
+
+  uint64_t now = common::ToUint64(common::GetWallClockMs());
+  LOG(INFO) << "Load " << entries_.size() << " PE config(s) from cache "
+            << file_name_ << " in "
+            << std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now() - start).count()
+            << " us (saved "
+            << (now > header.saved_time ? (now - header.saved_time) / 1000 : 0)
+            << " s ago).";
+  return true;
+}
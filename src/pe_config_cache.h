@@ -0,0 +1,82 @@
+#ifndef PE_CONFIG_CACHE_H_
+#define PE_CONFIG_CACHE_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "symbol.h"
+
+// Last known good PE config (|FairValueConfig|) of all symbols, persisted in
+// a local binary file. Groups create their symbols from it at startup without
+// waiting for redis (configs are revalidated against redis in background),
+// and can start even if redis is not available.
+//
+//   | PEConfigCacheHeader | entry | entry | ...
+//
+// Entry: symbol name, then fields of |FairValueConfig| (sizes of strings and
+// lists are written before their contents). Values are in native byte order,
+// file is read on the same platform. File is replaced atomically (written to
+// a temporary file, then renamed), so it is never partial.
+
+const uint32_t kPEConfigCacheMagic = 0x43434550;  // "PECC"
+const uint32_t kPEConfigCacheVersion = 1;
+
+struct PEConfigCacheHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t entry_number;
+  uint32_t reserved;
+  // Wall clock, milliseconds since unix epoch.
+  uint64_t saved_time;
+  // FNV-1a hash of all entries.
+  uint64_t checksum;
+};
+
+// Thread-safe. Updated configs are saved by a background thread (at most
+// once per second), so callers do not wait for disk.
+class PEConfigCache {
+public:
+  PEConfigCache();
+  virtual ~PEConfigCache();
+
+  PEConfigCache(const PEConfigCache&) = delete;
+  PEConfigCache& operator=(const PEConfigCache&) = delete;
+
+  // Load configs from |file_name|, start saver thread. Return false if
+  // nothing is loaded (file is not existed or invalid), cache starts empty
+  // and is still saved to |file_name|.
+  bool Open(const std::string& file_name);
+  // Save pending updates, stop saver thread.
+  void Close();
+
+  // Get cached config of |symbol_name|. Return false if not cached.
+  bool Get(const std::string& symbol_name, FairValueConfig& config);
+  // Update cached config of |symbol_name|, it is saved if changed.
+  void Put(const std::string& symbol_name, const FairValueConfig& config);
+
+private:
+  // Run on saver thread.
+  void Run();
+  // Write |entries| to file. Return false if failed, temporary file is
+  // removed then.
+  bool Save(const std::map<std::string, std::string>& entries);
+  bool Load();
+
+  std::string file_name_;
+
+  // Protect |entries_|, |dirty_| and |stop_|.
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  // Serialized config of each symbol (see |SerializeConfig()|).
+  std::map<std::string, std::string> entries_;
+  // |entries_| is changed since last save (or last save failed).
+  bool dirty_;
+  bool stop_;
+
+  std::thread thread_;
+};
+
+#endif  // PE_CONFIG_CACHE_H_
@@ -0,0 +1,336 @@
+#include "price_multicast_publisher.h"
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <event2/buffer.h>
+#include <event2/bufferevent.h>
+#include <event2/event.h>
+#include <event2/listener.h>
+#include <event2/util.h>
+#include "glog/logging.h"
+
+namespace {
+
+// Interval of heartbeats when feed is idle. (seconds)
+const int kHeartbeatInterval = 1;
+// Interval to log counters. (seconds)
+const int kCounterLogInterval = 60;
+// Accepting is paused for this long after it failed. (seconds)
+const int kAcceptPauseTime = 1;
+
+// Split "address:port". Return false if port is missing.
+bool SplitAddress(const std::string& address, std::string& host, int& port) {
+  size_t colon = address.rfind(':');
+  if (colon == std::string::npos || colon + 1 >= address.size())
+    return false;
+  host = address.substr(0, colon);
+  port = atoi(address.c_str() + colon + 1);
+  return port > 0 && port < 65536;
+}
+
+} // namespace
+
+PriceMulticastPublisher::PriceMulticastPublisher(
+    IORuntime* io_runtime, const MulticastOutputInformation& info)
+    : io_runtime_(io_runtime),
+      io_loop_index_(io_runtime->GetLoopIndex("price-multicast")),
+      info_(info),
+      datagram_size_(common::kPriceMulticastDatagramHeaderSize),
+      last_log_time_(std::chrono::steady_clock::now()) {
+  memset(&group_address_, 0, sizeof(group_address_));
+  // Differs between restarts, so receivers do not mix up sequences.
+  session_ = static_cast<uint32_t>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+PriceMulticastPublisher::~PriceMulticastPublisher() {
+  // Loop thread is stopped, so everything is closed here.
+  if (heartbeat_event_ != nullptr)
+    event_free(heartbeat_event_);
+  if (accept_timer_ != nullptr)
+    event_free(accept_timer_);
+  for (struct bufferevent* connection : snapshot_connections_)
+    bufferevent_free(connection);
+  if (snapshot_listener_ != nullptr) {
+    evconnlistener_free(snapshot_listener_);
+    if (info_.snapshot_address[0] == '/')
+      unlink(info_.snapshot_address.c_str());
+  }
+  if (socket_ >= 0)
+    close(socket_);
+}
+
+bool PriceMulticastPublisher::Open() {
+  std::string group;
+  int port = 0;
+  if (!SplitAddress(info_.address, group, port) ||
+      inet_pton(AF_INET, group.c_str(), &group_address_.sin_addr) != 1 ||
+      !IN_MULTICAST(ntohl(group_address_.sin_addr.s_addr))) {
+    LOG(ERROR) << "Invalid multicast address: " << info_.address;
+    return false;
+  }
+  group_address_.sin_family = AF_INET;
+  group_address_.sin_port = htons(port);
+
+  socket_ = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+  if (socket_ < 0) {
+    LOG(ERROR) << "Cannot create multicast socket: " << strerror(errno);
+    return false;
+  }
+  unsigned char ttl = static_cast<unsigned char>(info_.ttl);
+  setsockopt(socket_, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+  // Receivers on this host get datagrams too.
+  unsigned char loop = 1;
+  setsockopt(socket_, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+  if (!info_.interface.empty()) {
+    struct in_addr interface;
+    if (inet_pton(AF_INET, info_.interface.c_str(), &interface) != 1 ||
+        setsockopt(socket_, IPPROTO_IP, IP_MULTICAST_IF, &interface,
+                   sizeof(interface)) != 0) {
+      LOG(ERROR) << "Invalid multicast interface: " << info_.interface;
+      return false;
+    }
+  }
+
+  if (!info_.snapshot_address.empty() && !OpenSnapshotService())
+    return false;
+
+  heartbeat_event_ = event_new(
+      io_runtime_->GetEventBase(io_loop_index_), -1, EV_PERSIST,
+      &PriceMulticastPublisher::OnHeartbeat, this);
+  struct timeval interval = {kHeartbeatInterval, 0};
+  event_add(heartbeat_event_, &interval);
+
+  LOG(INFO) << "Multicast price feed: " << info_.address << ", session "
+            << session_ << ", snapshot service "
+            << (info_.snapshot_address.empty() ? "(none)"
+                                                : info_.snapshot_address)
+            << ".";
+  return true;
+}
+
+bool PriceMulticastPublisher::OpenSnapshotService() {
+  struct sockaddr_storage address;
+  int address_length = sizeof(address);
+  memset(&address, 0, sizeof(address));
+  if (info_.snapshot_address[0] == '/') {
+    struct sockaddr_un* un = reinterpret_cast<struct sockaddr_un*>(&address);
+    if (info_.snapshot_address.size() >= sizeof(un->sun_path)) {
+      LOG(ERROR) << "Snapshot socket path is too long: "
+                 << info_.snapshot_address;
+      return false;
+    }
+    un->sun_family = AF_UNIX;
+    strcpy(un->sun_path, info_.snapshot_address.c_str());
+    address_length = sizeof(struct sockaddr_un);
+    // Left by previous run.
+    unlink(info_.snapshot_address.c_str());
+  } else if (evutil_parse_sockaddr_port(
+                 info_.snapshot_address.c_str(),
+                 reinterpret_cast<struct sockaddr*>(&address),
+                 &address_length) != 0) {
+    LOG(ERROR) << "Invalid snapshot address: " << info_.snapshot_address;
+    return false;
+  }
+
+  snapshot_listener_ = evconnlistener_new_bind(
+      io_runtime_->GetEventBase(io_loop_index_),
+      &PriceMulticastPublisher::OnAccept, this,
+      LEV_OPT_CLOSE_ON_FREE | LEV_OPT_REUSEABLE, -1,
+      reinterpret_cast<struct sockaddr*>(&address), address_length);
+  if (snapshot_listener_ == nullptr) {
+    LOG(ERROR) << "Cannot listen on " << info_.snapshot_address << ": "
+               << strerror(errno);
+    return false;
+  }
+  evconnlistener_set_error_cb(snapshot_listener_,
+                              &PriceMulticastPublisher::OnAcceptError);
+  accept_timer_ = evtimer_new(io_runtime_->GetEventBase(io_loop_index_),
+                              &PriceMulticastPublisher::OnAcceptResumed, this);
+  return true;
+}
+
+void PriceMulticastPublisher::Publish(
+    const std::vector<FairValueData>& data_list) {
+  if (data_list.empty())
+    return;
+
+  std::shared_ptr<std::vector<common::PriceMulticastUpdate>> updates(
+      new std::vector<common::PriceMulticastUpdate>());
+  updates->reserve(data_list.size());
+  for (auto& data : data_list) {
+    updates->push_back({data.symbol_name.substr(
+                            0, common::kPriceMulticastMaxSymbolNameSize),
+                        data.timestamp, data.fair_value,
+                        data.moving_average, data.standard_deviation_ratio});
+  }
+  // |this| is valid, publisher is destroyed after event loops are stopped.
+  io_runtime_->Post(io_loop_index_, [this, updates]() {
+    OnUpdates(*updates);
+  });
+}
+
+void PriceMulticastPublisher::OnUpdates(
+    const std::vector<common::PriceMulticastUpdate>& updates) {
+  for (auto& update : updates) {
+    auto it = symbol_indexes_.find(update.symbol_name);
+    if (it == symbol_indexes_.end()) {
+      symbol_indexes_[update.symbol_name] = latest_updates_.size();
+      latest_updates_.push_back(update);
+    } else {
+      latest_updates_[it->second] = update;
+    }
+    Append(update);
+  }
+  // Updates of a loop are not held back, datagram is sent even if not full.
+  Flush();
+  update_count_ += updates.size();
+}
+
+void PriceMulticastPublisher::Append(
+    const common::PriceMulticastUpdate& update) {
+  if (datagram_size_ + common::GetPriceMulticastUpdateSize(update) >
+      sizeof(datagram_))
+    Flush();
+  datagram_size_ +=
+      common::WritePriceMulticastUpdate(update, datagram_ + datagram_size_);
+  datagram_update_count_++;
+}
+
+void PriceMulticastPublisher::Flush() {
+  if (datagram_update_count_ == 0)
+    return;
+  Send(++sequence_, datagram_update_count_);
+  sent_ = true;
+  datagram_size_ = common::kPriceMulticastDatagramHeaderSize;
+  datagram_update_count_ = 0;
+}
+
+void PriceMulticastPublisher::Send(uint64_t sequence,
+                                   uint16_t update_count) {
+  common::WritePriceMulticastHeader(session_, sequence, update_count,
+                                    datagram_);
+  size_t size = update_count == 0 ? common::kPriceMulticastDatagramHeaderSize
+                                  : datagram_size_;
+  // Datagram is dropped if socket buffer is full, receivers recover from
+  // snapshot.
+  if (sendto(socket_, datagram_, size, 0,
+             reinterpret_cast<struct sockaddr*>(&group_address_),
+             sizeof(group_address_)) < 0) {
+    send_error_count_++;
+    LOG_EVERY_N(ERROR, 1000) << "Cannot send multicast datagram: "
+                             << strerror(errno);
+  }
+}
+
+void PriceMulticastPublisher::WriteSnapshot(struct bufferevent* connection) {
+  // Datagram of last loop is already sent, so snapshot matches |sequence_|.
+  struct evbuffer* output = bufferevent_get_output(connection);
+  char header[common::kPriceMulticastSnapshotHeaderSize];
+  common::WritePriceMulticastSnapshotHeader(
+      session_, sequence_, latest_updates_.size(), header);
+  evbuffer_add(output, header, sizeof(header));
+  char buffer[common::kPriceMulticastMaxSymbolNameSize +
+              common::kPriceMulticastUpdateFixedSize];
+  for (auto& update : latest_updates_) {
+    evbuffer_add(output, buffer,
+                 common::WritePriceMulticastUpdate(update, buffer));
+  }
+  snapshot_count_++;
+}
+
+void PriceMulticastPublisher::CloseSnapshotConnection(
+    struct bufferevent* connection) {
+  snapshot_connections_.erase(connection);
+  bufferevent_free(connection);
+}
+
+void PriceMulticastPublisher::LogCounters() {
+  auto now = std::chrono::steady_clock::now();
+  if (update_count_ == logged_update_count_ ||
+      now - last_log_time_ < std::chrono::seconds(kCounterLogInterval))
+    return;
+  last_log_time_ = now;
+  logged_update_count_ = update_count_;
+  LOG(INFO) << "Multicast price feed: " << update_count_ << " updates, "
+            << sequence_ << " datagrams, " << send_error_count_
+            << " send errors, " << snapshot_count_ << " snapshots.";
+}
+
+// static
+void PriceMulticastPublisher::OnAccept(struct evconnlistener* listener,
+                                       int fd, struct sockaddr* address,
+                                       int address_length, void* arg) {
+  PriceMulticastPublisher* publisher =
+      static_cast<PriceMulticastPublisher*>(arg);
+  struct bufferevent* connection = bufferevent_socket_new(
+      evconnlistener_get_base(listener), fd, BEV_OPT_CLOSE_ON_FREE);
+  if (connection == nullptr) {
+    LOG(ERROR) << "Cannot create connection of snapshot service.";
+    evutil_closesocket(fd);
+    return;
+  }
+
+  // Connection is closed when whole snapshot is written.
+  publisher->snapshot_connections_.insert(connection);
+  bufferevent_setcb(connection, nullptr,
+                    &PriceMulticastPublisher::OnSnapshotWritten,
+                    &PriceMulticastPublisher::OnSnapshotEvent, publisher);
+  publisher->WriteSnapshot(connection);
+  bufferevent_enable(connection, EV_WRITE);
+}
+
+// static
+void PriceMulticastPublisher::OnAcceptError(struct evconnlistener* listener,
+                                            void* arg) {
+  PriceMulticastPublisher* publisher =
+      static_cast<PriceMulticastPublisher*>(arg);
+  LOG(ERROR) << "Cannot accept connection of snapshot service: "
+             << evutil_socket_error_to_string(EVUTIL_SOCKET_ERROR())
+             << ", pause accepting.";
+  evconnlistener_disable(listener);
+  struct timeval delay = {kAcceptPauseTime, 0};
+  evtimer_add(publisher->accept_timer_, &delay);
+}
+
+// static
+void PriceMulticastPublisher::OnAcceptResumed(int fd, short events,
+                                              void* arg) {
+  PriceMulticastPublisher* publisher =
+      static_cast<PriceMulticastPublisher*>(arg);
+  evconnlistener_enable(publisher->snapshot_listener_);
+}
+
+// static
+void PriceMulticastPublisher::OnSnapshotWritten(
+    struct bufferevent* connection, void* arg) {
+  PriceMulticastPublisher* publisher =
+      static_cast<PriceMulticastPublisher*>(arg);
+  if (evbuffer_get_length(bufferevent_get_output(connection)) == 0)
+    publisher->CloseSnapshotConnection(connection);
+}
+
+// static
+void PriceMulticastPublisher::OnSnapshotEvent(
+    struct bufferevent* connection, short events, void* arg) {
+  PriceMulticastPublisher* publisher =
+      static_cast<PriceMulticastPublisher*>(arg);
+  if (events & (BEV_EVENT_EOF | BEV_EVENT_ERROR))
+    publisher->CloseSnapshotConnection(connection);
+}
+
+// static
+void PriceMulticastPublisher::OnHeartbeat(int fd, short events, void* arg) {
+  PriceMulticastPublisher* publisher =
+      static_cast<PriceMulticastPublisher*>(arg);
+  if (!publisher->sent_)
+    publisher->Send(publisher->sequence_, 0);
+  publisher->sent_ = false;
+  publisher->LogCounters();
+}
@@ -0,0 +1,105 @@
+#ifndef PRICE_MULTICAST_PUBLISHER_H_
+#define PRICE_MULTICAST_PUBLISHER_H_
+
+#include <netinet/in.h>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "common/price_multicast_protocol.h"
+#include "configuration.h"
+#include "io_runtime.h"
+#include "symbol.h"
+
+struct bufferevent;
+struct event;
+struct evconnlistener;
+
+// Publishes fair values to a UDP multicast group (protocol: see
+// common/price_multicast_protocol.h), one stream for any number of consumers
+// on local network. Updates are packed into datagrams of MTU size.
+//
+// Multicast is not reliable: receivers detect lost datagrams by sequence
+// number, and recover from snapshot service (latest update of every symbol)
+// which runs on the same loop, so snapshot is consistent with sequence.
+// See common/price_multicast_receiver.h for the receiver, and
+// "PE --receive-multicast" (multicast_monitor.h) to watch the feed.
+class PriceMulticastPublisher {
+public:
+  PriceMulticastPublisher(IORuntime* io_runtime,
+                          const MulticastOutputInformation& info);
+  virtual ~PriceMulticastPublisher();
+
+  PriceMulticastPublisher(const PriceMulticastPublisher&) = delete;
+  PriceMulticastPublisher& operator=(const PriceMulticastPublisher&) = delete;
+
+  // Create socket and start snapshot service. Must be called before
+  // |io_runtime| is started, publisher is closed when it is destroyed (after
+  // |io_runtime| is stopped). Return false if failed.
+  bool Open();
+
+  // Send |data_list| to multicast group. Called by loop threads of groups.
+  void Publish(const std::vector<FairValueData>& data_list);
+
+private:
+  // All functions below run on publisher loop thread.
+  void OnUpdates(const std::vector<common::PriceMulticastUpdate>& updates);
+  // Add |update| to current datagram, it is sent first if full.
+  void Append(const common::PriceMulticastUpdate& update);
+  // Send current datagram if it has updates.
+  void Flush();
+  // Send datagram with |update_count| updates (heartbeat if 0).
+  void Send(uint64_t sequence, uint16_t update_count);
+  void WriteSnapshot(struct bufferevent* connection);
+  void CloseSnapshotConnection(struct bufferevent* connection);
+  bool OpenSnapshotService();
+  // Log counters periodically.
+  void LogCounters();
+
+  static void OnAccept(struct evconnlistener* listener, int fd,
+                       struct sockaddr* address, int address_length,
+                       void* arg);
+  // Accepting is paused for a while (ex: out of file descriptors), listener
+  // would be woken up again and again.
+  static void OnAcceptError(struct evconnlistener* listener, void* arg);
+  static void OnAcceptResumed(int fd, short events, void* arg);
+  static void OnSnapshotWritten(struct bufferevent* connection, void* arg);
+  static void OnSnapshotEvent(struct bufferevent* connection, short events,
+                              void* arg);
+  static void OnHeartbeat(int fd, short events, void* arg);
+
+  IORuntime* io_runtime_;
+  size_t io_loop_index_;
+  MulticastOutputInformation info_;
+  int socket_ = -1;
+  struct sockaddr_in group_address_;
+  struct evconnlistener* snapshot_listener_ = nullptr;
+  struct event* accept_timer_ = nullptr;
+  // Snapshots which are being written.
+  std::set<struct bufferevent*> snapshot_connections_;
+  struct event* heartbeat_event_ = nullptr;
+
+  uint32_t session_;
+  // Sequence of last sent datagram.
+  uint64_t sequence_ = 0;
+  // A datagram is sent since last heartbeat.
+  bool sent_ = false;
+  char datagram_[common::kPriceMulticastMaxDatagramSize];
+  size_t datagram_size_;
+  uint16_t datagram_update_count_ = 0;
+
+  // Latest update of each symbol, for snapshots.
+  std::unordered_map<std::string, size_t> symbol_indexes_;
+  std::vector<common::PriceMulticastUpdate> latest_updates_;
+
+  std::chrono::steady_clock::time_point last_log_time_;
+  uint64_t update_count_ = 0;
+  uint64_t logged_update_count_ = 0;
+  uint64_t send_error_count_ = 0;
+  uint64_t snapshot_count_ = 0;
+};
+
+#endif  // PRICE_MULTICAST_PUBLISHER_H_
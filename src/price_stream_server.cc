@@ -0,0 +1,537 @@
+#include "price_stream_server.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <event2/buffer.h>
+#include <event2/bufferevent.h>
+#include <event2/event.h>
+#include <event2/listener.h>
+#include <event2/util.h>
+#include "glog/logging.h"
+
+namespace {
+
+// Max number of symbols which clients can know.
+const size_t kMaxSymbolNumber = 65536;
+// Max number of subscribed symbols which are not published yet, of each
+// client.
+const size_t kMaxPendingNameNumber = 4096;
+// Accepting is paused for this long after it failed. (seconds)
+const int kAcceptPauseTime = 1;
+// Interval to log counters. (seconds)
+const int kCounterLogInterval = 60;
+
+// "host:port" of a client.
+std::string FormatAddress(const struct sockaddr* address) {
+  char host[INET6_ADDRSTRLEN] = "";
+  int port = 0;
+  if (address->sa_family == AF_INET) {
+    const struct sockaddr_in* in =
+        reinterpret_cast<const struct sockaddr_in*>(address);
+    evutil_inet_ntop(AF_INET, &in->sin_addr, host, sizeof(host));
+    port = ntohs(in->sin_port);
+  } else if (address->sa_family == AF_INET6) {
+    const struct sockaddr_in6* in6 =
+        reinterpret_cast<const struct sockaddr_in6*>(address);
+    evutil_inet_ntop(AF_INET6, &in6->sin6_addr, host, sizeof(host));
+    port = ntohs(in6->sin6_port);
+  }
+  return std::string(host) + ":" + std::to_string(port);
+}
+
+template<typename T>
+void Remove(std::vector<T>& items, const T& item) {
+  items.erase(std::remove(items.begin(), items.end(), item), items.end());
+}
+
+} // namespace
+
+PriceStreamServer::PriceStreamServer(IORuntime* io_runtime,
+                                     const StreamOutputInformation& info)
+    : io_runtime_(io_runtime),
+      io_loop_index_(io_runtime->GetLoopIndex("price-stream")),
+      info_(info),
+      last_log_time_(std::chrono::steady_clock::now()) {}
+
+PriceStreamServer::~PriceStreamServer() {
+  // Loop thread is stopped, so connections are closed here.
+  for (auto& client : clients_)
+    bufferevent_free(client->bufferevent);
+  if (listener_ != nullptr)
+    evconnlistener_free(listener_);
+  if (accept_timer_ != nullptr)
+    event_free(accept_timer_);
+}
+
+bool PriceStreamServer::Open() {
+  struct sockaddr_storage address;
+  int address_length = sizeof(address);
+  memset(&address, 0, sizeof(address));
+  if (evutil_parse_sockaddr_port(
+          info_.address.c_str(), reinterpret_cast<struct sockaddr*>(&address),
+          &address_length) != 0) {
+    LOG(ERROR) << "Invalid price stream address: " << info_.address;
+    return false;
+  }
+
+  listener_ = evconnlistener_new_bind(
+      io_runtime_->GetEventBase(io_loop_index_), &PriceStreamServer::OnAccept,
+      this, LEV_OPT_CLOSE_ON_FREE | LEV_OPT_REUSEABLE, -1,
+      reinterpret_cast<struct sockaddr*>(&address), address_length);
+  if (listener_ == nullptr) {
+    LOG(ERROR) << "Cannot listen on " << info_.address << ": "
+               << strerror(errno);
+    return false;
+  }
+  evconnlistener_set_error_cb(listener_, &PriceStreamServer::OnAcceptError);
+  accept_timer_ = evtimer_new(io_runtime_->GetEventBase(io_loop_index_),
+                              &PriceStreamServer::OnAcceptResumed, this);
+
+  LOG(INFO) << "Price stream server is listening on " << info_.address
+            << ".";
+  return true;
+}
+
+void PriceStreamServer::Publish(const std::vector<FairValueData>& data_list) {
+  if (data_list.empty())
+    return;
+
+  std::shared_ptr<std::vector<Update>> updates(new std::vector<Update>());
+  updates->reserve(data_list.size());
+  for (auto& data : data_list) {
+    updates->push_back({data.symbol_name, data.timestamp,
+                        data.fair_value, data.moving_average,
+                        data.standard_deviation_ratio});
+  }
+  // |this| is valid, server is destroyed after event loops are stopped.
+  io_runtime_->Post(io_loop_index_, [this, updates]() {
+    OnUpdates(*updates);
+  });
+}
+
+void PriceStreamServer::OnUpdates(const std::vector<Update>& updates) {
+  frames_.clear();
+  frame_symbol_ids_.clear();
+  char frame[common::kPriceStreamFrameHeaderSize +
+             common::kPriceStreamUpdateSize];
+  for (auto& update : updates) {
+    int symbol_id = GetSymbolId(update.symbol_name);
+    if (symbol_id < 0)
+      continue;
+
+    SymbolState& symbol = symbols_[symbol_id];
+    symbol.has_price = true;
+    symbol.latest.sequence++;
+    symbol.latest.timestamp = update.timestamp;
+    symbol.latest.fair_value = update.fair_value;
+    symbol.latest.moving_average = update.moving_average;
+    symbol.latest.standard_deviation_ratio = update.standard_deviation_ratio;
+    update_count_++;
+
+    common::WritePriceStreamUpdate(symbol.latest, frame);
+    frames_.append(frame, sizeof(frame));
+    frame_symbol_ids_.push_back(symbol_id);
+    for (Client* client : symbol.subscribers)
+      SendUpdate(client, symbol_id);
+  }
+
+  // Clients of all symbols get all frames at once.
+  for (Client* client : all_subscribers_) {
+    if (!client->congested) {
+      Write(client, frames_.data(), frames_.size());
+      continue;
+    }
+    for (uint32_t symbol_id : frame_symbol_ids_)
+      MarkPending(client, symbol_id);
+  }
+
+  LogCounters();
+}
+
+int PriceStreamServer::GetSymbolId(const std::string& name) {
+  auto it = symbol_ids_.find(name);
+  if (it != symbol_ids_.end())
+    return it->second;
+  if (symbols_.size() >= kMaxSymbolNumber) {
+    LOG_EVERY_N(WARNING, 1000) << "Too many symbols in price stream, ignore "
+                               << name;
+    return -1;
+  }
+
+  uint32_t symbol_id = symbols_.size();
+  symbols_.emplace_back();
+  SymbolState& symbol = symbols_.back();
+  symbol.name = name;
+  symbol.has_price = false;
+  symbol.latest = common::PriceStreamUpdate();
+  symbol.latest.symbol_id = symbol_id;
+  symbol_ids_[name] = symbol_id;
+
+  for (Client* client : all_subscribers_)
+    SendSymbol(client, symbol_id);
+  auto pending = pending_subscribers_.find(name);
+  if (pending != pending_subscribers_.end()) {
+    for (Client* client : pending->second) {
+      client->pending_names.erase(name);
+      AddSubscriber(client, symbol_id);
+    }
+    pending_subscribers_.erase(pending);
+  }
+  return symbol_id;
+}
+
+void PriceStreamServer::Subscribe(Client* client,
+                                  const std::vector<std::string>& names) {
+  // Snapshot is written even if client is congested, its size is limited by
+  // number of symbols. Next frame is not read until it is drained.
+  if (names.empty()) {
+    if (!client->all_symbols) {
+      UnsubscribeAll(client);
+      client->all_symbols = true;
+      all_subscribers_.push_back(client);
+    }
+    for (uint32_t symbol_id = 0; symbol_id < symbols_.size(); symbol_id++) {
+      SendSymbol(client, symbol_id);
+      if (symbols_[symbol_id].has_price)
+        SendLatest(client, symbol_id);
+    }
+  } else if (!client->all_symbols) {
+    for (auto& name : names) {
+      auto it = symbol_ids_.find(name);
+      if (it == symbol_ids_.end()) {
+        AddPendingName(client, name);
+        continue;
+      }
+      uint32_t symbol_id = it->second;
+      if (IsSubscribed(client, symbol_id))
+        continue;
+
+      AddSubscriber(client, symbol_id);
+      if (symbols_[symbol_id].has_price)
+        SendLatest(client, symbol_id);
+    }
+  }
+
+  char frame[common::kPriceStreamFrameHeaderSize];
+  common::WritePriceStreamHeader(common::PRICE_STREAM_SNAPSHOT_END, 0, frame);
+  Write(client, frame, sizeof(frame));
+}
+
+void PriceStreamServer::Unsubscribe(Client* client,
+                                    const std::vector<std::string>& names) {
+  if (names.empty()) {
+    if (client->all_symbols) {
+      client->all_symbols = false;
+      Remove(all_subscribers_, client);
+    }
+    UnsubscribeAll(client);
+    return;
+  }
+
+  // Single symbols cannot be removed from all symbols.
+  if (client->all_symbols)
+    return;
+  for (auto& name : names) {
+    auto it = symbol_ids_.find(name);
+    if (it == symbol_ids_.end()) {
+      RemovePendingName(client, name);
+      continue;
+    }
+    if (!IsSubscribed(client, it->second))
+      continue;
+    client->subscribed[it->second] = 0;
+    Remove(symbols_[it->second].subscribers, client);
+  }
+}
+
+void PriceStreamServer::UnsubscribeAll(Client* client) {
+  for (uint32_t symbol_id = 0; symbol_id < client->subscribed.size();
+       symbol_id++) {
+    if (client->subscribed[symbol_id])
+      Remove(symbols_[symbol_id].subscribers, client);
+  }
+  client->subscribed.clear();
+  while (!client->pending_names.empty())
+    RemovePendingName(client, *client->pending_names.begin());
+}
+
+void PriceStreamServer::AddSubscriber(Client* client, uint32_t symbol_id) {
+  if (client->subscribed.size() <= symbol_id)
+    client->subscribed.resize(symbols_.size(), 0);
+  client->subscribed[symbol_id] = 1;
+  symbols_[symbol_id].subscribers.push_back(client);
+  SendSymbol(client, symbol_id);
+}
+
+void PriceStreamServer::AddPendingName(Client* client,
+                                       const std::string& name) {
+  if (client->pending_names.count(name) > 0)
+    return;
+  if (client->pending_names.size() >= kMaxPendingNameNumber) {
+    LOG_EVERY_N(WARNING, 1000) << "Too many unknown symbols subscribed by "
+                               << "price stream client " << client->address
+                               << ", ignore " << name;
+    return;
+  }
+  client->pending_names.insert(name);
+  pending_subscribers_[name].push_back(client);
+}
+
+void PriceStreamServer::RemovePendingName(Client* client,
+                                          const std::string& name) {
+  if (client->pending_names.erase(name) == 0)
+    return;
+  auto it = pending_subscribers_.find(name);
+  Remove(it->second, client);
+  if (it->second.empty())
+    pending_subscribers_.erase(it);
+}
+
+bool PriceStreamServer::IsSubscribed(const Client* client,
+                                     uint32_t symbol_id) const {
+  return client->all_symbols ||
+         (symbol_id < client->subscribed.size() &&
+          client->subscribed[symbol_id]);
+}
+
+void PriceStreamServer::SendSymbol(Client* client, uint32_t symbol_id) {
+  const std::string& name = symbols_[symbol_id].name;
+  size_t name_size = std::min(name.size(),
+                              common::kPriceStreamMaxSymbolNameSize);
+  size_t payload_size = sizeof(symbol_id) + 1 + name_size;
+  char frame[common::kPriceStreamFrameHeaderSize + sizeof(symbol_id) + 1 +
+             common::kPriceStreamMaxSymbolNameSize];
+  common::WritePriceStreamHeader(common::PRICE_STREAM_SYMBOL, payload_size,
+                                 frame);
+  char* out = frame + common::kPriceStreamFrameHeaderSize;
+  memcpy(out, &symbol_id, sizeof(symbol_id));
+  out[sizeof(symbol_id)] = static_cast<char>(name_size);
+  memcpy(out + sizeof(symbol_id) + 1, name.data(), name_size);
+  Write(client, frame, common::kPriceStreamFrameHeaderSize + payload_size);
+}
+
+void PriceStreamServer::SendUpdate(Client* client, uint32_t symbol_id) {
+  if (client->congested)
+    MarkPending(client, symbol_id);
+  else
+    SendLatest(client, symbol_id);
+}
+
+void PriceStreamServer::SendLatest(Client* client, uint32_t symbol_id) {
+  // Pending update of this symbol is sent now.
+  if (symbol_id < client->pending.size())
+    client->pending[symbol_id] = 0;
+
+  char frame[common::kPriceStreamFrameHeaderSize +
+             common::kPriceStreamUpdateSize];
+  common::WritePriceStreamUpdate(symbols_[symbol_id].latest, frame);
+  Write(client, frame, sizeof(frame));
+}
+
+void PriceStreamServer::Write(Client* client, const char* data,
+                              size_t size) {
+  struct evbuffer* output = bufferevent_get_output(client->bufferevent);
+  evbuffer_add(output, data, size);
+  if (evbuffer_get_length(output) >= info_.max_output_buffer)
+    client->congested = true;
+}
+
+void PriceStreamServer::MarkPending(Client* client, uint32_t symbol_id) {
+  conflated_count_++;
+  if (client->pending.size() <= symbol_id)
+    client->pending.resize(symbols_.size(), 0);
+  if (client->pending[symbol_id])
+    return;
+  client->pending[symbol_id] = 1;
+  client->pending_ids.push_back(symbol_id);
+}
+
+void PriceStreamServer::FlushPending(Client* client) {
+  client->congested = false;
+  size_t flushed = 0;
+  while (flushed < client->pending_ids.size() && !client->congested) {
+    uint32_t symbol_id = client->pending_ids[flushed++];
+    // Already sent (by a snapshot), or unsubscribed meanwhile.
+    if (!client->pending[symbol_id])
+      continue;
+    client->pending[symbol_id] = 0;
+    if (IsSubscribed(client, symbol_id))
+      SendLatest(client, symbol_id);
+  }
+  client->pending_ids.erase(client->pending_ids.begin(),
+                            client->pending_ids.begin() + flushed);
+}
+
+bool PriceStreamServer::ReadFrames(Client* client) {
+  struct evbuffer* input = bufferevent_get_input(client->bufferevent);
+  std::string frame;
+  while (true) {
+    // Each SUBSCRIBE writes a snapshot, client must read it first.
+    if (client->congested) {
+      bufferevent_disable(client->bufferevent, EV_READ);
+      return true;
+    }
+    size_t available = evbuffer_get_length(input);
+    if (available < common::kPriceStreamFrameHeaderSize)
+      return true;
+
+    uint32_t length = 0;
+    evbuffer_copyout(input, &length, sizeof(length));
+    if (length == 0 || length > common::kPriceStreamMaxFrameLength) {
+      LOG(ERROR) << "Invalid frame length " << length
+                 << " from price stream client " << client->address;
+      return false;
+    }
+    if (available < sizeof(length) + length)
+      return true;
+
+    frame.resize(sizeof(length) + length);
+    evbuffer_remove(input, &frame[0], frame.size());
+
+    // Payload: | length (uint8) | name | ...
+    std::vector<std::string> names;
+    size_t offset = common::kPriceStreamFrameHeaderSize;
+    while (offset < frame.size()) {
+      size_t name_size = static_cast<uint8_t>(frame[offset++]);
+      if (offset + name_size > frame.size()) {
+        LOG(ERROR) << "Invalid symbol list from price stream client "
+                   << client->address;
+        return false;
+      }
+      names.emplace_back(frame.data() + offset, name_size);
+      offset += name_size;
+    }
+
+    uint8_t type = static_cast<uint8_t>(frame[4]);
+    if (type == common::PRICE_STREAM_SUBSCRIBE) {
+      Subscribe(client, names);
+    } else if (type == common::PRICE_STREAM_UNSUBSCRIBE) {
+      Unsubscribe(client, names);
+    } else {
+      LOG(ERROR) << "Unknown message " << static_cast<int>(type)
+                 << " from price stream client " << client->address;
+      return false;
+    }
+  }
+}
+
+void PriceStreamServer::CloseClient(Client* client) {
+  LOG(INFO) << "Price stream client " << client->address
+            << " is disconnected.";
+  if (client->all_symbols)
+    Remove(all_subscribers_, client);
+  UnsubscribeAll(client);
+  bufferevent_free(client->bufferevent);
+  clients_.erase(std::find_if(
+      clients_.begin(), clients_.end(),
+      [client](const std::unique_ptr<Client>& item) {
+        return item.get() == client;
+      }));
+}
+
+void PriceStreamServer::LogCounters() {
+  auto now = std::chrono::steady_clock::now();
+  if (update_count_ == logged_update_count_ ||
+      now - last_log_time_ < std::chrono::seconds(kCounterLogInterval))
+    return;
+  last_log_time_ = now;
+  logged_update_count_ = update_count_;
+
+  size_t congested = 0;
+  for (auto& client : clients_) {
+    if (client->congested)
+      congested++;
+  }
+  LOG(INFO) << "Price stream: " << clients_.size() << " clients ("
+            << congested << " congested), " << symbols_.size()
+            << " symbols, " << update_count_ << " updates, "
+            << conflated_count_ << " conflated.";
+}
+
+// static
+void PriceStreamServer::OnAccept(struct evconnlistener* listener, int fd,
+                                 struct sockaddr* address,
+                                 int address_length, void* arg) {
+  PriceStreamServer* server = static_cast<PriceStreamServer*>(arg);
+  // Updates are small, send them right away.
+  int nodelay = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+  struct bufferevent* bufferevent = bufferevent_socket_new(
+      evconnlistener_get_base(listener), fd, BEV_OPT_CLOSE_ON_FREE);
+  if (bufferevent == nullptr) {
+    LOG(ERROR) << "Cannot create connection of price stream client.";
+    evutil_closesocket(fd);
+    return;
+  }
+
+  std::unique_ptr<Client> client(new Client());
+  client->server = server;
+  client->bufferevent = bufferevent;
+  client->address = FormatAddress(address);
+  client->all_symbols = false;
+  client->congested = false;
+  // Write callback is called when output buffer is drained to half.
+  bufferevent_setcb(bufferevent, &PriceStreamServer::OnRead,
+                    &PriceStreamServer::OnWrite, &PriceStreamServer::OnEvent,
+                    client.get());
+  bufferevent_setwatermark(bufferevent, EV_WRITE,
+                           server->info_.max_output_buffer / 2, 0);
+  bufferevent_enable(bufferevent, EV_READ | EV_WRITE);
+
+  LOG(INFO) << "Price stream client " << client->address
+            << " is connected.";
+  server->clients_.push_back(std::move(client));
+}
+
+// static
+void PriceStreamServer::OnAcceptError(struct evconnlistener* listener,
+                                      void* arg) {
+  PriceStreamServer* server = static_cast<PriceStreamServer*>(arg);
+  LOG(ERROR) << "Cannot accept price stream client: "
+             << evutil_socket_error_to_string(EVUTIL_SOCKET_ERROR())
+             << ", pause accepting.";
+  evconnlistener_disable(listener);
+  struct timeval delay = {kAcceptPauseTime, 0};
+  evtimer_add(server->accept_timer_, &delay);
+}
+
+// static
+void PriceStreamServer::OnAcceptResumed(int fd, short events, void* arg) {
+  PriceStreamServer* server = static_cast<PriceStreamServer*>(arg);
+  evconnlistener_enable(server->listener_);
+}
+
+// static
+void PriceStreamServer::OnRead(struct bufferevent* bufferevent, void* arg) {
+  Client* client = static_cast<Client*>(arg);
+  if (!client->server->ReadFrames(client))
+    client->server->CloseClient(client);
+}
+
+// static
+void PriceStreamServer::OnWrite(struct bufferevent* bufferevent, void* arg) {
+  Client* client = static_cast<Client*>(arg);
+  if (!client->congested)
+    return;
+  client->server->FlushPending(client);
+  // Frames which wait in input buffer (next read event may not come).
+  if (!client->congested) {
+    bufferevent_enable(bufferevent, EV_READ);
+    if (!client->server->ReadFrames(client))
+      client->server->CloseClient(client);
+  }
+}
+
+// static
+void PriceStreamServer::OnEvent(struct bufferevent* bufferevent,
+                                short events, void* arg) {
+  Client* client = static_cast<Client*>(arg);
+  if (events & (BEV_EVENT_EOF | BEV_EVENT_ERROR))
+    client->server->CloseClient(client);
+}
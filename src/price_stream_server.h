@@ -0,0 +1,155 @@
+#ifndef PRICE_STREAM_SERVER_H_
+#define PRICE_STREAM_SERVER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "common/price_stream_protocol.h"
+#include "configuration.h"
+#include "io_runtime.h"
+#include "symbol.h"
+
+struct bufferevent;
+struct event;
+struct evconnlistener;
+
+// Streams fair values to downstream consumers over TCP (protocol: see
+// common/price_stream_protocol.h), so they do not wait for redis. Clients
+// subscribe to symbols (or all symbols), get a snapshot of latest prices,
+// then every update.
+//
+// Server runs on one loop of |io_runtime|, groups hand updates of each loop
+// over by |Publish()|. An update is encoded once per loop for clients of all
+// symbols. Output buffer of each client is bounded: while it is full,
+// updates of that client are conflated (latest price of each symbol is sent
+// after buffer is drained) and its requests are not read, so slow clients do
+// not slow down the others.
+class PriceStreamServer {
+public:
+  PriceStreamServer(IORuntime* io_runtime,
+                    const StreamOutputInformation& info);
+  virtual ~PriceStreamServer();
+
+  PriceStreamServer(const PriceStreamServer&) = delete;
+  PriceStreamServer& operator=(const PriceStreamServer&) = delete;
+
+  // Start listening. Must be called before |io_runtime| is started, server
+  // is closed when it is destroyed (after |io_runtime| is stopped). Return
+  // false if failed.
+  bool Open();
+
+  // Send |data_list| to subscribed clients. Called by loop threads of
+  // groups.
+  void Publish(const std::vector<FairValueData>& data_list);
+
+private:
+  struct Update {
+    std::string symbol_name;
+    uint64_t timestamp;
+    common::Decimal fair_value;
+    double moving_average;
+    double standard_deviation_ratio;
+  };
+
+  struct Client {
+    PriceStreamServer* server;
+    struct bufferevent* bufferevent;
+    std::string address;
+    // Subscribed to all symbols, otherwise to symbols of |subscribed|.
+    bool all_symbols;
+    // Flag of each symbol id.
+    std::vector<uint8_t> subscribed;
+    // Output buffer is full, updates are added to |pending_ids|.
+    bool congested;
+    std::vector<uint32_t> pending_ids;
+    // Flag of each symbol id, symbol is in |pending_ids|.
+    std::vector<uint8_t> pending;
+    // Subscribed names of symbols which are not published yet.
+    std::unordered_set<std::string> pending_names;
+  };
+
+  struct SymbolState {
+    std::string name;
+    bool has_price;
+    common::PriceStreamUpdate latest;
+    // Clients which subscribe this symbol by name.
+    std::vector<Client*> subscribers;
+  };
+
+  // All functions below run on server loop thread.
+  void OnUpdates(const std::vector<Update>& updates);
+
+  // Id of published symbol |name|, it is added (and announced to its
+  // subscribers) if not known. Return -1 if there are too many symbols.
+  int GetSymbolId(const std::string& name);
+
+  void Subscribe(Client* client, const std::vector<std::string>& names);
+  void Unsubscribe(Client* client, const std::vector<std::string>& names);
+  // Remove |client| from subscribers of all symbols.
+  void UnsubscribeAll(Client* client);
+  void AddSubscriber(Client* client, uint32_t symbol_id);
+  // Subscribe |name| when it is published, no id is allocated before.
+  void AddPendingName(Client* client, const std::string& name);
+  void RemovePendingName(Client* client, const std::string& name);
+  bool IsSubscribed(const Client* client, uint32_t symbol_id) const;
+
+  void SendSymbol(Client* client, uint32_t symbol_id);
+  // Send latest price of symbol, or mark it pending if |client| is
+  // congested.
+  void SendUpdate(Client* client, uint32_t symbol_id);
+  // Send latest price of symbol, even if |client| is congested.
+  void SendLatest(Client* client, uint32_t symbol_id);
+  // Write |size| bytes to |client|, it is congested if output buffer is
+  // full after that.
+  void Write(Client* client, const char* data, size_t size);
+  void MarkPending(Client* client, uint32_t symbol_id);
+  // Send latest prices of pending symbols, until buffer is full again.
+  void FlushPending(Client* client);
+
+  // Read frames of |client|, until it is congested (rest is read after its
+  // buffer is drained). Return false if it sent an invalid frame.
+  bool ReadFrames(Client* client);
+  void CloseClient(Client* client);
+  // Log counters periodically.
+  void LogCounters();
+
+  static void OnAccept(struct evconnlistener* listener, int fd,
+                       struct sockaddr* address, int address_length,
+                       void* arg);
+  // Accepting is paused for a while (ex: out of file descriptors), listener
+  // would be woken up again and again.
+  static void OnAcceptError(struct evconnlistener* listener, void* arg);
+  static void OnAcceptResumed(int fd, short events, void* arg);
+  static void OnRead(struct bufferevent* bufferevent, void* arg);
+  static void OnWrite(struct bufferevent* bufferevent, void* arg);
+  static void OnEvent(struct bufferevent* bufferevent, short events,
+                      void* arg);
+
+  IORuntime* io_runtime_;
+  size_t io_loop_index_;
+  StreamOutputInformation info_;
+  struct evconnlistener* listener_ = nullptr;
+  struct event* accept_timer_ = nullptr;
+
+  std::vector<std::unique_ptr<Client>> clients_;
+  // Clients which subscribe all symbols.
+  std::vector<Client*> all_subscribers_;
+  std::unordered_map<std::string, uint32_t> symbol_ids_;
+  std::vector<SymbolState> symbols_;
+  // Clients which subscribe each name of |Client::pending_names|.
+  std::unordered_map<std::string, std::vector<Client*>> pending_subscribers_;
+  // Encoded updates of a |Publish()|, for clients of all symbols.
+  std::string frames_;
+  std::vector<uint32_t> frame_symbol_ids_;
+
+  std::chrono::steady_clock::time_point last_log_time_;
+  uint64_t update_count_ = 0;
+  uint64_t conflated_count_ = 0;
+  uint64_t logged_update_count_ = 0;
+};
+
+#endif  // PRICE_STREAM_SERVER_H_
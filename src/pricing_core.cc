@@ -0,0 +1,419 @@
+#include "pricing_core.h"
+
+#include <algorithm>
+#include <cmath>
+#include "common/symbol_helper.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Max moving average window, same as history size of |Symbol|.
+const int32_t kMaxWindow = 600;
+// One more item to keep the sample which is leaving the window.
+const int32_t kHistorySize = kMaxWindow + 1;
+
+} // namespace
+
+PricingCore::PricingCore() {
+}
+
+PricingCore::~PricingCore() {
+}
+
+size_t PricingCore::AddSymbol(const std::string& symbol_name,
+                              const FairValueConfig& config) {
+  size_t index = symbol_names_.size();
+  symbol_names_.push_back(symbol_name);
+
+  method_.push_back(0);
+  fixed_price_.push_back(0.0);
+  leg1_.push_back(-1);
+  leg2_.push_back(-1);
+  skew_add_.push_back(0.0);
+  skew_multiplier_.push_back(1.0);
+  window_.push_back(0);
+
+  numerator_.push_back(0.0);
+  denominator_.push_back(0.0);
+
+  history_.resize(history_.size() + kHistorySize, 0.0);
+  history_position_.push_back(0);
+  history_count_.push_back(0);
+  shift_.push_back(0.0);
+  sum_.push_back(0.0);
+  square_sum_.push_back(0.0);
+  sample_count_.push_back(0);
+
+  fair_value_.push_back(0.0);
+  moving_average_.push_back(0.0);
+  standard_deviation_ratio_.push_back(0.0);
+
+  UpdateConfig(index, config);
+  return index;
+}
+
+void PricingCore::RemoveSymbol(size_t index) {
+  size_t last = symbol_names_.size() - 1;
+  if (index != last) {
+    symbol_names_[index] = symbol_names_[last];
+    method_[index] = method_[last];
+    fixed_price_[index] = fixed_price_[last];
+    leg1_[index] = leg1_[last];
+    leg2_[index] = leg2_[last];
+    skew_add_[index] = skew_add_[last];
+    skew_multiplier_[index] = skew_multiplier_[last];
+    window_[index] = window_[last];
+    std::copy(history_.begin() + last * kHistorySize,
+              history_.begin() + (last + 1) * kHistorySize,
+              history_.begin() + index * kHistorySize);
+    history_position_[index] = history_position_[last];
+    history_count_[index] = history_count_[last];
+    shift_[index] = shift_[last];
+    sum_[index] = sum_[last];
+    square_sum_[index] = square_sum_[last];
+    sample_count_[index] = sample_count_[last];
+  }
+
+  symbol_names_.pop_back();
+  method_.pop_back();
+  fixed_price_.pop_back();
+  leg1_.pop_back();
+  leg2_.pop_back();
+  skew_add_.pop_back();
+  skew_multiplier_.pop_back();
+  window_.pop_back();
+  numerator_.pop_back();
+  denominator_.pop_back();
+  history_.resize(history_.size() - kHistorySize);
+  history_position_.pop_back();
+  history_count_.pop_back();
+  shift_.pop_back();
+  sum_.pop_back();
+  square_sum_.pop_back();
+  sample_count_.pop_back();
+  fair_value_.pop_back();
+  moving_average_.pop_back();
+  standard_deviation_ratio_.pop_back();
+
+  RemoveUnusedLegs();
+}
+
+void PricingCore::Clear() {
+  *this = PricingCore();
+}
+
+void PricingCore::UpdateConfig(size_t index, const FairValueConfig& config) {
+  method_[index] = config.calculate_method;
+  fixed_price_[index] = config.fixed_price;
+
+  bool had_legs = leg1_[index] >= 0;
+  leg1_[index] = -1;
+  leg2_[index] = -1;
+  if (config.calculate_method == BASED_ON_A_CURRENCY) {
+    const std::string& symbol_name = symbol_names_[index];
+    leg1_[index] = GetOrAddLeg(common::GetCodeFromSymbol(symbol_name, 1)
+                               + config.base_currency);
+    leg2_[index] = GetOrAddLeg(common::GetCodeFromSymbol(symbol_name, 2)
+                               + config.base_currency);
+  }
+  if (had_legs)
+    RemoveUnusedLegs();
+
+  skew_add_[index] = 0.0;
+  skew_multiplier_[index] = 1.0;
+  if (config.skew_active) {
+    if (config.skew_type == 1)
+      skew_add_[index] = config.skew_value;
+    else if (config.skew_type == 2)
+      skew_multiplier_[index] = config.skew_percent / 100;
+  }
+
+  int32_t window = std::max(0, std::min(config.moving_average, kMaxWindow));
+  if (window != window_[index]) {
+    window_[index] = window;
+    ResetSums(index);
+  }
+}
+
+std::vector<double> PricingCore::GetHistory(size_t index) const {
+  std::vector<double> values(history_count_[index]);
+  const double* history = &history_[index * kHistorySize];
+  int32_t position = history_position_[index];
+  for (int32_t k = 1; k <= history_count_[index]; k++)
+    values[k - 1] = history[(position + kHistorySize - k) % kHistorySize];
+  return values;
+}
+
+void PricingCore::LoadHistory(size_t index,
+                              const std::vector<double>& values) {
+  int32_t count =
+      std::min(static_cast<int32_t>(values.size()), kHistorySize);
+  double* history = &history_[index * kHistorySize];
+  // Oldest sample first, as if they were added one by one.
+  for (int32_t k = 0; k < count; k++)
+    history[k] = values[count - 1 - k];
+  history_position_[index] = count % kHistorySize;
+  history_count_[index] = count;
+  shift_[index] = count > 0 ? history[0] : 0.0;
+  ResetSums(index);
+}
+
+int32_t PricingCore::GetOrAddLeg(const std::string& leg_name) {
+  auto it = leg_indexes_.find(leg_name);
+  if (it != leg_indexes_.end())
+    return it->second;
+
+  int32_t leg = leg_names_.size();
+  leg_names_.push_back(leg_name);
+  leg_indexes_[leg_name] = leg;
+  leg_prices_.push_back(0.0);
+  return leg;
+}
+
+void PricingCore::RemoveUnusedLegs() {
+  std::vector<int32_t> new_indexes(leg_names_.size(), -1);
+  for (size_t i = 0; i < symbol_names_.size(); i++) {
+    if (leg1_[i] >= 0)
+      new_indexes[leg1_[i]] = 0;
+    if (leg2_[i] >= 0)
+      new_indexes[leg2_[i]] = 0;
+  }
+
+  if (std::find(new_indexes.begin(), new_indexes.end(), -1) ==
+      new_indexes.end())
+    return;
+
+  // Compact legs, then update references of symbols.
+  std::vector<std::string> leg_names;
+  std::vector<double> leg_prices;
+  leg_indexes_.clear();
+  for (size_t leg = 0; leg < leg_names_.size(); leg++) {
+    if (new_indexes[leg] < 0)
+      continue;
+
+    new_indexes[leg] = leg_names.size();
+    leg_indexes_[leg_names_[leg]] = new_indexes[leg];
+    leg_names.push_back(leg_names_[leg]);
+    leg_prices.push_back(leg_prices_[leg]);
+  }
+  leg_names_.swap(leg_names);
+  leg_prices_.swap(leg_prices);
+
+  for (size_t i = 0; i < symbol_names_.size(); i++) {
+    if (leg1_[i] >= 0)
+      leg1_[i] = new_indexes[leg1_[i]];
+    if (leg2_[i] >= 0)
+      leg2_[i] = new_indexes[leg2_[i]];
+  }
+}
+
+void PricingCore::Calculate() {
+  GatherInputs();
+  ApplySkewScalar(ApplySkewSimd());
+  UpdateHistory();
+  CalculateStatisticsScalar(CalculateStatisticsSimd());
+}
+
+void PricingCore::CalculateScalar() {
+  GatherInputs();
+  ApplySkewScalar(0);
+  UpdateHistory();
+  CalculateStatisticsScalar(0);
+}
+
+void PricingCore::GatherInputs() {
+  // Denominator is 0 if fair value cannot be calculated.
+  size_t n = symbol_names_.size();
+  for (size_t i = 0; i < n; i++) {
+    switch (method_[i]) {
+    case FIXED_PRICE:
+      numerator_[i] = fixed_price_[i];
+      denominator_[i] = 1.0;
+      break;
+    case BASED_ON_A_CURRENCY:
+      numerator_[i] = leg_prices_[leg1_[i]];
+      denominator_[i] = numerator_[i] == 0.0 ? 0.0 : leg_prices_[leg2_[i]];
+      break;
+    default:
+      numerator_[i] = 0.0;
+      denominator_[i] = 0.0;
+      break;
+    }
+  }
+}
+
+size_t PricingCore::ApplySkewSimd() {
+  size_t n = symbol_names_.size();
+  size_t i = 0;
+#if defined(__AVX__)
+  const __m256d zero = _mm256_setzero_pd();
+  for (; i + 4 <= n; i += 4) {
+    __m256d numerator = _mm256_loadu_pd(&numerator_[i]);
+    __m256d denominator = _mm256_loadu_pd(&denominator_[i]);
+    __m256d valid = _mm256_cmp_pd(denominator, zero, _CMP_NEQ_OQ);
+    __m256d fair_value = _mm256_div_pd(numerator, denominator);
+    fair_value = _mm256_add_pd(fair_value, _mm256_loadu_pd(&skew_add_[i]));
+    fair_value =
+        _mm256_mul_pd(fair_value, _mm256_loadu_pd(&skew_multiplier_[i]));
+    _mm256_storeu_pd(&fair_value_[i], _mm256_and_pd(fair_value, valid));
+  }
+#elif defined(__SSE2__)
+  const __m128d zero = _mm_setzero_pd();
+  for (; i + 2 <= n; i += 2) {
+    __m128d numerator = _mm_loadu_pd(&numerator_[i]);
+    __m128d denominator = _mm_loadu_pd(&denominator_[i]);
+    __m128d valid = _mm_cmpneq_pd(denominator, zero);
+    __m128d fair_value = _mm_div_pd(numerator, denominator);
+    fair_value = _mm_add_pd(fair_value, _mm_loadu_pd(&skew_add_[i]));
+    fair_value = _mm_mul_pd(fair_value, _mm_loadu_pd(&skew_multiplier_[i]));
+    _mm_storeu_pd(&fair_value_[i], _mm_and_pd(fair_value, valid));
+  }
+#endif
+  return i;
+}
+
+void PricingCore::ApplySkewScalar(size_t begin) {
+  size_t n = symbol_names_.size();
+  for (size_t i = begin; i < n; i++) {
+    fair_value_[i] =
+        denominator_[i] == 0.0
+        ? 0.0
+        : (numerator_[i] / denominator_[i] + skew_add_[i]) *
+          skew_multiplier_[i];
+  }
+}
+
+void PricingCore::UpdateHistory() {
+  size_t n = symbol_names_.size();
+  for (size_t i = 0; i < n; i++) {
+    double fair_value = fair_value_[i];
+    if (fair_value <= 0)
+      continue;
+
+    double* history = &history_[i * kHistorySize];
+    if (history_count_[i] == 0)
+      shift_[i] = fair_value;
+
+    int32_t position = history_position_[i];
+    history[position] = fair_value;
+    history_position_[i] = (position + 1 == kHistorySize) ? 0 : position + 1;
+    if (history_count_[i] < kHistorySize)
+      history_count_[i]++;
+
+    if (window_[i] == 0)
+      continue;
+
+    double x = fair_value - shift_[i];
+    sum_[i] += x;
+    square_sum_[i] += x * x;
+    sample_count_[i]++;
+
+    // Remove the sample which is leaving the window.
+    if (sample_count_[i] > window_[i]) {
+      int32_t old_position = position - window_[i];
+      if (old_position < 0)
+        old_position += kHistorySize;
+      double old = history[old_position] - shift_[i];
+      sum_[i] -= old;
+      square_sum_[i] -= old * old;
+      sample_count_[i]--;
+    }
+  }
+}
+
+void PricingCore::ResetSums(size_t index) {
+  sum_[index] = 0.0;
+  square_sum_[index] = 0.0;
+  sample_count_[index] = std::min(history_count_[index], window_[index]);
+
+  const double* history = &history_[index * kHistorySize];
+  int32_t position = history_position_[index];
+  for (int32_t k = 1; k <= sample_count_[index]; k++) {
+    double x = history[(position + kHistorySize - k) % kHistorySize] -
+               shift_[index];
+    sum_[index] += x;
+    square_sum_[index] += x * x;
+  }
+}
+
+size_t PricingCore::CalculateStatisticsSimd() {
+  size_t n = symbol_names_.size();
+  size_t i = 0;
+#if defined(__AVX__)
+  const __m256d zero = _mm256_setzero_pd();
+  const __m256d one = _mm256_set1_pd(1.0);
+  const __m256d hundred = _mm256_set1_pd(100.0);
+  for (; i + 4 <= n; i += 4) {
+    __m256d count = _mm256_cvtepi32_pd(_mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(&sample_count_[i])));
+    __m256d has_sample = _mm256_cmp_pd(count, zero, _CMP_GT_OQ);
+    count = _mm256_max_pd(count, one);
+
+    __m256d mean = _mm256_div_pd(_mm256_loadu_pd(&sum_[i]), count);
+    __m256d variance = _mm256_sub_pd(
+        _mm256_div_pd(_mm256_loadu_pd(&square_sum_[i]), count),
+        _mm256_mul_pd(mean, mean));
+    __m256d deviation = _mm256_sqrt_pd(_mm256_max_pd(variance, zero));
+    __m256d moving_average = _mm256_add_pd(mean, _mm256_loadu_pd(&shift_[i]));
+
+    __m256d has_ratio = _mm256_and_pd(
+        has_sample, _mm256_cmp_pd(moving_average, one, _CMP_GT_OQ));
+    __m256d ratio = _mm256_div_pd(_mm256_mul_pd(deviation, hundred),
+                                  _mm256_max_pd(moving_average, one));
+
+    _mm256_storeu_pd(&moving_average_[i],
+                     _mm256_and_pd(moving_average, has_sample));
+    _mm256_storeu_pd(&standard_deviation_ratio_[i],
+                     _mm256_and_pd(ratio, has_ratio));
+  }
+#elif defined(__SSE2__)
+  const __m128d zero = _mm_setzero_pd();
+  const __m128d one = _mm_set1_pd(1.0);
+  const __m128d hundred = _mm_set1_pd(100.0);
+  for (; i + 2 <= n; i += 2) {
+    __m128d count = _mm_cvtepi32_pd(_mm_loadl_epi64(
+        reinterpret_cast<const __m128i*>(&sample_count_[i])));
+    __m128d has_sample = _mm_cmpgt_pd(count, zero);
+    count = _mm_max_pd(count, one);
+
+    __m128d mean = _mm_div_pd(_mm_loadu_pd(&sum_[i]), count);
+    __m128d variance = _mm_sub_pd(
+        _mm_div_pd(_mm_loadu_pd(&square_sum_[i]), count),
+        _mm_mul_pd(mean, mean));
+    __m128d deviation = _mm_sqrt_pd(_mm_max_pd(variance, zero));
+    __m128d moving_average = _mm_add_pd(mean, _mm_loadu_pd(&shift_[i]));
+
+    __m128d has_ratio =
+        _mm_and_pd(has_sample, _mm_cmpgt_pd(moving_average, one));
+    __m128d ratio = _mm_div_pd(_mm_mul_pd(deviation, hundred),
+                               _mm_max_pd(moving_average, one));
+
+    _mm_storeu_pd(&moving_average_[i], _mm_and_pd(moving_average, has_sample));
+    _mm_storeu_pd(&standard_deviation_ratio_[i], _mm_and_pd(ratio, has_ratio));
+  }
+#endif
+  return i;
+}
+
+void PricingCore::CalculateStatisticsScalar(size_t begin) {
+  size_t n = symbol_names_.size();
+  for (size_t i = begin; i < n; i++) {
+    if (sample_count_[i] == 0) {
+      moving_average_[i] = 0.0;
+      standard_deviation_ratio_[i] = 0.0;
+      continue;
+    }
+
+    double mean = sum_[i] / sample_count_[i];
+    double variance = square_sum_[i] / sample_count_[i] - mean * mean;
+    double deviation = std::sqrt(std::max(variance, 0.0));
+    moving_average_[i] = mean + shift_[i];
+    standard_deviation_ratio_[i] =
+        moving_average_[i] > 1 ? deviation * 100 / moving_average_[i] : 0.0;
+  }
+}
@@ -0,0 +1,127 @@
+#ifndef PRICING_CORE_H_
+#define PRICING_CORE_H_
+
+#include <map>
+#include <string>
+#include <vector>
+#include "symbol.h"
+
+// Alternative to calculating fair value symbol by symbol: numeric state of
+// all symbols in a group is kept in contiguous arrays (structure of arrays),
+// so fair value, skew and statistics of the whole group are calculated in a
+// few passes, with SIMD (SSE2/AVX) when available.
+//
+// Fair values of |BASED_ON_A_CURRENCY| symbols are calculated from legs
+// (ex: ethbtc = ethjpy / btcjpy). Legs are shared between symbols, so each
+// leg price is read once per loop.
+class PricingCore {
+public:
+  PricingCore();
+  virtual ~PricingCore();
+
+  // Add symbol, return its index (row).
+  size_t AddSymbol(const std::string& symbol_name,
+                   const FairValueConfig& config);
+  // Remove symbol at |index|, last symbol is moved to |index|.
+  // Legs which are not referred anymore are removed too.
+  void RemoveSymbol(size_t index);
+  // Remove all symbols (and legs).
+  void Clear();
+  void UpdateConfig(size_t index, const FairValueConfig& config);
+
+  size_t GetSymbolNumber() const { return symbol_names_.size(); }
+  const std::string& GetSymbolName(size_t index) const {
+    return symbol_names_[index];
+  }
+
+  // Legs which are referred by symbols. Price must be set before each
+  // |Calculate()|, 0 if price is not available.
+  size_t GetLegNumber() const { return leg_names_.size(); }
+  const std::string& GetLegName(size_t leg) const { return leg_names_[leg]; }
+  void SetLegPrice(size_t leg, double price) { leg_prices_[leg] = price; }
+  // Legs of symbol at |index| (fair value = first / second), -1 if not used.
+  int32_t GetFirstLeg(size_t index) const { return leg1_[index]; }
+  int32_t GetSecondLeg(size_t index) const { return leg2_[index]; }
+
+  // Calculate fair value, moving average and standard deviation ratio of all
+  // symbols. |CalculateScalar()| does the same without SIMD (used as
+  // reference and for benchmark).
+  void Calculate();
+  void CalculateScalar();
+
+  // Results of last calculation. Fair value is 0 if it cannot be calculated.
+  double GetFairValue(size_t index) const { return fair_value_[index]; }
+  double GetMovingAverage(size_t index) const {
+    return moving_average_[index];
+  }
+  double GetStandardDeviationRatio(size_t index) const {
+    return standard_deviation_ratio_[index];
+  }
+
+  // History of fair values of symbol at |index|, newest first. Used to save
+  // state of symbol and to restore it (by |LoadHistory()|) in another
+  // process.
+  std::vector<double> GetHistory(size_t index) const;
+  void LoadHistory(size_t index, const std::vector<double>& values);
+
+private:
+  // Get index of leg |leg_name|, add it if necessary.
+  int32_t GetOrAddLeg(const std::string& leg_name);
+  // Remove legs which are not referred by any symbol.
+  void RemoveUnusedLegs();
+
+  // Read legs into numerator/denominator of each symbol.
+  void GatherInputs();
+  // Append fair values into history and update running sums.
+  void UpdateHistory();
+  // Recalculate running sums of a symbol (after window is changed).
+  void ResetSums(size_t index);
+
+  // SIMD kernels, |end| is number of symbols processed by SIMD (multiple of
+  // vector width), the rest is processed by scalar code.
+  size_t ApplySkewSimd();
+  size_t CalculateStatisticsSimd();
+  void ApplySkewScalar(size_t begin);
+  void CalculateStatisticsScalar(size_t begin);
+
+  std::vector<std::string> symbol_names_;
+
+  // Settings (one item per symbol).
+  std::vector<int32_t> method_;
+  std::vector<double> fixed_price_;
+  // Legs of |BASED_ON_A_CURRENCY| symbols, -1 if not used.
+  std::vector<int32_t> leg1_;
+  std::vector<int32_t> leg2_;
+  // Skew is normalized to fair_value = (raw + skew_add) * skew_multiplier.
+  std::vector<double> skew_add_;
+  std::vector<double> skew_multiplier_;
+  // Moving average window (number of samples).
+  std::vector<int32_t> window_;
+
+  // Legs.
+  std::vector<std::string> leg_names_;
+  std::map<std::string, int32_t> leg_indexes_;
+  std::vector<double> leg_prices_;
+
+  // Inputs of current loop: raw fair value = numerator / denominator.
+  std::vector<double> numerator_;
+  std::vector<double> denominator_;
+
+  // History of fair values, |kHistorySize| items per symbol.
+  std::vector<double> history_;
+  std::vector<int32_t> history_position_;
+  std::vector<int32_t> history_count_;
+  // Running sums of last |window_| samples. Samples are shifted by first
+  // fair value of symbol to avoid losing precision with big prices.
+  std::vector<double> shift_;
+  std::vector<double> sum_;
+  std::vector<double> square_sum_;
+  std::vector<int32_t> sample_count_;
+
+  // Outputs.
+  std::vector<double> fair_value_;
+  std::vector<double> moving_average_;
+  std::vector<double> standard_deviation_ratio_;
+};
+
+#endif  // PRICING_CORE_H_
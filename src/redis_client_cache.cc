@@ -0,0 +1,420 @@
+#include "redis_client_cache.h"
+
+#include <poll.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include "common/thread_helper.h"
+#include "glog/logging.h"
+
+namespace redis {
+namespace client {
+
+namespace {
+
+// Channel of invalidation messages (RESP2 tracking redirection).
+const char kInvalidationChannel[] = "__redis__:invalidate";
+// Interval to try again after invalidation connection failed.
+// (milliseconds)
+const int kReconnectInterval = 1000;
+// Max time to wait for invalidations, stop flag is checked after it.
+// (milliseconds)
+const int kPollTimeout = 1000;
+// Cache is cleared when it has this many keys (only if prefixes match far
+// more keys than expected).
+const size_t kMaxEntryNumber = 65536;
+// Interval to log counters. (seconds)
+const int kCounterLogInterval = 60;
+
+std::string GetAddress(const RedisServerInformation& server) {
+  return server.unix_socket.empty()
+      ? server.host + ":" + std::to_string(server.port)
+      : "unix:" + server.unix_socket;
+}
+
+// Reply which is allocated like hiredis does, so it is freed by
+// freeReplyObject().
+redisReply* CreateReply(bool nil, const std::string& value) {
+  redisReply* reply = static_cast<redisReply*>(calloc(1, sizeof(redisReply)));
+  if (reply == nullptr)
+    return nullptr;
+  if (nil) {
+    reply->type = REDIS_REPLY_NIL;
+    return reply;
+  }
+
+  reply->str = static_cast<char*>(malloc(value.size() + 1));
+  if (reply->str == nullptr) {
+    free(reply);
+    return nullptr;
+  }
+  memcpy(reply->str, value.data(), value.size());
+  reply->str[value.size()] = '\0';
+  reply->len = value.size();
+  reply->type = REDIS_REPLY_STRING;
+  return reply;
+}
+
+// Connect and authenticate (if there is password). Return nullptr if failed.
+redisContext* ConnectServer(const RedisServerInformation& server) {
+  redisContext* redis_context = CreateRedisClient(server);
+  if (redis_context != nullptr && !server.password.empty() &&
+      !Authenticate(redis_context, server.password)) {
+    redisFree(redis_context);
+    return nullptr;
+  }
+  return redis_context;
+}
+
+std::mutex cache_mutex;
+// Address of server -> cache.
+std::map<std::string, std::unique_ptr<ClientCache>> caches;
+
+} // namespace
+
+ClientCache::ClientCache(const RedisServerInformation& server)
+    : server_(server),
+      stop_(false),
+      client_id_(0),
+      disabled_(false),
+      hit_count_(0),
+      miss_count_(0),
+      invalidation_count_(0),
+      flush_count_(0) {
+  thread_ = std::thread(&ClientCache::Run, this);
+}
+
+ClientCache::~ClientCache() {
+  {
+    std::lock_guard<std::mutex> lock(stop_mutex_);
+    stop_ = true;
+  }
+  stop_condition_.notify_one();
+  thread_.join();
+}
+
+uint64_t ClientCache::Track(redisContext* redis_context,
+                            uint64_t& tracking_id) {
+  uint64_t client_id = client_id_;
+  if (client_id == 0 || disabled_)
+    return 0;
+  if (server_.client_cache == CLIENT_CACHE_BROADCAST ||
+      tracking_id == client_id)
+    return client_id;
+
+  // Invalidation connection was re-created, redirect to the new one.
+  if (tracking_id != 0)
+    Command(redis_context, "CLIENT TRACKING off");
+  Reply reply = Command(redis_context,
+                        "CLIENT TRACKING on REDIRECT %llu OPTIN",
+                        static_cast<unsigned long long>(client_id));
+  if (!reply)
+    return 0;
+  if (reply.IsError()) {
+    Disable(reply.String().ToString().c_str());
+    return 0;
+  }
+
+  tracking_id = client_id;
+  return client_id;
+}
+
+void ClientCache::Untrack(uint64_t tracking_id) {
+  if (tracking_id != 0 && tracking_id == client_id_) {
+    LOG(INFO) << "Tracking connection to " << GetAddress(server_)
+              << " is lost, flush client cache.";
+    Flush();
+  }
+}
+
+bool ClientCache::Lookup(common::StringView key, uint64_t client_id,
+                         Reply& reply, uint64_t& token) {
+  token = 0;
+  if (client_id == 0 || !IsCachedKey(key))
+    return false;
+
+  std::string name = key.ToString();
+  std::lock_guard<std::mutex> lock(mutex_);
+  // Invalidation connection was re-created after |Track()|.
+  if (client_id != client_id_)
+    return false;
+
+  auto it = entries_.find(name);
+  if (it != entries_.end() && it->second.filled) {
+    hit_count_++;
+    reply = Reply(CreateReply(it->second.nil, it->second.value));
+    return static_cast<bool>(reply);
+  }
+
+  miss_count_++;
+  if (it == entries_.end()) {
+    if (entries_.size() >= kMaxEntryNumber) {
+      LOG(WARNING) << "Client cache of " << GetAddress(server_) << " has "
+                   << entries_.size() << " keys, clear it.";
+      entries_.clear();
+      flush_count_++;
+    }
+    it = entries_.emplace(std::move(name), Entry()).first;
+  }
+  it->second.token = next_token_++;
+  it->second.filled = false;
+  token = it->second.token;
+  return false;
+}
+
+void ClientCache::Fill(common::StringView key, uint64_t token,
+                       const Reply& reply) {
+  if (token == 0)
+    return;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = entries_.find(key.ToString());
+  if (it == entries_.end() || it->second.token != token ||
+      it->second.filled)
+    return;
+  if (!reply.IsString() && !reply.IsNil()) {
+    entries_.erase(it);
+    return;
+  }
+
+  it->second.filled = true;
+  it->second.nil = reply.IsNil();
+  it->second.value = reply.String().ToString();
+}
+
+bool ClientCache::IsCachedKey(common::StringView key) const {
+  for (auto& prefix : server_.client_cache_prefixes) {
+    if (key.size() >= prefix.size() &&
+        memcmp(key.data(), prefix.data(), prefix.size()) == 0)
+      return true;
+  }
+  return false;
+}
+
+void ClientCache::Run() {
+  common::SetCurrentThreadName("redis-tracking");
+
+  auto last_log_time = std::chrono::steady_clock::now();
+  while (!stop_ && !disabled_) {
+    if (invalidation_context_ == nullptr && !Connect()) {
+      Disconnect();
+      std::unique_lock<std::mutex> lock(stop_mutex_);
+      stop_condition_.wait_for(lock,
+                               std::chrono::milliseconds(kReconnectInterval),
+                               [this]() { return stop_.load(); });
+      continue;
+    }
+
+    if (!ReadInvalidations()) {
+      LOG(ERROR) << "Invalidation connection to " << GetAddress(server_)
+                 << " is lost, flush client cache and reconnect.";
+      Disconnect();
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (now - last_log_time >= std::chrono::seconds(kCounterLogInterval)) {
+      last_log_time = now;
+      LogCounters();
+    }
+  }
+  Disconnect();
+}
+
+bool ClientCache::Connect() {
+  invalidation_context_ = ConnectServer(server_);
+  if (invalidation_context_ == nullptr)
+    return false;
+
+  Reply reply = Command(invalidation_context_, "CLIENT ID");
+  if (reply.IsError())
+    Disable(reply.String().ToString().c_str());
+  if (!reply.IsInteger())
+    return false;
+  uint64_t client_id = reply.Integer();
+
+  reply = Command(invalidation_context_, "SUBSCRIBE %s",
+                  kInvalidationChannel);
+  if (!reply.IsArray())
+    return false;
+
+  // In broadcast mode, an idle connection only keeps tracking of prefixes
+  // alive: CLIENT TRACKING on REDIRECT id BCAST PREFIX prefix ...
+  if (server_.client_cache == CLIENT_CACHE_BROADCAST) {
+    tracking_context_ = ConnectServer(server_);
+    if (tracking_context_ == nullptr)
+      return false;
+
+    std::string redirect = std::to_string(client_id);
+    std::vector<const char*> argv = {"CLIENT", "TRACKING", "on", "REDIRECT",
+                                     redirect.c_str(), "BCAST"};
+    for (auto& prefix : server_.client_cache_prefixes) {
+      argv.push_back("PREFIX");
+      argv.push_back(prefix.c_str());
+    }
+    reply = Reply(static_cast<redisReply*>(redisCommandArgv(
+        tracking_context_, argv.size(), argv.data(), nullptr)));
+    if (reply.IsError())
+      Disable(reply.String().ToString().c_str());
+    if (!reply.IsStatus())
+      return false;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    client_id_ = client_id;
+  }
+  LOG(INFO) << "Client cache of " << GetAddress(server_) << " is enabled ("
+            << (server_.client_cache == CLIENT_CACHE_BROADCAST
+                ? "broadcast" : "default")
+            << " mode), invalidations are read by client " << client_id
+            << ".";
+  return true;
+}
+
+void ClientCache::Disconnect() {
+  if (client_id_ != 0) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      client_id_ = 0;
+    }
+    Flush();
+  }
+
+  if (invalidation_context_ != nullptr) {
+    redisFree(invalidation_context_);
+    invalidation_context_ = nullptr;
+  }
+  if (tracking_context_ != nullptr) {
+    redisFree(tracking_context_);
+    tracking_context_ = nullptr;
+  }
+}
+
+bool ClientCache::ReadInvalidations() {
+  // Messages which are read already (with a previous reply) come first.
+  auto process = [this]() {
+    while (true) {
+      void* message = nullptr;
+      if (redisGetReplyFromReader(invalidation_context_, &message) !=
+          REDIS_OK)
+        return false;
+      if (message == nullptr)
+        return true;
+      Reply owner(static_cast<redisReply*>(message));
+      Invalidate(owner.get());
+    }
+  };
+  if (!process())
+    return false;
+
+  struct pollfd fds[2];
+  fds[0].fd = invalidation_context_->fd;
+  fds[0].events = POLLIN;
+  fds[0].revents = 0;
+  nfds_t fd_number = 1;
+  if (tracking_context_ != nullptr) {
+    fds[1].fd = tracking_context_->fd;
+    fds[1].events = POLLIN;
+    fds[1].revents = 0;
+    fd_number = 2;
+  }
+
+  int ready = poll(fds, fd_number, kPollTimeout);
+  if (ready < 0)
+    return errno == EINTR;
+  if (ready == 0)
+    return true;
+  // Tracking connection never receives anything, unless it is closed.
+  if (fd_number == 2 && fds[1].revents != 0)
+    return false;
+  if (fds[0].revents != 0 && redisBufferRead(invalidation_context_) !=
+      REDIS_OK)
+    return false;
+  return process();
+}
+
+void ClientCache::Invalidate(const redisReply* message) {
+  // Message: ["message", channel, keys], keys is nil after FLUSHALL.
+  ReplyView view(message);
+  if (view.Size() != 3 || view.Element(0).String() != "message")
+    return;
+
+  ReplyView keys = view.Element(2);
+  if (keys.IsNil()) {
+    Flush();
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (keys.IsString()) {
+    invalidation_count_++;
+    entries_.erase(keys.String().ToString());
+    return;
+  }
+  for (size_t i = 0; i < keys.Size(); i++) {
+    invalidation_count_++;
+    entries_.erase(keys.Element(i).String().ToString());
+  }
+}
+
+void ClientCache::Flush() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+  flush_count_++;
+}
+
+void ClientCache::Disable(const char* reason) {
+  LOG(ERROR) << "Client cache of " << GetAddress(server_)
+             << " is disabled, tracking is not supported: " << reason;
+  disabled_ = true;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    client_id_ = 0;
+  }
+  Flush();
+}
+
+void ClientCache::LogCounters() {
+  uint64_t hit_count = hit_count_;
+  uint64_t miss_count = miss_count_;
+  if (hit_count == logged_hit_count_ && miss_count == logged_miss_count_)
+    return;
+
+  size_t entry_number = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entry_number = entries_.size();
+  }
+  uint64_t hits = hit_count - logged_hit_count_;
+  uint64_t lookups = hits + miss_count - logged_miss_count_;
+  LOG(INFO) << "Client cache of " << GetAddress(server_) << ": " << hit_count
+            << " hits, " << miss_count << " misses ("
+            << (lookups > 0 ? hits * 100 / lookups : 0)
+            << "% hit recently), " << invalidation_count_
+            << " invalidations, " << flush_count_ << " flushes, "
+            << entry_number << " keys.";
+  logged_hit_count_ = hit_count;
+  logged_miss_count_ = miss_count;
+}
+
+ClientCache* GetClientCache(const RedisServerInformation& server) {
+  if (server.client_cache == CLIENT_CACHE_OFF)
+    return nullptr;
+  if (server.cluster) {
+    LOG_FIRST_N(WARNING, 1) << "Client cache is not supported on redis "
+                            << "cluster, it is not used.";
+    return nullptr;
+  }
+
+  std::lock_guard<std::mutex> lock(cache_mutex);
+  std::unique_ptr<ClientCache>& cache = caches[GetAddress(server)];
+  if (cache == nullptr)
+    cache.reset(new ClientCache(server));
+  return cache.get();
+}
+
+} // namespace client
+} // namespace redis
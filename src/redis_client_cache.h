@@ -0,0 +1,131 @@
+#ifndef REDIS_CLIENT_CACHE_H_
+#define REDIS_CLIENT_CACHE_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "common/string_view.h"
+#include "configuration.h"
+#include "redis_controller.h"
+
+namespace redis {
+namespace client {
+
+// In-process cache of GET replies of keys which start with one of
+// |client_cache_prefixes| of a redis server, kept valid by the server
+// ('CLIENT TRACKING', redis 6+). hiredis speaks RESP2 only, so invalidations
+// are not pushed on data connections: they are redirected to a connection
+// which subscribes '__redis__:invalidate', read by a background thread.
+//
+// Broadcast mode: tracking (with cached prefixes) is enabled by that thread
+// on its own connection, data connections do nothing. Default mode: each data
+// connection enables tracking in OPTIN mode, and a cached key is read right
+// after 'CLIENT CACHING yes', so server only remembers (and invalidates) keys
+// which are cached, not every key the connection reads.
+//
+// Cache is flushed whenever an invalidation could be lost (invalidation
+// connection is broken, or tracking data connection in default mode), and is
+// not used until invalidations are received again. Thread-safe.
+class ClientCache {
+public:
+  explicit ClientCache(const RedisServerInformation& server);
+  virtual ~ClientCache();
+
+  ClientCache(const ClientCache&) = delete;
+  ClientCache& operator=(const ClientCache&) = delete;
+
+  // Prepare data connection |redis_context| before cached reads: enable
+  // tracking on it if necessary (default mode). |tracking_id| is state of
+  // that connection, 0 when it is created. Return id of invalidation
+  // connection to pass to |Lookup()|, 0 if cache cannot be used now.
+  uint64_t Track(redisContext* redis_context, uint64_t& tracking_id);
+  // Data connection which had |tracking_id| is lost, so are its tracked keys.
+  void Untrack(uint64_t tracking_id);
+
+  // Return true and cached reply of |key| in |reply| if it is cached.
+  // Otherwise |token| is set (0 if |key| is not cached at all) and value
+  // read from redis must be given to |Fill()|; if |IsOptIn()|, it must be
+  // read right after 'CLIENT CACHING yes' when |token| is not 0.
+  bool Lookup(common::StringView key, uint64_t client_id, Reply& reply,
+              uint64_t& token);
+  // Cache |reply| of |key| if it is not invalidated since |Lookup()|.
+  void Fill(common::StringView key, uint64_t token, const Reply& reply);
+
+  // Keys are tracked only when they are asked to (default mode).
+  bool IsOptIn() const {
+    return server_.client_cache == CLIENT_CACHE_DEFAULT;
+  }
+
+  uint64_t GetHitCount() const { return hit_count_; }
+  uint64_t GetMissCount() const { return miss_count_; }
+  uint64_t GetInvalidationCount() const { return invalidation_count_; }
+  uint64_t GetFlushCount() const { return flush_count_; }
+
+private:
+  struct Entry {
+    // Set when value is requested from redis, entry is filled only if
+    // token is the same when value arrives (not invalidated meanwhile).
+    uint64_t token;
+    bool filled;
+    bool nil;
+    std::string value;
+  };
+
+  bool IsCachedKey(common::StringView key) const;
+
+  // Run on invalidation thread.
+  void Run();
+  // Connect invalidation connection (and tracking connection in broadcast
+  // mode). Return false if failed.
+  bool Connect();
+  void Disconnect();
+  // Read invalidations which arrived. Return false if connection is broken.
+  bool ReadInvalidations();
+  void Invalidate(const redisReply* message);
+  // Remove all entries.
+  void Flush();
+  // Stop using cache because server does not support tracking.
+  void Disable(const char* reason);
+  void LogCounters();
+
+  RedisServerInformation server_;
+  std::thread thread_;
+  std::atomic<bool> stop_;
+  std::mutex stop_mutex_;
+  std::condition_variable stop_condition_;
+
+  // Owned by invalidation thread.
+  redisContext* invalidation_context_ = nullptr;
+  redisContext* tracking_context_ = nullptr;
+
+  // Id of subscribed invalidation connection, 0 if not connected.
+  std::atomic<uint64_t> client_id_;
+  std::atomic<bool> disabled_;
+
+  // Protect |entries_|, |next_token_| and counters.
+  std::mutex mutex_;
+  std::unordered_map<std::string, Entry> entries_;
+  uint64_t next_token_ = 1;
+
+  std::atomic<uint64_t> hit_count_;
+  std::atomic<uint64_t> miss_count_;
+  std::atomic<uint64_t> invalidation_count_;
+  std::atomic<uint64_t> flush_count_;
+  uint64_t logged_hit_count_ = 0;
+  uint64_t logged_miss_count_ = 0;
+};
+
+// Get cache of |server|, which is created at first use and shared by all
+// threads. Return nullptr if client-side caching is off (or |server| is a
+// redis cluster).
+ClientCache* GetClientCache(const RedisServerInformation& server);
+
+} // namespace client
+} // namespace redis
+
+#endif  // REDIS_CLIENT_CACHE_H_
@@ -0,0 +1,424 @@
+#include "redis_cluster.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include "glog/logging.h"
+
+namespace redis {
+namespace cluster {
+
+namespace {
+
+// Max number of redirections (or reconnections) of a command.
+const int kMaxRedirectionNumber = 5;
+// Min interval between two discoveries of slots. (milliseconds)
+const int kSlotRefreshInterval = 100;
+// Interval to connect a node again after connecting failed. (milliseconds)
+const int kNodeRetryInterval = 1000;
+// Interval of logging redirection counters. (seconds)
+const int kCounterLogInterval = 60;
+
+// Table of CRC16-CCITT (XMODEM), polynomial 0x1021, as used by redis.
+const uint16_t* GetCrc16Table() {
+  static uint16_t table[256];
+  static bool initialized = [] {
+    for (int i = 0; i < 256; i++) {
+      uint16_t crc = static_cast<uint16_t>(i << 8);
+      for (int bit = 0; bit < 8; bit++)
+        crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+      table[i] = crc;
+    }
+    return true;
+  }();
+  (void) initialized;
+  return table;
+}
+
+uint16_t GetCrc16(const char* data, size_t size) {
+  const uint16_t* table = GetCrc16Table();
+  uint16_t crc = 0;
+  for (size_t i = 0; i < size; i++) {
+    uint8_t index = static_cast<uint8_t>((crc >> 8) ^ data[i]);
+    crc = static_cast<uint16_t>((crc << 8) ^ table[index]);
+  }
+  return crc;
+}
+
+// Error reply "MOVED <slot> <host>:<port>" or "ASK <slot> <host>:<port>".
+struct Redirection {
+  bool ask;
+  uint16_t slot;
+  std::string host;
+  int port;
+};
+
+bool ParseRedirection(const ReplyView& reply, Redirection& redirection) {
+  if (!reply.IsError())
+    return false;
+
+  std::string message = reply.String().ToString();
+  size_t slot_start = 0;
+  if (message.compare(0, 6, "MOVED ") == 0) {
+    redirection.ask = false;
+    slot_start = 6;
+  } else if (message.compare(0, 4, "ASK ") == 0) {
+    redirection.ask = true;
+    slot_start = 4;
+  } else {
+    return false;
+  }
+
+  // Host can be IPv6 address, port is after last ':'.
+  size_t address_start = message.find(' ', slot_start);
+  size_t port_start = message.rfind(':');
+  if (address_start == std::string::npos || port_start == std::string::npos ||
+      port_start < address_start)
+    return false;
+  redirection.slot = static_cast<uint16_t>(
+      std::atoi(message.c_str() + slot_start) % kSlotNumber);
+  redirection.host =
+      message.substr(address_start + 1, port_start - address_start - 1);
+  redirection.port = std::atoi(message.c_str() + port_start + 1);
+  return redirection.port > 0;
+}
+
+// Split "host:port" list into nodes.
+void ParseNodes(const std::vector<std::string>& addresses,
+                std::vector<std::pair<std::string, int>>& nodes) {
+  for (auto& address : addresses) {
+    size_t port_start = address.rfind(':');
+    if (port_start == std::string::npos) {
+      LOG(ERROR) << "Invalid redis cluster node: " << address;
+      continue;
+    }
+    nodes.emplace_back(address.substr(0, port_start),
+                       std::atoi(address.c_str() + port_start + 1));
+  }
+}
+
+} // namespace
+
+uint16_t GetKeySlot(common::StringView key) {
+  const char* data = key.data();
+  size_t size = key.size();
+  const char* open = static_cast<const char*>(memchr(data, '{', size));
+  if (open != nullptr) {
+    const char* tag = open + 1;
+    const char* close = static_cast<const char*>(
+        memchr(tag, '}', data + size - tag));
+    if (close != nullptr && close != tag) {
+      data = tag;
+      size = close - tag;
+    }
+  }
+  return GetCrc16(data, size) & (kSlotNumber - 1);
+}
+
+ClusterClient::ClusterClient(const RedisServerInformation& server)
+    : server_(server) {
+  // Nodes which slots are discovered from.
+  GetNode(server.host, server.port);
+  std::vector<std::pair<std::string, int>> nodes;
+  ParseNodes(server.cluster_nodes, nodes);
+  for (auto& node : nodes)
+    GetNode(node.first, node.second);
+}
+
+ClusterClient::~ClusterClient() {
+  for (size_t i = 0; i < nodes_.size(); i++)
+    CloseContext(i);
+}
+
+bool ClusterClient::Connect() {
+  if (!slots_known_ || refresh_needed_)
+    RefreshSlots();
+  return slots_known_;
+}
+
+Reply ClusterClient::Command(const std::vector<common::StringView>& args,
+                             common::StringView key) {
+  uint16_t slot = GetKeySlot(key);
+  int node = GetSlotNode(slot);
+  bool asking = false;
+  for (int i = 0; i < kMaxRedirectionNumber && node >= 0; i++) {
+    Reply reply = SendCommand(node, args, asking);
+    if (!reply) {
+      // Node may be failed, its slots are moved to a promoted replica.
+      refresh_needed_ = true;
+      node = GetSlotNode(slot);
+      asking = false;
+      // Slot is still served by a node which is down, fail fast.
+      if (node >= 0 && IsNodeDown(node))
+        break;
+      continue;
+    }
+
+    Redirection redirection;
+    if (!ParseRedirection(reply, redirection)) {
+      LogCounters();
+      return reply;
+    }
+
+    // ASK is for one command only (slot is being migrated), MOVED changes
+    // owner of slot (and probably of other slots).
+    node = GetNode(redirection.host, redirection.port);
+    asking = redirection.ask;
+    if (redirection.ask) {
+      ask_count_++;
+    } else {
+      moved_count_++;
+      slots_[redirection.slot] = node;
+      refresh_needed_ = true;
+    }
+  }
+
+  LOG(ERROR) << "Cannot perform command on redis cluster, key = " << key;
+  return Reply();
+}
+
+std::vector<Reply> ClusterClient::Pipeline(
+    const std::vector<std::vector<common::StringView>>& commands,
+    size_t key_index) {
+  std::vector<Reply> replies(commands.size());
+
+  // Commands of each node.
+  std::vector<std::vector<size_t>> node_commands;
+  for (size_t i = 0; i < commands.size(); i++) {
+    int node = GetSlotNode(GetKeySlot(commands[i][key_index]));
+    if (node < 0)
+      continue;
+    if (static_cast<size_t>(node) >= node_commands.size())
+      node_commands.resize(node + 1);
+    node_commands[node].push_back(i);
+  }
+
+  // Write pipelines to all nodes first, then read replies.
+  std::vector<redisContext*> contexts(node_commands.size(), nullptr);
+  std::vector<const char*> argv;
+  std::vector<size_t> argv_len;
+  for (size_t node = 0; node < node_commands.size(); node++) {
+    if (node_commands[node].empty())
+      continue;
+    redisContext* context = GetContext(node);
+    if (context == nullptr)
+      continue;
+
+    for (size_t i : node_commands[node]) {
+      argv.clear();
+      argv_len.clear();
+      for (auto& arg : commands[i]) {
+        argv.push_back(arg.data());
+        argv_len.push_back(arg.size());
+      }
+      redisAppendCommandArgv(context, argv.size(), argv.data(),
+                             argv_len.data());
+    }
+    int done = 0;
+    while (!done && redisBufferWrite(context, &done) == REDIS_OK) {}
+    contexts[node] = context;
+  }
+
+  for (size_t node = 0; node < contexts.size(); node++) {
+    if (contexts[node] == nullptr)
+      continue;
+    for (size_t i : node_commands[node]) {
+      redisReply* reply = nullptr;
+      if (redisGetReply(contexts[node], (void**) &reply) != REDIS_OK) {
+        CloseContext(node);
+        refresh_needed_ = true;
+        break;
+      }
+      replies[i] = Reply(reply);
+    }
+  }
+
+  // Commands which are redirected or lost are performed again one by one.
+  for (size_t i = 0; i < commands.size(); i++) {
+    Redirection redirection;
+    if (!replies[i] || ParseRedirection(replies[i], redirection))
+      replies[i] = Command(commands[i], commands[i][key_index]);
+  }
+  LogCounters();
+  return replies;
+}
+
+int ClusterClient::GetNode(const std::string& host, int port) {
+  for (size_t i = 0; i < nodes_.size(); i++) {
+    if (nodes_[i].host == host && nodes_[i].port == port)
+      return i;
+  }
+  nodes_.push_back(
+      Node{host, port, nullptr, std::chrono::steady_clock::time_point()});
+  return nodes_.size() - 1;
+}
+
+redisContext* ClusterClient::GetContext(int node) {
+  Node& current = nodes_[node];
+  if (current.context != nullptr) {
+    if (current.context->err == 0)
+      return current.context;
+
+    LOG(ERROR) << "Connection to redis cluster node " << current.host << ":"
+               << current.port << " is broken (" << current.context->errstr
+               << "), reconnect.";
+    CloseContext(node);
+  }
+  if (IsNodeDown(node))
+    return nullptr;
+
+  // Nodes are connected by TCP, with options of configured server.
+  RedisServerInformation server = server_;
+  server.host = current.host;
+  server.port = current.port;
+  server.unix_socket.clear();
+  redisContext* context = client::CreateRedisClient(server);
+  if (context != nullptr && !server.password.empty() &&
+      !client::Authenticate(context, server.password)) {
+    redisFree(context);
+    context = nullptr;
+  }
+  if (context == nullptr) {
+    LOG(ERROR) << "Redis cluster node " << current.host << ":"
+               << current.port << " is down, do not connect it for "
+               << kNodeRetryInterval << " ms.";
+    current.retry_time = std::chrono::steady_clock::now() +
+                         std::chrono::milliseconds(kNodeRetryInterval);
+    return nullptr;
+  }
+
+  current.context = context;
+  return context;
+}
+
+bool ClusterClient::IsNodeDown(int node) const {
+  return std::chrono::steady_clock::now() < nodes_[node].retry_time;
+}
+
+void ClusterClient::CloseContext(int node) {
+  if (nodes_[node].context != nullptr) {
+    redisFree(nodes_[node].context);
+    nodes_[node].context = nullptr;
+  }
+}
+
+int ClusterClient::GetSlotNode(uint16_t slot) {
+  if (!slots_known_ || refresh_needed_)
+    RefreshSlots();
+  if (!slots_known_)
+    return -1;
+  if (slots_[slot] < 0)
+    LOG(ERROR) << "Slot " << slot << " is not served by redis cluster.";
+  return slots_[slot];
+}
+
+bool ClusterClient::RefreshSlots() {
+  auto now = std::chrono::steady_clock::now();
+  if (refresh_count_ > 0 &&
+      now - last_refresh_time_ <
+          std::chrono::milliseconds(kSlotRefreshInterval))
+    return slots_known_;
+  last_refresh_time_ = now;
+  refresh_count_++;
+
+  // Nodes can be added while reading slots.
+  for (size_t node = 0; node < nodes_.size(); node++) {
+    if (ReadSlots(node)) {
+      refresh_needed_ = false;
+      return true;
+    }
+  }
+  LOG(ERROR) << "Cannot read slots of redis cluster, no node is reachable.";
+  return false;
+}
+
+bool ClusterClient::ReadSlots(int node) {
+  Reply reply = SendCommand(node, {"CLUSTER", "SLOTS"}, false);
+  if (!reply.IsArray() || reply.Size() == 0) {
+    if (reply) {
+      LOG(ERROR) << "Cannot read slots from redis cluster node "
+                 << nodes_[node].host << ":" << nodes_[node].port << ": "
+                 << reply.String();
+    }
+    return false;
+  }
+
+  // Each element: start slot, end slot, master [host, port, id], replicas.
+  std::vector<int> slots(kSlotNumber, -1);
+  for (size_t i = 0; i < reply.Size(); i++) {
+    ReplyView range = reply.Element(i);
+    if (range.Size() < 3 || range.Element(2).Size() < 2)
+      continue;
+    ReplyView master = range.Element(2);
+    std::string host = master.Element(0).String().ToString();
+    // Empty host is the node which replied.
+    if (host.empty())
+      host = nodes_[node].host;
+    int owner = GetNode(host, static_cast<int>(master.Element(1).Integer()));
+    long long start = std::max(range.Element(0).Integer(), 0LL);
+    long long end = std::min(range.Element(1).Integer(),
+                             static_cast<long long>(kSlotNumber - 1));
+    for (long long slot = start; slot <= end; slot++)
+      slots[slot] = owner;
+  }
+
+  slots_.swap(slots);
+  if (!slots_known_) {
+    LOG(INFO) << "Redis cluster: " << reply.Size() << " slot range(s), "
+              << nodes_.size() << " known node(s).";
+  }
+  slots_known_ = true;
+  return true;
+}
+
+Reply ClusterClient::SendCommand(int node,
+                                 const std::vector<common::StringView>& args,
+                                 bool asking) {
+  redisContext* context = GetContext(node);
+  if (context == nullptr)
+    return Reply();
+
+  std::vector<const char*> argv;
+  std::vector<size_t> argv_len;
+  argv.reserve(args.size());
+  argv_len.reserve(args.size());
+  for (auto& arg : args) {
+    argv.push_back(arg.data());
+    argv_len.push_back(arg.size());
+  }
+
+  // ASKING and command are pipelined.
+  if (asking)
+    redisAppendCommand(context, "ASKING");
+  redisAppendCommandArgv(context, argv.size(), argv.data(), argv_len.data());
+  redisReply* reply = nullptr;
+  if (asking) {
+    if (redisGetReply(context, (void**) &reply) != REDIS_OK) {
+      CloseContext(node);
+      return Reply();
+    }
+    freeReplyObject(reply);
+    reply = nullptr;
+  }
+  if (redisGetReply(context, (void**) &reply) != REDIS_OK) {
+    CloseContext(node);
+    return Reply();
+  }
+  return Reply(reply);
+}
+
+void ClusterClient::LogCounters() {
+  auto now = std::chrono::steady_clock::now();
+  if (refresh_count_ == logged_refresh_count_ ||
+      now - last_log_time_ < std::chrono::seconds(kCounterLogInterval))
+    return;
+  last_log_time_ = now;
+  logged_refresh_count_ = refresh_count_;
+
+  LOG(INFO) << "Redis cluster: " << nodes_.size() << " node(s), "
+            << "moved = " << moved_count_ << ", ask = " << ask_count_
+            << ", slot refreshes = " << refresh_count_;
+}
+
+} // namespace cluster
+} // namespace redis
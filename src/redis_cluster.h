@@ -0,0 +1,106 @@
+#ifndef REDIS_CLUSTER_H_
+#define REDIS_CLUSTER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "common/string_view.h"
+#include "configuration.h"
+#include "redis_controller.h"
+
+namespace redis {
+namespace cluster {
+
+// Number of hash slots of redis cluster.
+const int kSlotNumber = 16384;
+
+// Hash slot of |key|: CRC16 of key (or of its hash tag, the part between
+// first '{' and next '}' if it is not empty) modulo |kSlotNumber|. Keys with
+// the same hash tag are in the same slot.
+uint16_t GetKeySlot(common::StringView key);
+
+// Synchronous client of a redis cluster. Slot owners are discovered by
+// 'CLUSTER SLOTS' (from |server| or any known node), each node has its own
+// connection, created at first use. Commands are sent to node which serves
+// their key, MOVED/ASK redirections are followed (slots are discovered again
+// after MOVED). A node which cannot be connected is not connected again for
+// a while, its commands fail fast meanwhile (not one connect per key when a
+// node is down before failover). Not thread-safe, used through thread-local pool (see
+// |redis::client::GetThreadClient()| and |redis::client::Client|).
+class ClusterClient {
+public:
+  explicit ClusterClient(const RedisServerInformation& server);
+  virtual ~ClusterClient();
+
+  ClusterClient(const ClusterClient&) = delete;
+  ClusterClient& operator=(const ClusterClient&) = delete;
+
+  // Discover slots if they are not known yet (or must be refreshed). Return
+  // false if no node is reachable.
+  bool Connect();
+
+  // Perform command |args| on node which serves |key|, follow redirections.
+  Reply Command(const std::vector<common::StringView>& args,
+                common::StringView key);
+  // Perform all |commands|, key of each command is its argument
+  // |key_index|. Commands are split by node into pipelines, which are sent
+  // to all nodes before replies are read, so nodes process them in parallel.
+  // Replies are in order of |commands|.
+  std::vector<Reply> Pipeline(
+      const std::vector<std::vector<common::StringView>>& commands,
+      size_t key_index);
+
+private:
+  struct Node {
+    std::string host;
+    int port;
+    redisContext* context;
+    // Connecting failed, it is not tried again before this time.
+    std::chrono::steady_clock::time_point retry_time;
+  };
+
+  // Index of node |host|:|port|, it is added if not known.
+  int GetNode(const std::string& host, int port);
+  // Connection of |node|, it is re-created if it is broken. Return nullptr
+  // if cannot connect (or connecting failed recently).
+  redisContext* GetContext(int node);
+  bool IsNodeDown(int node) const;
+  void CloseContext(int node);
+  // Node which serves |slot|, refresh slots first if necessary. Return -1 if
+  // slots are not known.
+  int GetSlotNode(uint16_t slot);
+
+  // Read slots by 'CLUSTER SLOTS' from first node which replies. Not done
+  // more than once per |kSlotRefreshInterval|.
+  bool RefreshSlots();
+  bool ReadSlots(int node);
+
+  // Send |args| (after ASKING if |asking|) to |node|, return reply. Reply is
+  // empty if connection is broken.
+  Reply SendCommand(int node, const std::vector<common::StringView>& args,
+                    bool asking);
+  // Log counters periodically.
+  void LogCounters();
+
+  RedisServerInformation server_;
+  std::vector<Node> nodes_;
+  // Node of each slot, -1 if slot is not served.
+  std::vector<int> slots_;
+  bool slots_known_ = false;
+  // Set after MOVED or broken connection, slots are read again before next
+  // command.
+  bool refresh_needed_ = false;
+  std::chrono::steady_clock::time_point last_refresh_time_;
+  std::chrono::steady_clock::time_point last_log_time_;
+
+  uint64_t moved_count_ = 0;
+  uint64_t ask_count_ = 0;
+  uint64_t refresh_count_ = 0;
+  uint64_t logged_refresh_count_ = 0;
+};
+
+} // namespace cluster
+} // namespace redis
+
+#endif  // REDIS_CLUSTER_H_
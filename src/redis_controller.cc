@@ -1,70 +1,717 @@
 #include "redis_controller.h"
 
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <cstdarg>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <utility>
 #include "glog/logging.h"
+#include "hiredis/adapters/libevent.h"
+#include "redis_client_cache.h"
+#include "redis_cluster.h"
 
 namespace redis {
 
+namespace {
+
+struct timeval ToTimeval(int milliseconds) {
+  struct timeval tv;
+  tv.tv_sec = milliseconds / 1000;
+  tv.tv_usec = (milliseconds % 1000) * 1000;
+  return tv;
+}
+
+// Apply socket options of |server| to connection |c|.
+void SetSocketOptions(redisContext* c, const RedisServerInformation& server) {
+  if (server.send_buffer_size > 0) {
+    setsockopt(c->fd, SOL_SOCKET, SO_SNDBUF, &server.send_buffer_size,
+               sizeof(server.send_buffer_size));
+  }
+  if (server.receive_buffer_size > 0) {
+    setsockopt(c->fd, SOL_SOCKET, SO_RCVBUF, &server.receive_buffer_size,
+               sizeof(server.receive_buffer_size));
+  }
+  if (!server.unix_socket.empty())
+    return;
+
+  // hiredis enables TCP_NODELAY itself, it can only be disabled here.
+  int nodelay = server.tcp_nodelay ? 1 : 0;
+  setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+  if (server.keepalive)
+    redisEnableKeepAlive(c);
+}
+
+// Description of |server| for logging.
+std::string GetAddress(const RedisServerInformation& server) {
+  return server.unix_socket.empty()
+      ? server.host + ":" + std::to_string(server.port)
+      : "unix:" + server.unix_socket;
+}
+
+} // namespace
+
 namespace client {
 
-redisContext* CreateRedisClient(const std::string& host, int port) {
-  redisContext* redis_context = redisConnect(host.c_str(), port);
+namespace {
+
+// Key of connections to |server| in a pool. Connections with different
+// timeouts are not shared (ex: cluster coordinator uses short timeouts).
+std::string GetPoolKey(const RedisServerInformation& server) {
+  return GetAddress(server) + "/" + std::to_string(server.connect_timeout) +
+         "/" + std::to_string(server.command_timeout);
+}
+
+// Clients of a thread, closed when thread exits.
+class ThreadClientPool {
+public:
+  Client* Get(const RedisServerInformation& server) {
+    if (server.cluster)
+      return GetCluster(server);
+
+    std::string key = GetPoolKey(server);
+    auto it = clients_.find(key);
+    if (it != clients_.end()) {
+      if (it->second->GetContext()->err == 0)
+        return it->second.get();
+
+      LOG(ERROR) << "Connection to redis server is broken ("
+                 << it->second->GetContext()->errstr << "), reconnect.";
+      clients_.erase(it);
+    }
+
+    redisContext* redis_context = CreateRedisClient(server);
+    if (redis_context == nullptr)
+      return nullptr;
+    if (!Authenticate(redis_context, server.password)) {
+      redisFree(redis_context);
+      return nullptr;
+    }
+
+    std::unique_ptr<Client>& client = clients_[key];
+    client.reset(new Client(redis_context, GetClientCache(server)));
+    return client.get();
+  }
+
+private:
+  // Cluster client of |server|, nullptr if no node is reachable.
+  Client* GetCluster(const RedisServerInformation& server) {
+    std::unique_ptr<Client>& client = clusters_[GetPoolKey(server)];
+    if (client == nullptr) {
+      client.reset(new Client(std::unique_ptr<cluster::ClusterClient>(
+          new cluster::ClusterClient(server))));
+    }
+    return client->GetCluster()->Connect() ? client.get() : nullptr;
+  }
+
+  // Address (and timeouts) of server -> connection.
+  std::map<std::string, std::unique_ptr<Client>> clients_;
+  // Address (and timeouts) of first node -> cluster client.
+  std::map<std::string, std::unique_ptr<Client>> clusters_;
+};
+
+thread_local ThreadClientPool thread_client_pool;
+
+// Perform |args| on |redis_client|, on node which serves |key| if it is a
+// redis cluster.
+Reply CommandArgv(Client* redis_client,
+                  const std::vector<common::StringView>& args,
+                  common::StringView key) {
+  cluster::ClusterClient* cluster = redis_client->GetCluster();
+  if (cluster != nullptr)
+    return cluster->Command(args, key);
+
+  std::vector<const char*> argv;
+  std::vector<size_t> argv_len;
+  argv.reserve(args.size());
+  argv_len.reserve(args.size());
+  for (auto& arg : args) {
+    argv.push_back(arg.data());
+    argv_len.push_back(arg.size());
+  }
+  return Reply(static_cast<redisReply*>(redisCommandArgv(
+      redis_client->GetContext(), argv.size(), argv.data(),
+      argv_len.data())));
+}
+
+// Perform 'SCRIPT LOAD', on node which serves |key| in a redis cluster.
+bool LoadScript(Client* redis_client, Script& script,
+                common::StringView key) {
+  Reply reply = CommandArgv(redis_client, {"SCRIPT", "LOAD", script.source},
+                            key);
+  if (!reply) {
+    LOG(ERROR) << "Cannot load script, connection error.";
+    return false;
+  }
+  if (!reply.IsString()) {
+    LOG(ERROR) << "Cannot load script: " << reply.String();
+    return false;
+  }
+
+  script.sha = reply.String().ToString();
+  return true;
+}
+
+// Reply of 'GET |key|', error is logged if it is not a string.
+Reply GetValue(Reply reply, common::StringView key) {
+  if (!reply.IsString())
+    LOG(ERROR) << "Cannot get value of key = " << key;
+  return reply;
+}
+
+} // namespace
+
+Client::Client(redisContext* context, ClientCache* cache)
+    : context_(context), cache_(cache) {}
+
+Client::Client(std::unique_ptr<cluster::ClusterClient> cluster)
+    : cluster_(std::move(cluster)) {}
+
+Client::~Client() {
+  if (context_ == nullptr)
+    return;
+  // Keys tracked by a broken connection may have been changed unnoticed.
+  if (cache_ != nullptr && context_->err != 0)
+    cache_->Untrack(tracking_id_);
+  redisFree(context_);
+}
+
+ClientCache* Client::GetCache(uint64_t& client_id) {
+  if (cache_ == nullptr)
+    return nullptr;
+  client_id = cache_->Track(context_, tracking_id_);
+  return client_id != 0 ? cache_ : nullptr;
+}
+
+redisContext* CreateRedisClient(const RedisServerInformation& server) {
+  redisContext* redis_context = nullptr;
+  if (server.unix_socket.empty()) {
+    redis_context = server.connect_timeout > 0
+        ? redisConnectWithTimeout(server.host.c_str(), server.port,
+                                  ToTimeval(server.connect_timeout))
+        : redisConnect(server.host.c_str(), server.port);
+  } else {
+    redis_context = server.connect_timeout > 0
+        ? redisConnectUnixWithTimeout(server.unix_socket.c_str(),
+                                      ToTimeval(server.connect_timeout))
+        : redisConnectUnix(server.unix_socket.c_str());
+  }
   if (redis_context == nullptr || redis_context->err) {
-    LOG(ERROR) << "Cannot create redis client.";
+    LOG(ERROR) << "Cannot create redis client to " << GetAddress(server)
+               << (redis_context != nullptr ? ": " : "")
+               << (redis_context != nullptr ? redis_context->errstr : "");
+    if (redis_context != nullptr)
+      redisFree(redis_context);
     return nullptr;
   }
 
-  LOG(INFO) << "Create new redis client successfully.";
+  SetSocketOptions(redis_context, server);
+  // Socket may keep connect timeout (depends on hiredis version), so command
+  // timeout (or no timeout) is always set.
+  if (server.command_timeout > 0 || server.connect_timeout > 0)
+    redisSetTimeout(redis_context, ToTimeval(server.command_timeout));
+
+  LOG(INFO) << "Create new redis client to " << GetAddress(server)
+            << " successfully.";
   return redis_context;
 }
 
 bool Authenticate(redisContext* redis_context, const std::string& password) {
-  bool result = false;
-  redisReply* reply =
-      (redisReply*) redisCommand(redis_context, "AUTH %s", password.c_str());
-  if (reply->type == REDIS_REPLY_ERROR) {
+  Reply reply = Command(redis_context, "AUTH %b",
+                        password.data(), password.size());
+  if (!reply) {
+    LOG(ERROR) << "Authenticate failed, connection error.";
+    return false;
+  }
+  if (reply.IsError()) {
     LOG(ERROR) << "Authenticate failed!";
-    result = false;
-  } else {
-    LOG(INFO) << "Authenticate successfully.";
-    result = true;
+    return false;
   }
 
-  freeReplyObject(reply);
-  return result;
+  LOG(INFO) << "Authenticate successfully.";
+  return true;
 }
 
-std::string Get(redisContext* redis_context, const std::string& key) {
-  std::string result;
-  redisReply* reply =
-      (redisReply*) redisCommand(redis_context, "GET %s", key.c_str());
-  if (reply->type == REDIS_REPLY_ERROR ||
-      reply->type == REDIS_REPLY_NIL) {
-    LOG(ERROR) << "Cannot get value of key = " << key;
-  } else if (reply->type == REDIS_REPLY_STRING) {
-    result = std::string(reply->str);
+Client* GetThreadClient(const RedisServerInformation& server) {
+  return thread_client_pool.Get(server);
+}
+
+Reply Command(redisContext* redis_context, const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  void* reply = redisvCommand(redis_context, format, args);
+  va_end(args);
+  return Reply(static_cast<redisReply*>(reply));
+}
+
+Reply Get(Client* redis_client, common::StringView key) {
+  cluster::ClusterClient* cluster = redis_client->GetCluster();
+  if (cluster != nullptr)
+    return GetValue(cluster->Command({"GET", key}, key), key);
+
+  uint64_t client_id = 0;
+  uint64_t token = 0;
+  Reply reply;
+  ClientCache* cache = redis_client->GetCache(client_id);
+  if (cache != nullptr && cache->Lookup(key, client_id, reply, token))
+    return GetValue(std::move(reply), key);
+
+  redisContext* redis_context = redis_client->GetContext();
+  if (token == 0 || !cache->IsOptIn()) {
+    reply = Command(redis_context, "GET %b", key.data(), key.size());
+    if (cache != nullptr)
+      cache->Fill(key, token, reply);
+    return GetValue(std::move(reply), key);
+  }
+
+  // Only keys which are cached are tracked: CLIENT CACHING and GET are
+  // pipelined, tracking applies to the command right after it.
+  redisAppendCommand(redis_context, "CLIENT CACHING yes");
+  redisAppendCommand(redis_context, "GET %b", key.data(), key.size());
+  redisReply* caching = nullptr;
+  if (redisGetReply(redis_context, (void**) &caching) != REDIS_OK)
+    return GetValue(Reply(), key);
+  Reply caching_reply(caching);
+  redisReply* value = nullptr;
+  if (redisGetReply(redis_context, (void**) &value) != REDIS_OK)
+    return GetValue(Reply(), key);
+  reply = Reply(value);
+  // Key is not tracked, so it must not be cached.
+  if (caching_reply.IsStatus())
+    cache->Fill(key, token, reply);
+  return GetValue(std::move(reply), key);
+}
+
+void Set(Client* redis_client,
+         common::StringView key,
+         common::StringView value) {
+  cluster::ClusterClient* cluster = redis_client->GetCluster();
+  if (cluster != nullptr) {
+    cluster->Command({"SET", key, value}, key);
+    return;
   }
+  Command(redis_client->GetContext(), "SET %b %b",
+          key.data(), key.size(), value.data(), value.size());
+}
+
+bool ScriptLoad(Client* redis_client, Script& script) {
+  return LoadScript(redis_client, script, common::StringView());
+}
+
+bool SetNx(Client* redis_client,
+           const std::string& key,
+           const std::string& value,
+           uint64_t expire_milliseconds) {
+  std::string expire = std::to_string(expire_milliseconds);
+  Reply reply = CommandArgv(redis_client,
+                            {"SET", key, value, "NX", "PX", expire}, key);
+  if (!reply) {
+    LOG(ERROR) << "Cannot set key = " << key << ", connection error.";
+    return false;
+  }
+
+  // Reply is nil if key is existed.
+  return reply.IsStatus();
+}
 
-  freeReplyObject(reply);
+void SetMany(Client* redis_client,
+             const std::vector<std::string>& keys,
+             const std::vector<std::string>& values,
+             uint64_t expire_milliseconds) {
+  std::string expire = std::to_string(expire_milliseconds);
+  cluster::ClusterClient* cluster = redis_client->GetCluster();
+  if (cluster != nullptr) {
+    std::vector<std::vector<common::StringView>> commands(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+      commands[i] = {"SET", keys[i], values[i]};
+      if (expire_milliseconds > 0) {
+        commands[i].push_back("PX");
+        commands[i].push_back(expire);
+      }
+    }
+    std::vector<Reply> replies = cluster->Pipeline(commands, 1);
+    for (size_t i = 0; i < keys.size(); i++) {
+      if (!replies[i] || replies[i].IsError())
+        LOG(ERROR) << "Cannot set key = " << keys[i] << ": "
+                   << replies[i].String();
+    }
+    return;
+  }
+
+  redisContext* redis_context = redis_client->GetContext();
+  for (size_t i = 0; i < keys.size(); i++) {
+    if (expire_milliseconds > 0) {
+      redisAppendCommand(redis_context, "SET %b %b PX %s",
+                         keys[i].data(), keys[i].size(),
+                         values[i].data(), values[i].size(),
+                         expire.c_str());
+    } else {
+      redisAppendCommand(redis_context, "SET %b %b",
+                         keys[i].data(), keys[i].size(),
+                         values[i].data(), values[i].size());
+    }
+  }
+
+  for (size_t i = 0; i < keys.size(); i++) {
+    redisReply* reply = nullptr;
+    if (redisGetReply(redis_context, (void**) &reply) != REDIS_OK) {
+      LOG(ERROR) << "Cannot set keys, connection error.";
+      return;
+    }
+    Reply owner(reply);
+    if (owner.IsError())
+      LOG(ERROR) << "Cannot set key = " << keys[i] << ": " << owner.String();
+  }
+}
+
+std::vector<std::string> MGet(Client* redis_client,
+                              const std::vector<std::string>& keys) {
+  std::vector<std::string> result;
+  if (keys.empty())
+    return result;
+
+  // Keys of different slots cannot be read by one MGET on a cluster, they
+  // are read by GET (pipelined to each node).
+  cluster::ClusterClient* cluster = redis_client->GetCluster();
+  if (cluster != nullptr) {
+    std::vector<std::vector<common::StringView>> commands(keys.size());
+    for (size_t i = 0; i < keys.size(); i++)
+      commands[i] = {"GET", keys[i]};
+    std::vector<Reply> replies = cluster->Pipeline(commands, 1);
+    result.resize(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+      if (!replies[i] || replies[i].IsError()) {
+        LOG(ERROR) << "Cannot get value of key = " << keys[i] << ": "
+                   << replies[i].String();
+        continue;
+      }
+      result[i] = replies[i].String().ToString();
+    }
+    return result;
+  }
+
+  std::vector<const char*> argv;
+  std::vector<size_t> argv_len;
+  argv.reserve(keys.size() + 1);
+  argv_len.reserve(keys.size() + 1);
+  argv.push_back("MGET");
+  argv_len.push_back(4);
+  for (auto& key : keys) {
+    argv.push_back(key.data());
+    argv_len.push_back(key.size());
+  }
+
+  Reply reply(static_cast<redisReply*>(redisCommandArgv(
+      redis_client->GetContext(), argv.size(), argv.data(),
+      argv_len.data())));
+  if (!reply) {
+    LOG(ERROR) << "Cannot get values, connection error.";
+    return result;
+  }
+  if (!reply.IsArray()) {
+    LOG(ERROR) << "Cannot get values: " << reply.String();
+    return result;
+  }
+
+  result.resize(reply.Size());
+  for (size_t i = 0; i < reply.Size(); i++)
+    result[i] = reply.Element(i).String().ToString();
   return result;
 }
 
-void Set(redisContext* redis_context,
-         const std::string& key,
-         const std::string& value) {
-  redisReply* reply =
-      (redisReply*) redisCommand(redis_context, "SET %s %s", key.c_str(), value.c_str());
-  freeReplyObject(reply);
+Reply HMGet(Client* redis_client,
+            common::StringView key,
+            const std::vector<common::StringView>& fields) {
+  std::vector<common::StringView> command;
+  command.reserve(fields.size() + 2);
+  command.push_back("HMGET");
+  command.push_back(key);
+  command.insert(command.end(), fields.begin(), fields.end());
+
+  Reply reply = CommandArgv(redis_client, command, key);
+  if (!reply) {
+    LOG(ERROR) << "Cannot get fields of key = " << key
+               << ", connection error.";
+    return reply;
+  }
+  if (!reply.IsArray()) {
+    LOG(ERROR) << "Cannot get fields of key = " << key << ": "
+               << reply.String();
+    return Reply();
+  }
+  return reply;
+}
+
+std::vector<Reply> Pipeline(
+    Client* redis_client,
+    const std::vector<std::vector<common::StringView>>& commands) {
+  cluster::ClusterClient* cluster = redis_client->GetCluster();
+  if (cluster != nullptr)
+    return cluster->Pipeline(commands, 1);
+
+  redisContext* redis_context = redis_client->GetContext();
+  std::vector<const char*> argv;
+  std::vector<size_t> argv_len;
+  for (auto& command : commands) {
+    argv.clear();
+    argv_len.clear();
+    for (auto& arg : command) {
+      argv.push_back(arg.data());
+      argv_len.push_back(arg.size());
+    }
+    redisAppendCommandArgv(redis_context, argv.size(), argv.data(),
+                           argv_len.data());
+  }
+
+  std::vector<Reply> replies(commands.size());
+  for (auto& reply : replies) {
+    void* object = nullptr;
+    if (redisGetReply(redis_context, &object) != REDIS_OK) {
+      LOG(ERROR) << "Cannot read replies of pipeline, connection error.";
+      break;
+    }
+    reply = Reply(static_cast<redisReply*>(object));
+  }
+  return replies;
+}
+
+namespace {
+
+// Execute |script|, return its reply (empty if failed). Script is reloaded
+// and executed again once if server does not know it (|reload|).
+Reply ExecuteScript(Client* redis_client,
+                    Script& script,
+                    const std::vector<std::string>& keys,
+                    const std::vector<std::string>& args,
+                    bool reload = true) {
+  // In a redis cluster, script is run (and loaded) on node of its keys,
+  // which must be in the same slot.
+  common::StringView key = keys.empty() ? common::StringView() : keys[0];
+  if (script.sha.empty() && !LoadScript(redis_client, script, key))
+    return Reply();
+
+  // EVALSHA sha numkeys key [key ...] arg [arg ...]
+  std::string key_number = std::to_string(keys.size());
+  std::vector<common::StringView> command;
+  command.reserve(keys.size() + args.size() + 3);
+  command.push_back("EVALSHA");
+  command.push_back(script.sha);
+  command.push_back(key_number);
+  command.insert(command.end(), keys.begin(), keys.end());
+  command.insert(command.end(), args.begin(), args.end());
+
+  Reply reply = CommandArgv(redis_client, command, key);
+  if (!reply) {
+    LOG(ERROR) << "Cannot execute script, connection error.";
+    return reply;
+  }
+  if (!reply.IsError())
+    return reply;
+
+  bool no_script = reply.String().size() >= 8 &&
+                   strncmp(reply.String().data(), "NOSCRIPT", 8) == 0;
+  if (!no_script || !reload) {
+    LOG(ERROR) << "Execute script failed: " << reply.String();
+    return Reply();
+  }
+
+  // Redis server was restarted or script cache was flushed (or node of a
+  // cluster did not run this script yet).
+  LOG(INFO) << "Script is not existed on redis server, reload it.";
+  script.sha.clear();
+  if (LoadScript(redis_client, script, key))
+    return ExecuteScript(redis_client, script, keys, args, false);
+  return Reply();
+}
+
+} // namespace
+
+bool EvalSha(Client* redis_client,
+             Script& script,
+             const std::vector<std::string>& keys,
+             const std::vector<std::string>& args) {
+  return static_cast<bool>(ExecuteScript(redis_client, script, keys, args));
+}
+
+bool EvalSha(Client* redis_client,
+             Script& script,
+             const std::vector<std::string>& keys,
+             const std::vector<std::string>& args,
+             std::vector<std::string>& result) {
+  result.clear();
+  Reply reply = ExecuteScript(redis_client, script, keys, args);
+  if (!reply)
+    return false;
+
+  for (size_t i = 0; i < reply.Size(); i++) {
+    ReplyView element = reply.Element(i);
+    if (element.IsString())
+      result.push_back(element.String().ToString());
+  }
+  return true;
 }
 
 } // namespace client
 
 namespace async_connect {
 
+namespace {
+
+// Strings and arrays up to these sizes are stored inside pooled replies
+// (enough for pub/sub messages and small MGET).
+const size_t kPooledStringSize = 232;
+const size_t kPooledElementNumber = 3;
+// Max number of free replies kept by a thread.
+const size_t kMaxFreeReplyNumber = 256;
+
+struct PooledReply {
+  // First member, so pointer to reply is pointer to |PooledReply|.
+  redisReply reply;
+  redisReply* elements[kPooledElementNumber];
+  char buffer[kPooledStringSize];
+  PooledReply* next;
+};
+
+// Free list of replies of a thread.
+class ReplyPool {
+public:
+  ~ReplyPool() {
+    while (free_ != nullptr) {
+      PooledReply* next = free_->next;
+      delete free_;
+      free_ = next;
+    }
+  }
+
+  PooledReply* Take() {
+    PooledReply* pooled = free_;
+    if (pooled != nullptr) {
+      free_ = pooled->next;
+      free_number_--;
+    } else {
+      pooled = new PooledReply();
+    }
+    memset(&pooled->reply, 0, sizeof(pooled->reply));
+    return pooled;
+  }
+
+  void Give(PooledReply* pooled) {
+    if (free_number_ == kMaxFreeReplyNumber) {
+      delete pooled;
+      return;
+    }
+    pooled->next = free_;
+    free_ = pooled;
+    free_number_++;
+  }
+
+private:
+  PooledReply* free_ = nullptr;
+  size_t free_number_ = 0;
+};
+
+thread_local ReplyPool reply_pool;
+
+// Link |pooled| to its parent array (if any), like default hiredis functions.
+void* AttachReply(const redisReadTask* task, PooledReply* pooled) {
+  if (task->parent != nullptr) {
+    redisReply* parent = static_cast<redisReply*>(task->parent->obj);
+    parent->element[task->idx] = &pooled->reply;
+  }
+  return &pooled->reply;
+}
+
+void FreePooledReply(void* object) {
+  if (object == nullptr)
+    return;
+
+  PooledReply* pooled = reinterpret_cast<PooledReply*>(object);
+  redisReply& reply = pooled->reply;
+  if (reply.type == REDIS_REPLY_ARRAY) {
+    for (size_t i = 0; i < reply.elements; i++)
+      FreePooledReply(reply.element[i]);
+    if (reply.element != pooled->elements)
+      free(reply.element);
+  } else if (reply.str != nullptr && reply.str != pooled->buffer) {
+    free(reply.str);
+  }
+  reply_pool.Give(pooled);
+}
+
+void* CreatePooledString(const redisReadTask* task, char* str, size_t len) {
+  PooledReply* pooled = reply_pool.Take();
+  char* buffer = pooled->buffer;
+  if (len >= kPooledStringSize) {
+    buffer = static_cast<char*>(malloc(len + 1));
+    if (buffer == nullptr) {
+      reply_pool.Give(pooled);
+      return nullptr;
+    }
+  }
+  memcpy(buffer, str, len);
+  buffer[len] = '\0';
+
+  pooled->reply.type = task->type;
+  pooled->reply.str = buffer;
+  pooled->reply.len = len;
+  return AttachReply(task, pooled);
+}
+
+void* CreatePooledArray(const redisReadTask* task, int elements) {
+  PooledReply* pooled = reply_pool.Take();
+  redisReply** element = pooled->elements;
+  if (static_cast<size_t>(elements) > kPooledElementNumber) {
+    element = static_cast<redisReply**>(
+        calloc(elements, sizeof(redisReply*)));
+    if (element == nullptr) {
+      reply_pool.Give(pooled);
+      return nullptr;
+    }
+  } else {
+    memset(element, 0, sizeof(pooled->elements));
+  }
+
+  pooled->reply.type = REDIS_REPLY_ARRAY;
+  pooled->reply.element = element;
+  pooled->reply.elements = elements;
+  return AttachReply(task, pooled);
+}
+
+void* CreatePooledInteger(const redisReadTask* task, long long value) {
+  PooledReply* pooled = reply_pool.Take();
+  pooled->reply.type = REDIS_REPLY_INTEGER;
+  pooled->reply.integer = value;
+  return AttachReply(task, pooled);
+}
+
+void* CreatePooledNil(const redisReadTask* task) {
+  PooledReply* pooled = reply_pool.Take();
+  pooled->reply.type = REDIS_REPLY_NIL;
+  return AttachReply(task, pooled);
+}
+
+redisReplyObjectFunctions pooled_reply_functions = {
+  CreatePooledString,
+  CreatePooledArray,
+  CreatePooledInteger,
+  CreatePooledNil,
+  FreePooledReply
+};
+
+} // namespace
+
 // Helper class to excute async command with a non-static callback.
+// Handler of a command is deleted after its reply. Handler of a subscription
+// (|persistent|) is called for every message, it is deleted when connection
+// is closed (hiredis calls it without reply then).
 template<typename Callback>
 class Handler {
 public:
-  Handler(Callback cb) : cb_(cb) {}
+  Handler(Callback cb, bool persistent = false)
+      : cb_(cb), persistent_(persistent) {}
 
   static void callback(redisAsyncContext *c, void *reply, void *privdata) {
     (static_cast<Handler<Callback>*>(privdata))->operator()(c, reply);
@@ -75,26 +722,38 @@ public:
           cb_(static_cast<redisReply*>(reply));
       }
 
-      // TODO(hoangpq): Find out mechanism to delete Handler pointer.
-      // Maybe seperate subscribe command and other commands.
-      // delete(this);
+      if (!persistent_ || reply == nullptr)
+        delete this;
   }
 
 private:
   Callback cb_;
+  bool persistent_;
 };
 
-redisAsyncContext* CreateAsyncConnect(const std::string& host, int port) {
-  redisAsyncContext* async_connect = redisAsyncConnect(host.c_str(), port);
+redisAsyncContext* CreateAsyncConnect(const RedisServerInformation& server) {
+  redisAsyncContext* async_connect = server.unix_socket.empty()
+      ? redisAsyncConnect(server.host.c_str(), server.port)
+      : redisAsyncConnectUnix(server.unix_socket.c_str());
   if (async_connect == nullptr || async_connect->err) {
-    LOG(ERROR) << "Create async connection to redis server failed!";
+    LOG(ERROR) << "Create async connection to redis server "
+               << GetAddress(server) << " failed!";
+    if (async_connect != nullptr)
+      redisAsyncFree(async_connect);
     return nullptr;
   }
 
+  // Socket is still connecting (non-blocking), options can be set already.
+  SetSocketOptions(&async_connect->c, server);
+
   LOG(INFO) << "Create async connection to redis server successfully.";
   return async_connect;
 }
 
+void UsePooledReplies(redisAsyncContext* async_connect) {
+  async_connect->c.reader->fn = &pooled_reply_functions;
+}
+
 void Authenticate(redisAsyncContext* async_connect,
                   const std::string& password,
                   AsyncCommandCallback callback) {
@@ -111,7 +770,7 @@ void Subscribe(redisAsyncContext* async_connect,
                const std::string& channel,
                AsyncCommandCallback callback) {
   Handler<AsyncCommandCallback> *handler =
-      new Handler<AsyncCommandCallback>(callback);
+      new Handler<AsyncCommandCallback>(callback, true);
   redisAsyncCommand(async_connect,
                     Handler<AsyncCommandCallback>::callback,
                     handler,
@@ -128,9 +787,196 @@ void Publish(redisAsyncContext* async_connect,
   redisAsyncCommand(async_connect,
                     Handler<AsyncCommandCallback>::callback,
                     handler,
-                    "PUBLISH %s %s",
+                    "PUBLISH %s %b",
                     channel.c_str(),
-                    message.c_str());
+                    message.data(),
+                    message.size());
+}
+
+void Command(redisAsyncContext* async_connect,
+             const std::vector<std::string>& args,
+             AsyncCommandCallback callback) {
+  std::vector<const char*> argv;
+  std::vector<size_t> argv_len;
+  argv.reserve(args.size());
+  argv_len.reserve(args.size());
+  for (auto& arg : args) {
+    argv.push_back(arg.data());
+    argv_len.push_back(arg.size());
+  }
+
+  Handler<AsyncCommandCallback> *handler =
+      new Handler<AsyncCommandCallback>(callback);
+  redisAsyncCommandArgv(async_connect,
+                        Handler<AsyncCommandCallback>::callback,
+                        handler,
+                        argv.size(),
+                        argv.data(),
+                        argv_len.data());
+}
+
+namespace {
+
+// Broken connection is re-created after this interval, commands are dropped
+// meanwhile. (milliseconds)
+const int kReconnectInterval = 1000;
+// Interval to log counters of command connections. (seconds)
+const int kCounterLogInterval = 60;
+
+// Command connections of a thread, closed when thread exits.
+class ThreadCommandConnectionPool {
+public:
+  ThreadCommandConnectionPool() {
+    // Connections may give pooled replies back when they are closed, so
+    // |reply_pool| must be destroyed after this pool (thread-local objects
+    // are destroyed in reverse order of construction).
+    reply_pool.Give(reply_pool.Take());
+  }
+
+  CommandConnection* Get(const RedisServerInformation& server,
+                         struct event_base* event_base) {
+    std::unique_ptr<CommandConnection>& connection =
+        connections_[GetAddress(server)];
+    if (!connection)
+      connection.reset(new CommandConnection(server, event_base));
+    return connection.get();
+  }
+
+private:
+  // Address of server -> connection.
+  std::map<std::string, std::unique_ptr<CommandConnection>> connections_;
+};
+
+thread_local ThreadCommandConnectionPool thread_command_connection_pool;
+
+} // namespace
+
+CommandConnection::CommandConnection(const RedisServerInformation& server,
+                                     struct event_base* event_base)
+    : server_(server),
+      event_base_(event_base),
+      last_log_time_(std::chrono::steady_clock::now()) {}
+
+CommandConnection::~CommandConnection() {
+  // Pending commands are called back (without reply) right now.
+  if (context_ != nullptr)
+    redisAsyncFree(context_);
+  LogCounters(true);
+}
+
+void CommandConnection::Publish(const std::string& channel,
+                                const std::vector<std::string>& messages) {
+  command_count_ += messages.size();
+  if (!Connect()) {
+    dropped_count_ += messages.size();
+    return;
+  }
+
+  // Commands are appended to output buffer of |context_|, it is written to
+  // socket when this loop iteration is done.
+  for (auto& message : messages) {
+    if (redisAsyncCommand(context_, &CommandConnection::OnReply, this,
+                          "PUBLISH %b %b",
+                          channel.data(), channel.size(),
+                          message.data(), message.size()) != REDIS_OK)
+      dropped_count_++;
+  }
+  LogCounters(false);
+}
+
+bool CommandConnection::Connect() {
+  if (context_ != nullptr)
+    return true;
+
+  auto now = std::chrono::steady_clock::now();
+  if (now - last_connect_time_ <
+      std::chrono::milliseconds(kReconnectInterval))
+    return false;
+  last_connect_time_ = now;
+
+  context_ = CreateAsyncConnect(server_);
+  if (context_ == nullptr)
+    return false;
+
+  context_->data = this;
+  redisLibeventAttach(context_, event_base_);
+  UsePooledReplies(context_);
+  redisAsyncSetConnectCallback(context_, &CommandConnection::OnConnect);
+  redisAsyncSetDisconnectCallback(context_, &CommandConnection::OnDisconnect);
+
+  if (!server_.password.empty()) {
+    command_count_++;
+    redisAsyncCommand(context_, &CommandConnection::OnReply, this,
+                      "AUTH %s", server_.password.c_str());
+  }
+  return true;
+}
+
+void CommandConnection::LogCounters(bool force) {
+  auto now = std::chrono::steady_clock::now();
+  if (!force && (command_count_ == logged_command_count_ ||
+                 now - last_log_time_ <
+                     std::chrono::seconds(kCounterLogInterval)))
+    return;
+  last_log_time_ = now;
+  logged_command_count_ = command_count_;
+
+  LOG(INFO) << "Command connection to " << GetAddress(server_) << ": "
+            << command_count_ << " commands, " << reply_count_
+            << " replies, " << error_count_ << " errors, " << dropped_count_
+            << " dropped, "
+            << command_count_ - reply_count_ - error_count_ - dropped_count_
+            << " pending.";
+}
+
+// static
+void CommandConnection::OnReply(redisAsyncContext* context, void* reply,
+                                void* privdata) {
+  CommandConnection* connection = static_cast<CommandConnection*>(privdata);
+  redisReply* redis_reply = static_cast<redisReply*>(reply);
+  if (redis_reply == nullptr) {
+    connection->dropped_count_++;
+  } else if (redis_reply->type == REDIS_REPLY_ERROR) {
+    connection->error_count_++;
+    LOG_EVERY_N(ERROR, 1000) << "Command on connection to "
+                             << GetAddress(connection->server_)
+                             << " failed: " << redis_reply->str;
+  } else {
+    connection->reply_count_++;
+  }
+}
+
+// static
+void CommandConnection::OnConnect(const redisAsyncContext* context,
+                                  int status) {
+  if (status == REDIS_OK)
+    return;
+
+  // hiredis frees |context| after this callback.
+  CommandConnection* connection = static_cast<CommandConnection*>(
+      context->data);
+  LOG(ERROR) << "Cannot connect to redis server "
+             << GetAddress(connection->server_) << ": " << context->errstr;
+  connection->context_ = nullptr;
+}
+
+// static
+void CommandConnection::OnDisconnect(const redisAsyncContext* context,
+                                     int status) {
+  // hiredis frees |context| after this callback.
+  CommandConnection* connection = static_cast<CommandConnection*>(
+      context->data);
+  if (status != REDIS_OK)
+    LOG(ERROR) << "Connection to redis server "
+               << GetAddress(connection->server_) << " is lost: "
+               << context->errstr << ", reconnect.";
+  connection->context_ = nullptr;
+}
+
+CommandConnection* GetThreadCommandConnection(
+    const RedisServerInformation& server,
+    struct event_base* event_base) {
+  return thread_command_connection_pool.Get(server, event_base);
 }
 
 } // namespace async_connect
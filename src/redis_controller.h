@@ -1,29 +1,229 @@
 #ifndef REDIS_CONTROLLER_H_
 #define REDIS_CONTROLLER_H_
 
+#include <chrono>
+#include <cstdint>
 #include <functional>
+#include <memory>
 #include <string>
+#include <vector>
+#include "common/string_view.h"
+#include "configuration.h"
 #include "hiredis/async.h"
 #include "hiredis/hiredis.h"
 
+struct event_base;
+
 // Use to work with hiredis.
 namespace redis {
 
+// Read-only access to a reply (or to an element of an array reply). Strings
+// are read in place, not copied. Does not own the reply.
+class ReplyView {
+public:
+  ReplyView() : reply_(nullptr) {}
+  explicit ReplyView(const redisReply* reply) : reply_(reply) {}
+
+  // False if there is no reply (connection error).
+  explicit operator bool() const { return reply_ != nullptr; }
+  const redisReply* get() const { return reply_; }
+
+  bool IsString() const { return IsType(REDIS_REPLY_STRING); }
+  bool IsStatus() const { return IsType(REDIS_REPLY_STATUS); }
+  bool IsError() const { return IsType(REDIS_REPLY_ERROR); }
+  bool IsInteger() const { return IsType(REDIS_REPLY_INTEGER); }
+  bool IsArray() const { return IsType(REDIS_REPLY_ARRAY); }
+  bool IsNil() const { return IsType(REDIS_REPLY_NIL); }
+
+  // Content of string, status or error reply, empty for other types. Valid
+  // while reply is alive.
+  common::StringView String() const {
+    return reply_ != nullptr && reply_->str != nullptr
+        ? common::StringView(reply_->str, reply_->len)
+        : common::StringView();
+  }
+  long long Integer() const { return IsInteger() ? reply_->integer : 0; }
+
+  // Elements of array reply.
+  size_t Size() const { return IsArray() ? reply_->elements : 0; }
+  ReplyView Element(size_t i) const { return ReplyView(reply_->element[i]); }
+
+private:
+  bool IsType(int type) const {
+    return reply_ != nullptr && reply_->type == type;
+  }
+
+  const redisReply* reply_;
+};
+
+// Owns reply of a synchronous command, freed when it is destroyed.
+class Reply : public ReplyView {
+public:
+  Reply() {}
+  explicit Reply(redisReply* reply) : ReplyView(reply) {}
+  Reply(Reply&& other) : ReplyView(other.Release()) {}
+  Reply& operator=(Reply&& other) {
+    if (this != &other) {
+      Reset();
+      ReplyView::operator=(ReplyView(other.Release()));
+    }
+    return *this;
+  }
+  ~Reply() { Reset(); }
+
+  Reply(const Reply&) = delete;
+  Reply& operator=(const Reply&) = delete;
+
+  // Free reply now.
+  void Reset() {
+    if (get() != nullptr)
+      freeReplyObject(const_cast<redisReply*>(Release()));
+  }
+
+private:
+  const redisReply* Release() {
+    const redisReply* reply = get();
+    ReplyView::operator=(ReplyView());
+    return reply;
+  }
+};
+
+namespace cluster {
+class ClusterClient;
+} // namespace cluster
+
 namespace client {
 
-// Create new redis client (synchronous connection).
-redisContext* CreateRedisClient(const std::string& host, int port);
+class ClientCache;
+
+// Synchronous client of a thread (see |GetThreadClient()|): a connection to
+// a redis server, or a client of a redis cluster (functions below send
+// commands to nodes which serve their keys). Owned by thread-local pool.
+class Client {
+public:
+  // Connection |context| (owned), GETs of cached keys go through |cache| if
+  // it is not nullptr.
+  Client(redisContext* context, ClientCache* cache);
+  // Client of a redis cluster.
+  explicit Client(std::unique_ptr<cluster::ClusterClient> cluster);
+  virtual ~Client();
+
+  Client(const Client&) = delete;
+  Client& operator=(const Client&) = delete;
+
+  // Connection, nullptr if this is a cluster client.
+  redisContext* GetContext() const { return context_; }
+  // Cluster client, nullptr if this is a connection.
+  cluster::ClusterClient* GetCluster() const { return cluster_.get(); }
+
+  // Client cache which GETs of this connection go through (tracking is
+  // enabled on first use), nullptr if it is not used or cannot be used now.
+  // Id of invalidation connection is saved into |client_id|.
+  ClientCache* GetCache(uint64_t& client_id);
+
+private:
+  redisContext* context_ = nullptr;
+  std::unique_ptr<cluster::ClusterClient> cluster_;
+  ClientCache* cache_ = nullptr;
+  // State of tracking of |context_| (see |ClientCache::Track()|).
+  uint64_t tracking_id_ = 0;
+};
+
+// Lua script which is executed on redis server.
+struct Script {
+  std::string source;
+  // SHA1 digest returned by 'SCRIPT LOAD', empty if script is not loaded.
+  std::string sha;
+};
+
+// Create new redis client (synchronous connection), by TCP or unix socket
+// and with socket options/timeouts of |server|. Not authenticated.
+redisContext* CreateRedisClient(const RedisServerInformation& server);
 
 // Perform 'AUTH' command.
 bool Authenticate(redisContext* redis_context, const std::string& password);
 
-// Perform 'GET' command.
-std::string Get(redisContext* redis_context, const std::string& key);
+// Perform any command on connection |redis_context|, like redisCommand()
+// (ex: "GET %b"). There is no version for |Client|: command has no key to
+// route on a redis cluster.
+Reply Command(redisContext* redis_context, const char* format, ...);
+
+// Get client of calling thread to |server|. Each thread owns its clients
+// (through a thread-local pool): a connection is created and authenticated at
+// first use, re-created after it is broken, and closed when thread exits. So
+// connections are never shared between threads and commands of many threads
+// run in parallel without lock.
+// If |server| is a redis cluster, returned client is a cluster client of
+// calling thread (see |redis::cluster::ClusterClient|).
+// Return nullptr if cannot connect. Do not free returned client.
+Client* GetThreadClient(const RedisServerInformation& server);
+
+// Perform 'GET' command. Value is string reply, read it in place; reply is
+// nil if key is not existed. If client-side cache of server is enabled (see
+// |redis::client::ClientCache|), cached keys are read from it, redis is only
+// asked after they are changed.
+Reply Get(Client* redis_client, common::StringView key);
 
 // Perform 'SET' command.
-void Set(redisContext* redis_context,
-         const std::string& key,
-         const std::string& value);
+void Set(Client* redis_client,
+         common::StringView key,
+         common::StringView value);
+
+// Perform 'SET key value NX PX expire_milliseconds' command. Return true if
+// |key| is set (it was not existed).
+bool SetNx(Client* redis_client,
+           const std::string& key,
+           const std::string& value,
+           uint64_t expire_milliseconds);
+
+// Perform 'SET key value PX expire_milliseconds' for all |keys| (and
+// corresponding |values|, can be binary data), in one pipeline (one per node
+// of a redis cluster, sent in parallel). Keys do not expire if
+// |expire_milliseconds| is 0.
+void SetMany(Client* redis_client,
+             const std::vector<std::string>& keys,
+             const std::vector<std::string>& values,
+             uint64_t expire_milliseconds);
+
+// Perform 'MGET' command (GET of each key on a redis cluster, pipelined to
+// each node). Values can be binary data, value is empty if key is not
+// existed. Return empty list if command failed.
+std::vector<std::string> MGet(Client* redis_client,
+                              const std::vector<std::string>& keys);
+
+// Perform 'HMGET key field ...' command. Reply is array of values (read in
+// place), in order of |fields|, nil if field (or key) is not existed. Reply is
+// empty if command failed. Client-side cache is not used: hashes are always
+// read from redis.
+Reply HMGet(Client* redis_client,
+            common::StringView key,
+            const std::vector<common::StringView>& fields);
+
+// Perform all |commands| (command name then its arguments, can be binary
+// data, ex: {"HSET", key, field, value}) in one pipeline (one per node of a
+// redis cluster, sent in parallel; key is first argument). Replies are in
+// order of |commands|, reply is empty if connection is broken before it.
+std::vector<Reply> Pipeline(
+    Client* redis_client,
+    const std::vector<std::vector<common::StringView>>& commands);
+
+// Perform 'SCRIPT LOAD' command, save SHA1 digest into |script|.
+bool ScriptLoad(Client* redis_client, Script& script);
+
+// Perform 'EVALSHA' command. Script is reloaded and executed again (once)
+// if redis server does not know it (NOSCRIPT error, after server restarted,
+// etc.).
+// On a redis cluster, script runs on node of |keys| (same slot).
+bool EvalSha(Client* redis_client,
+             Script& script,
+             const std::vector<std::string>& keys,
+             const std::vector<std::string>& args);
+// Same as above, script returns a list of strings (saved in |result|).
+bool EvalSha(Client* redis_client,
+             Script& script,
+             const std::vector<std::string>& keys,
+             const std::vector<std::string>& args,
+             std::vector<std::string>& result);
 
 } // namespace client
 
@@ -31,24 +231,101 @@ namespace async_connect {
 
 typedef std::function<void(redisReply*)> AsyncCommandCallback;
 
-// Create new asynchronous connection to redis server.
-redisAsyncContext* CreateAsyncConnect(const std::string& host, int port);
+// Create new asynchronous connection to redis server, by TCP or unix socket
+// and with socket options of |server| (timeouts are not supported).
+redisAsyncContext* CreateAsyncConnect(const RedisServerInformation& server);
 
 // Perform authenticate command on async connection.
 void Authenticate(redisAsyncContext* async_connect,
                   const std::string& password,
                   AsyncCommandCallback callback);
 
-// Subcribe a specific channel on redis server to listening message.
+// Take replies of |async_connect| from a free list of calling thread
+// (strings and arrays are stored inside pooled objects if they are small),
+// instead of allocating them for each message. Must be called on the thread
+// which runs |async_connect|, before any command is sent.
+void UsePooledReplies(redisAsyncContext* async_connect);
+
+// Subcribe a specific channel on redis server to listening message. A
+// subscribing connection cannot send other commands (except SUBSCRIBE), use a
+// |CommandConnection| for them.
 void Subscribe(redisAsyncContext* async_connect,
                const std::string& channel,
                AsyncCommandCallback callback);
 
+// Publish |message| to |channel|. |message| can be binary data. Connection
+// must not be subscribing.
 void Publish(redisAsyncContext* async_connect,
              const std::string& channel,
              const std::string& message,
              AsyncCommandCallback callback);
 
+// Perform any command, |args| are command name and its arguments (ex:
+// {"MGET", "key1", "key2"}). Arguments can be binary data.
+void Command(redisAsyncContext* async_connect,
+             const std::vector<std::string>& args,
+             AsyncCommandCallback callback);
+
+// Async connection which only sends commands, it never subscribes. It is
+// shared by all users on its event loop (see |GetThreadCommandConnection()|),
+// commands which are sent in the same loop iteration are written to socket
+// together (pipelined). Connection is re-created after it is broken.
+// Only used on its event loop thread.
+class CommandConnection {
+public:
+  CommandConnection(const RedisServerInformation& server,
+                    struct event_base* event_base);
+  virtual ~CommandConnection();
+
+  CommandConnection(const CommandConnection&) = delete;
+  CommandConnection& operator=(const CommandConnection&) = delete;
+
+  // Perform 'PUBLISH channel message' for each of |messages| (can be binary
+  // data).
+  void Publish(const std::string& channel,
+               const std::vector<std::string>& messages);
+
+  // Counters of commands. Every command ends as a reply, an error reply or
+  // dropped (no connection, or connection is lost before its reply).
+  uint64_t GetCommandCount() const { return command_count_; }
+  uint64_t GetReplyCount() const { return reply_count_; }
+  uint64_t GetErrorCount() const { return error_count_; }
+  uint64_t GetDroppedCount() const { return dropped_count_; }
+
+private:
+  // Connect (and authenticate) if not connected. Return false if there is no
+  // connection, commands are dropped then.
+  bool Connect();
+  // Log counters periodically, or now if |force|.
+  void LogCounters(bool force);
+
+  static void OnReply(redisAsyncContext* context, void* reply,
+                      void* privdata);
+  static void OnConnect(const redisAsyncContext* context, int status);
+  static void OnDisconnect(const redisAsyncContext* context, int status);
+
+  RedisServerInformation server_;
+  struct event_base* event_base_;
+  redisAsyncContext* context_ = nullptr;
+  std::chrono::steady_clock::time_point last_connect_time_;
+  std::chrono::steady_clock::time_point last_log_time_;
+
+  uint64_t command_count_ = 0;
+  uint64_t reply_count_ = 0;
+  uint64_t error_count_ = 0;
+  uint64_t dropped_count_ = 0;
+  // |command_count_| when counters were logged last time.
+  uint64_t logged_command_count_ = 0;
+};
+
+// Get command connection of calling thread to |server|, which runs
+// |event_base|. It is created at first use and closed when thread exits, so
+// all users on an event loop share one connection. Do not free returned
+// connection.
+CommandConnection* GetThreadCommandConnection(
+    const RedisServerInformation& server,
+    struct event_base* event_base);
+
 } // namespace asyn_connect
 
 } // namespace redis
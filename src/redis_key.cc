@@ -6,6 +6,8 @@ const char kFairValueChannel[] = "price_engine_message";
 
 // Keys.
 const char kFairValuePrefix[] = "price_engine_data_";
+const char kFairValueHashPrefix[] = "price_engine_hash_";
+const char kSymbolNameKey[] = "symbol";
 const char kTimestampKey[] = "timestamp";
 const char kFairValueKey[] = "fair_value";
 const char kFairValueMVKey[] = "mov_avr";
@@ -25,3 +27,8 @@ const char kSkewTypeKey[] = "type_active";
 const char kSkewValueKey[] = "value";
 const char kSkewPercentKey[] = "percent";
 const char kMovingAverageKey[] = "PEmvlen";
+const char kRefreshIntervalKey[] = "PEinterval";
+
+const char kClusterMembersKey[] = "{pe_cluster}_members";
+const char kClusterLeasePrefix[] = "{pe_cluster}_lease_";
+const char kClusterSnapshotPrefix[] = "pe_cluster_snapshot_";
@@ -8,7 +8,12 @@ extern const char kFairValueChannel[];
 // Keys.
 // Prefix of fair value json object. (Key = prefix + symbol)
 extern const char kFairValuePrefix[];
+// Prefix of fair value hash, fields are keys below (except symbol name).
+// (Key = prefix + symbol)
+extern const char kFairValueHashPrefix[];
 // Keys inside fair value json object.
+// Symbol name, only used in batched notification.
+extern const char kSymbolNameKey[];
 extern const char kTimestampKey[];
 extern const char kFairValueKey[];
 extern const char kFairValueMVKey[];
@@ -30,5 +35,19 @@ extern const char kSkewTypeKey[];
 extern const char kSkewValueKey[];
 extern const char kSkewPercentKey[];
 extern const char kMovingAverageKey[];
+// Refresh interval of symbol (milliseconds), optional.
+extern const char kRefreshIntervalKey[];
+
+// Cluster of PE instances (see |ClusterCoordinator|). Members and leases
+// have the same hash tag, so scripts which use them together can run on a
+// redis cluster (keys in one slot).
+// Sorted set of alive instances, score is expire time (milliseconds).
+extern const char kClusterMembersKey[];
+// Prefix of lease of a group, value is id of owner instance.
+// (Key = prefix + group name)
+extern const char kClusterLeasePrefix[];
+// Prefix of fair value history snapshot of a symbol, used to warm start the
+// symbol on another instance. (Key = prefix + symbol)
+extern const char kClusterSnapshotPrefix[];
 
 #endif  // REDIS_KEY_H_
\ No newline at end of file
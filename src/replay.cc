@@ -0,0 +1,168 @@
+#include "replay.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "glog/logging.h"
+#include "pricing_core.h"
+#include "symbol.h"
+#include "tick_journal.h"
+
+namespace {
+
+// Max number of mismatched records which are logged.
+const int kMaxLoggedMismatchNumber = 20;
+
+// Calculation state of a symbol, like in a group.
+struct ReplaySymbol {
+  int32_t pricing_core;
+  uint64_t config_version;
+  // One of them is used, by |pricing_core|.
+  std::unique_ptr<Symbol> symbol;
+  std::unique_ptr<PricingCore> core;
+};
+
+// Calculate outputs of |record| by |state|, same as |Group::Loop()|.
+void Calculate(ReplaySymbol& state, const TickJournalRecord& record,
+               const std::string& symbol_name, TickJournalRecord& output) {
+  FairValueInputs inputs;
+  GetTickJournalInputs(record, inputs);
+
+  common::Decimal fair_value;
+  double moving_average = 0.0;
+  double standard_deviation_ratio = 0.0;
+  if (state.pricing_core == PRICING_CORE_SOA) {
+    // Rows are independent, so a row per core gives the same results.
+    PricingCore& core = *state.core;
+    if (core.GetSymbolNumber() == 0) {
+      core.AddSymbol(symbol_name, inputs.config);
+    } else if (inputs.config_version != state.config_version) {
+      core.UpdateConfig(0, inputs.config);
+    }
+    if (core.GetFirstLeg(0) >= 0)
+      core.SetLegPrice(core.GetFirstLeg(0), inputs.leg1.ToDouble());
+    if (core.GetSecondLeg(0) >= 0)
+      core.SetLegPrice(core.GetSecondLeg(0), inputs.leg2.ToDouble());
+    core.Calculate();
+
+    fair_value = common::Decimal::FromDouble(core.GetFairValue(0),
+                                             inputs.precision);
+    moving_average = core.GetMovingAverage(0);
+    standard_deviation_ratio = core.GetStandardDeviationRatio(0);
+  } else {
+    Symbol& symbol = *state.symbol;
+    if (inputs.config_version != state.config_version)
+      symbol.UpdateFairValueConfig(inputs.config);
+
+    fair_value = symbol.CalculateFairValue(inputs);
+    if (fair_value.IsPositive()) {
+      double standard_deviation = 0.0;
+      symbol.CalculateMovingAverage(moving_average, standard_deviation,
+                                    standard_deviation_ratio);
+    }
+  }
+  state.config_version = inputs.config_version;
+
+  output.fair_value_mantissa = fair_value.mantissa();
+  output.fair_value_scale = fair_value.scale();
+  output.moving_average = moving_average;
+  output.standard_deviation_ratio = standard_deviation_ratio;
+}
+
+} // namespace
+
+int RunReplay(const std::string& journal_file_name) {
+  TickJournalReader reader;
+  if (!reader.Open(journal_file_name))
+    return EXIT_FAILURE;
+
+  // Symbols are found by name. Ids of current run of PE are cached, they
+  // are changed when a new run is appended to journal.
+  std::vector<std::unique_ptr<ReplaySymbol>> symbols;
+  std::unordered_map<std::string, ReplaySymbol*> symbol_names;
+  std::vector<ReplaySymbol*> symbol_ids;
+  std::vector<std::string> id_names;
+
+  const TickJournalRecord* records = reader.GetRecords();
+  size_t record_number = reader.GetRecordNumber();
+  size_t mismatch = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < record_number; i++) {
+    const TickJournalRecord& record = records[i];
+    std::string symbol_name(
+        record.symbol_name,
+        strnlen(record.symbol_name, kTickJournalSymbolNameSize));
+
+    if (record.symbol_id < 0)
+      continue;
+    size_t id = record.symbol_id;
+    if (id >= symbol_ids.size()) {
+      symbol_ids.resize(id + 1, nullptr);
+      id_names.resize(id + 1);
+    }
+    ReplaySymbol* state = symbol_ids[id];
+    if (state == nullptr || id_names[id] != symbol_name ||
+        state->pricing_core != record.pricing_core) {
+      ReplaySymbol*& named_state = symbol_names[symbol_name];
+      // Group of symbol is changed to other pricing core, restart from
+      // empty history like PE does.
+      if (named_state == nullptr ||
+          named_state->pricing_core != record.pricing_core) {
+        std::unique_ptr<ReplaySymbol> new_state(new ReplaySymbol());
+        new_state->pricing_core = record.pricing_core;
+        new_state->config_version = 0;
+        FairValueInputs inputs;
+        GetTickJournalInputs(record, inputs);
+        if (record.pricing_core == PRICING_CORE_SOA) {
+          new_state->core.reset(new PricingCore());
+        } else {
+          new_state->symbol.reset(new Symbol(symbol_name, inputs.config,
+                                             inputs.precision));
+          new_state->config_version = inputs.config_version;
+        }
+        named_state = new_state.get();
+        symbols.push_back(std::move(new_state));
+      }
+      state = named_state;
+      symbol_ids[id] = state;
+      id_names[id] = symbol_name;
+    }
+
+    TickJournalRecord output;
+    Calculate(*state, record, symbol_name, output);
+    if (output.fair_value_mantissa != record.fair_value_mantissa ||
+        output.fair_value_scale != record.fair_value_scale ||
+        output.moving_average != record.moving_average ||
+        output.standard_deviation_ratio != record.standard_deviation_ratio) {
+      if (mismatch < kMaxLoggedMismatchNumber) {
+        LOG(ERROR) << "Mismatch at record " << i << " [" << symbol_name
+                   << ", timestamp " << record.timestamp << "]: "
+                   << "fair_value = "
+                   << common::Decimal(record.fair_value_mantissa,
+                                      record.fair_value_scale).ToString()
+                   << " / "
+                   << common::Decimal(output.fair_value_mantissa,
+                                      output.fair_value_scale).ToString()
+                   << ", moving_average = " << record.moving_average
+                   << " / " << output.moving_average
+                   << ", std_dev_ratio = " << record.standard_deviation_ratio
+                   << " / " << output.standard_deviation_ratio;
+      }
+      mismatch++;
+    }
+  }
+
+  double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+  LOG(INFO) << "Replay " << journal_file_name << ":\n"
+            << " - Records: " << record_number << "\n"
+            << " - Symbols: " << symbols.size() << "\n"
+            << " - Time: " << seconds << " s ("
+            << (seconds > 0 ? record_number / seconds : 0)
+            << " records/s)\n"
+            << " - Mismatched results (recorded / replayed): " << mismatch;
+  return mismatch == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,13 @@
+#ifndef REPLAY_H_
+#define REPLAY_H_
+
+#include <string>
+
+// Replay tick journal, run by "PE --replay <journal>".
+// Fair values are calculated again from recorded inputs (by the same code as
+// groups, |Symbol| or |PricingCore|), as fast as possible and without redis,
+// then compared with recorded outputs. Return exit code (failure if any
+// output is different).
+int RunReplay(const std::string& journal_file_name);
+
+#endif  // REPLAY_H_
@@ -1,6 +1,7 @@
 #include "symbol.h"
 
 #include <algorithm>
+#include <cstdlib>
 #include <mutex>
 // #include <chrono>
 // #include <ctime>
@@ -15,92 +16,159 @@ namespace {
 // Max size of fair value history queue.
 const int kMaxSizeFairValueHistoryQueue = 600;
 
+// Digits after decimal point of skew percent.
+const int kSkewPercentScale = 6;
+
+// Read base fair value from hash of |symbol| (timestamp and moving average
+// fields only, plain numbers), from redis every time (HMGET bypasses client
+// cache). Return false if hash is not existed, otherwise |fair_value| is 0 if
+// fields are invalid or too old at |now|.
+bool GetBaseCurrencyFairValueFromHash(redis::client::Client* redis_client,
+                                      const std::string& symbol,
+                                      common::WallClockMs now,
+                                      common::Decimal& fair_value) {
+  fair_value = common::Decimal();
+  redis::Reply reply = redis::client::HMGet(
+      redis_client, std::string(kFairValueHashPrefix) + symbol,
+      {kTimestampKey, kFairValueMVKey});
+  if (reply.Size() != 2 || reply.Element(0).IsNil())
+    return false;
+
+  // Strings of replies are null-terminated.
+  common::StringView timestamp_value = reply.Element(0).String();
+  common::StringView value = reply.Element(1).String();
+  char* end = nullptr;
+  uint64_t timestamp = strtoull(timestamp_value.data(), &end, 10);
+  if (timestamp_value.empty() ||
+      end != timestamp_value.data() + timestamp_value.size()) {
+    LOG(ERROR) << "Invalid base fair value timestamp: " << timestamp_value;
+    return true;
+  }
+  if (common::ToUint64(now) >
+      timestamp + Configuration::GetInstance()->GetDiffTimeMax()) {
+    LOG(INFO) << "Base fair value is too old, ignore it.";
+    return true;
+  }
+  if (!common::Decimal::Parse(value.data(), value.size(), fair_value))
+    LOG(ERROR) << "Invalid base fair value: " << value;
+  return true;
+}
+
 } // namespace
 
 Symbol::Symbol(
     const std::string& symbol_name,
     const FairValueConfig& config,
-    redisContext* redis_client)
+    int precision)
     : symbol_name_(symbol_name),
-      fair_value_config_(config),
-      redis_client_(redis_client),
+      fair_value_config_(new FairValueConfigSnapshot{0, config}),
       setting_mutex_() {
+  SetPrecision(precision);
 }
 
 Symbol::~Symbol() {
+  if (shm_writer_ != nullptr)
+    shm_writer_->UnregisterSymbol(shm_symbol_id_);
 }
 
 void Symbol::UpdateFairValueConfig(FairValueConfig config) {
   std::lock_guard<std::mutex> lock(setting_mutex_);
-  fair_value_config_ = config;
+  uint64_t version = GetConfigVersion() + 1;
+  std::atomic_store(&fair_value_config_,
+      std::shared_ptr<const FairValueConfigSnapshot>(
+          new FairValueConfigSnapshot{version, std::move(config)}));
+  config_version_ = version;
 }
 
-double Symbol::CalculateFairValue() {
-  std::lock_guard<std::mutex> lock(setting_mutex_);
-  double fair_value = 0.0;
-  std::string symbol;
-  double p = 0.0;
+void Symbol::SetPrecision(int precision) {
+  precision_ = std::max(0, std::min(precision, common::Decimal::kMaxScale));
+}
+
+void Symbol::ReadInputs(redis::client::Client* redis_client,
+                        RedisStorageMode storage, common::WallClockMs now,
+                        FairValueInputs& inputs) {
+  std::shared_ptr<const FairValueConfigSnapshot> snapshot =
+      GetFairValueConfigSnapshot();
+  inputs.config = snapshot->config;
+  inputs.config_version = snapshot->version;
+  inputs.precision = precision_;
+  inputs.leg1 = common::Decimal();
+  inputs.leg2 = common::Decimal();
+  if (inputs.config.calculate_method != BASED_ON_A_CURRENCY)
+    return;
+
+  // Base symbol is X-Y, get fair value of XY by the following formula:
+  //    X-Y = X-'JPY' / Y-'JPY".
+
+  // Get fair value of first code with base currency.
+  std::string symbol = common::GetCodeFromSymbol(symbol_name_, 1)
+                          + inputs.config.base_currency;
+  inputs.leg1 = GetBaseCurrencyFairValue(redis_client, storage, symbol, now);
+  if (inputs.leg1.IsZero()) {
+    LOG(ERROR) << "Cannot get fair value of symbol " << symbol;
+    return;
+  }
+
+  // Get fair value of second code with base currency.
+  symbol = common::GetCodeFromSymbol(symbol_name_, 2)
+              + inputs.config.base_currency;
+  inputs.leg2 = GetBaseCurrencyFairValue(redis_client, storage, symbol, now);
+  if (inputs.leg2.IsZero())
+    LOG(ERROR) << "Cannot get fair value of symbol " << symbol;
+}
+
+common::Decimal Symbol::CalculateFairValue(const FairValueInputs& inputs) {
+  const FairValueConfig& config = inputs.config;
+  int precision = inputs.precision;
+  common::Decimal fair_value(0, precision);
 
   // Firstly, get fair value by calculation method.
-  switch (fair_value_config_.calculate_method) {
+  switch (config.calculate_method) {
   case FROM_OTHER_SOURCES:
     // TODO(hoangpq): Currently do not use this method.
-    return 0.0;
+    return fair_value;
     break;
   case FIXED_PRICE:
-    fair_value = fair_value_config_.fixed_price;
+    fair_value = common::Decimal::FromDouble(config.fixed_price, precision);
     break;
   case BASED_ON_A_CURRENCY:
-    // Base symbol is X-Y, get fair value of XY by the following formula:
-    //    X-Y = X-'JPY' / Y-'JPY".
-
-    // Get fair value of first code with base currency.
-    symbol = common::GetCodeFromSymbol(symbol_name_, 1)
-                + fair_value_config_.base_currency;
-    p = GetBaseCurrencyFairValue(symbol);
-    if (p == 0.0) {
-      LOG(ERROR) << "Cannot get fair value of symbol " << symbol;
-      return 0.0;
-    }
-    fair_value = p;
-
-    // Get fair value of second code with base currency.
-    symbol = common::GetCodeFromSymbol(symbol_name_, 2)
-                + fair_value_config_.base_currency;
-    p = GetBaseCurrencyFairValue(symbol);
-    if (p == 0.0) {
-      LOG(ERROR) << "Cannot get fair value of symbol " << symbol;
-      return 0.0;
-    }
-    fair_value /= p;
+    if (inputs.leg1.IsZero() || inputs.leg2.IsZero())
+      return fair_value;
+    // Legs are exact decimals, so quotient is rounded only once.
+    fair_value = inputs.leg1.Divide(inputs.leg2, precision);
     break;
   default:
     LOG(ERROR) << "Do not support this calculation method: "
-               << static_cast<int>(fair_value_config_.calculate_method);
-    return 0.0;
+               << static_cast<int>(config.calculate_method);
+    return fair_value;
   }
 
   // Skewing if necessary.
-  if (fair_value_config_.skew_active) {
-    switch (fair_value_config_.skew_type) {
+  if (config.skew_active) {
+    switch (config.skew_type) {
     case 1:
       // by value.
-      fair_value += fair_value_config_.skew_value;
+      fair_value = fair_value.Add(
+          common::Decimal::FromDouble(config.skew_value, precision));
       break;
-    case 2:
+    case 2: {
       // by percent.
-      fair_value *= (fair_value_config_.skew_percent / 100);
+      common::Decimal percent = common::Decimal::FromDouble(
+          config.skew_percent, kSkewPercentScale);
+      fair_value = fair_value.Multiply(
+          common::Decimal(percent.mantissa(), percent.scale() + 2));
       break;
+    }
     default:
       LOG(ERROR) << "Do not support this skewing type: "
-                 << static_cast<int>(fair_value_config_.skew_type);
+                 << static_cast<int>(config.skew_type);
       break;
     }
   }
 
   // Save current fair value in queue to calculate moving average.
-  if (fair_value > 0) {
-    fair_value_history_.push_front(fair_value);
+  if (fair_value.IsPositive()) {
+    fair_value_history_.push_front(fair_value.ToDouble());
     if (fair_value_history_.size() > kMaxSizeFairValueHistoryQueue)
       fair_value_history_.pop_back();
   }
@@ -108,28 +176,34 @@ double Symbol::CalculateFairValue() {
   return fair_value;
 }
 
+void Symbol::LoadFairValueHistory(const std::vector<double>& values) {
+  size_t size = std::min(values.size(),
+                         static_cast<size_t>(kMaxSizeFairValueHistoryQueue));
+  fair_value_history_.assign(values.begin(), values.begin() + size);
+}
+
 void Symbol::CalculateMovingAverage(
     double& moving_average,
     double& standard_deviation,
     double& standard_deviation_ratio) {
-  if (fair_value_history_.size() == 0 ||
-      fair_value_config_.moving_average == 0)
+  int window = GetFairValueConfigSnapshot()->config.moving_average;
+  if (fair_value_history_.size() == 0 || window == 0)
     return;
 
   // Mean.
-  int num = std::min(static_cast<int>(fair_value_history_.size()),
-                     fair_value_config_.moving_average);
+  int num = std::min(static_cast<int>(fair_value_history_.size()), window);
   double sum = std::accumulate(fair_value_history_.begin(),
                                fair_value_history_.begin() + num,
                                0.0);
   moving_average = sum / num;
 
-  // Standard deviation.
+  // Standard deviation (population) of the window, the same as
+  // |PricingCore|.
   double sq_sum = 0.0;
   for (auto it = fair_value_history_.begin();
        it != fair_value_history_.begin() + num;
        it++) {
-    sq_sum = ((*it) - moving_average) * ((*it) - moving_average);
+    sq_sum += ((*it) - moving_average) * ((*it) - moving_average);
   }
   standard_deviation = std::sqrt(sq_sum / num);
 
@@ -140,30 +214,47 @@ void Symbol::CalculateMovingAverage(
       : 0.0;
 }
 
-double Symbol::GetBaseCurrencyFairValue(const std::string& symbol) {
-  std::string message =
-      redis::client::Get(redis_client_, std::string(kFairValuePrefix) + symbol);
+// static
+common::Decimal Symbol::GetBaseCurrencyFairValue(
+    redis::client::Client* redis_client, RedisStorageMode storage,
+    const std::string& symbol, common::WallClockMs now) {
+  // Hash is read first while JSON is still written for other consumers.
+  if (storage != REDIS_STORAGE_JSON) {
+    common::Decimal fair_value;
+    if (GetBaseCurrencyFairValueFromHash(redis_client, symbol, now,
+                                         fair_value) ||
+        storage == REDIS_STORAGE_HASH)
+      return fair_value;
+  }
+
+  redis::Reply reply = redis::client::Get(
+      redis_client, std::string(kFairValuePrefix) + symbol);
+  common::StringView message = reply.String();
   if (!message.empty()) {
-    // Convert message to json.
-    nlohmann::json json = nlohmann::json::parse(message);
+    // Convert message to json, parsed in place.
+    nlohmann::json json =
+        nlohmann::json::parse(message.begin(), message.end(), nullptr, false);
 
     try {
-      // Check timestamp.
+      // Check timestamp (wall clock, milliseconds).
       std::string value = json[kTimestampKey].get<std::string>();
       uint64_t timestamp = std::stoull(value);
-      uint64_t now = common::GetCurrentTimestamp();
-      if (now > timestamp + Configuration::GetInstance()->GetDiffTimeMax()) {
+      if (common::ToUint64(now) >
+          timestamp + Configuration::GetInstance()->GetDiffTimeMax()) {
         LOG(INFO) << "Base fair value is too old, ignore it.";
-        return 0.0;
+        return common::Decimal();
       }
 
-      // Convert fair value string to double.
+      // Keep all digits of fair value string.
       value = json[kFairValueMVKey].get<std::string>();
-      return std::stod(value);
+      common::Decimal fair_value;
+      if (common::Decimal::Parse(value, fair_value))
+        return fair_value;
+      LOG(ERROR) << "Invalid base fair value: " << value;
     } catch(std::exception& e) {
       LOG(ERROR) << "Error while getting base fair value";
     }
   }
 
-  return 0.0;
+  return common::Decimal();
 }
\ No newline at end of file
@@ -1,11 +1,17 @@
 #ifndef SYMBOL_H_
 #define SYMBOL_H_
 
+#include <atomic>
+#include <memory>
 #include <mutex>
 #include <queue>
 #include <string>
 #include <vector>
+#include "common/clock.h"
+#include "common/decimal.h"
+#include "common/shm_price_writer.h"
 #include "redis_controller.h"
+#include "symbol_statistics.h"
 
 // Define the way to calculate fair value of a symbol.
 enum CalculateFairValueMethod {
@@ -67,6 +73,47 @@ struct FairValueConfig {
 
   // Others.
   int moving_average;
+  // Fair value is calculated every |refresh_interval| milliseconds, 0 if not
+  // set (interval of symbol in configuration file is used).
+  uint64_t refresh_interval = 0;
+};
+
+// Settings of a symbol at a point of time. A snapshot is never modified, a
+// new snapshot (with next version) is published when settings are updated,
+// so readers get consistent settings without lock.
+struct FairValueConfigSnapshot {
+  uint64_t version;
+  FairValueConfig config;
+};
+
+// Inputs of fair value calculation of a symbol in a loop. Calculation is
+// deterministic with the same inputs, so they are recorded by tick journal
+// to replay later.
+struct FairValueInputs {
+  FairValueConfig config;
+  uint64_t config_version;
+  int precision;
+  // Fair values of 2 legs with base currency (|BASED_ON_A_CURRENCY| method),
+  // 0 if not used or not available.
+  common::Decimal leg1;
+  common::Decimal leg2;
+};
+
+// Fair value data of a symbol, generated in each loop and sent to redis.
+struct FairValueData {
+  std::string symbol_name;
+  // Id of symbol in shared memory price buffer, -1 if not used.
+  int shm_symbol_id;
+  // Time of tick which generated this data (wall clock, milliseconds since
+  // unix epoch).
+  uint64_t timestamp;
+  // Rounded to precision of symbol.
+  common::Decimal fair_value;
+  double moving_average;
+  double standard_deviation_ratio;
+  // Values of statistics which are configured for group (same order as
+  // |GroupInformation::statistics|).
+  std::vector<double> statistics;
 };
 
 // Contain all methods of a symbol in Price Engine,
@@ -75,7 +122,7 @@ class Symbol {
 public:
   Symbol(const std::string& symbol_name,
          const FairValueConfig& config,
-         redisContext* redis_client);
+         int precision);
   // Symbol(const Symbol& other) = default;
   // Symbol& operator=(const Symbol& other) = default;
   virtual ~Symbol();
@@ -84,34 +131,109 @@ public:
   // This is update each time receive notify from NOP.
   void UpdateFairValueConfig(FairValueConfig config);
 
-  // Calculate fair value of this symbol.
-  double CalculateFairValue();
+  // Get current settings.
+  std::shared_ptr<const FairValueConfigSnapshot> GetFairValueConfigSnapshot() {
+    return std::atomic_load(&fair_value_config_);
+  }
+  // Get copy of current settings.
+  FairValueConfig GetFairValueConfig() {
+    return GetFairValueConfigSnapshot()->config;
+  }
+  // Version of current settings, increased each time settings are updated.
+  // Cheaper than getting snapshot, to check whether settings are changed.
+  uint64_t GetConfigVersion() { return config_version_; }
+
+  // Read settings and base currency prices (from redis, by |redis_client|
+  // which is owned by calling thread), which are needed to calculate fair
+  // value. |now| is time of current tick, to check age of base prices.
+  // Base prices are read in layout |storage| (see
+  // |GetBaseCurrencyFairValue()|).
+  void ReadInputs(redis::client::Client* redis_client,
+                  RedisStorageMode storage, common::WallClockMs now,
+                  FairValueInputs& inputs);
+
+  // Calculate fair value of this symbol from |inputs|, 0 if cannot
+  // calculate. Only fair value history of this symbol is used, no redis
+  // access.
+  common::Decimal CalculateFairValue(const FairValueInputs& inputs);
 
   // Other value need to be calculated, include: moving average,
   void CalculateMovingAverage(double& moving_average,
                               double& standard_deviation,
                               double& standard_deviation_ratio);
 
-  std::string GetSymbolName() { return symbol_name_; }
+  const std::string& GetSymbolName() const { return symbol_name_; }
 
-private:
-  // Get fair value of base currency from redis.
+  // History of fair values, newest first. Used to save state of this symbol
+  // and to restore it (by |LoadFairValueHistory()|) in another process, and
+  // must not be called while fair value is calculated.
+  std::vector<double> GetFairValueHistory() const {
+    return std::vector<double>(fair_value_history_.begin(),
+                               fair_value_history_.end());
+  }
+  void LoadFairValueHistory(const std::vector<double>& values);
+
+  // Number of digits after decimal point of fair value.
+  int GetPrecision() { return precision_; }
+  void SetPrecision(int precision);
+
+  // Get fair value of base currency |symbol| (ex: btcjpy) from redis.
   // Used to calculate fair value by |BASED_ON_A_CURRENCY| method.
-  double GetBaseCurrencyFairValue(const std::string& symbol);
+  // Return 0 if value is not existed or older than 'common.diff_time_max'
+  // at |now|. Record is read from hash or JSON by |storage|, which is storage
+  // mode of calling group (same as its writes, even after configuration is
+  // reloaded).
+  static common::Decimal GetBaseCurrencyFairValue(
+      redis::client::Client* redis_client, RedisStorageMode storage,
+      const std::string& symbol, common::WallClockMs now);
+
+  // Refresh interval from configuration file (milliseconds), 0 if not set
+  // (interval of group is used). |FairValueConfig::refresh_interval|
+  // overrides it.
+  uint64_t GetRefreshInterval() { return refresh_interval_; }
+  void SetRefreshInterval(uint64_t interval) { refresh_interval_ = interval; }
+
+  // Id of this symbol in shared memory price buffer, -1 if not used.
+  int GetShmSymbolId() { return shm_symbol_id_; }
+  // Id is registered in |shm_writer|, it is unregistered when this symbol is
+  // destroyed (no thread writes it after that).
+  void SetShmSymbolId(common::ShmPriceWriter* shm_writer, int id) {
+    shm_writer_ = shm_writer;
+    shm_symbol_id_ = id;
+  }
+
+  // Id of this symbol in tick journal, -1 if not used.
+  int GetJournalSymbolId() { return journal_symbol_id_; }
+  void SetJournalSymbolId(int id) { journal_symbol_id_ = id; }
+
+  // Statistics of fair values. Used by loop thread of group only.
+  SymbolStatistics& GetStatistics() { return statistics_; }
 
+private:
   // Symbol name.
   std::string symbol_name_;
 
   // Settings, used to calculate fair value.
-  FairValueConfig fair_value_config_;
+  std::shared_ptr<const FairValueConfigSnapshot> fair_value_config_;
+  std::atomic<uint64_t> config_version_{0};
+
+  // Number of digits after decimal point of fair value.
+  std::atomic<int> precision_;
+  std::atomic<uint64_t> refresh_interval_{0};
 
   // Save old fair value to calculate moving average.
   std::deque<double> fair_value_history_;
 
-  // Redis client, used to get data from redis.
-  redisContext* redis_client_;
+  // Id of this symbol in shared memory price buffer.
+  common::ShmPriceWriter* shm_writer_ = nullptr;
+  int shm_symbol_id_ = -1;
+  // Id of this symbol in tick journal.
+  int journal_symbol_id_ = -1;
+
+  // Statistics of fair values (SMA, EWMA, min/max of several windows).
+  SymbolStatistics statistics_;
 
-  // Mutexes to protect behavior of symbol class.
+  // Serialize updates of settings.
   std::mutex setting_mutex_;
 };
 
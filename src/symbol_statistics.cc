@@ -0,0 +1,145 @@
+#include "symbol_statistics.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Initial size of ring buffer (power of 2).
+const size_t kInitialSampleNumber = 64;
+
+} // namespace
+
+SymbolStatistics::SymbolStatistics()
+    : keep_samples_(false),
+      samples_(kInitialSampleNumber),
+      head_(0),
+      tail_(0),
+      shift_(0.0) {
+}
+
+SymbolStatistics::~SymbolStatistics() {
+}
+
+void SymbolStatistics::Configure(const std::shared_ptr<const Config>& config) {
+  config_ = config;
+  windows_.clear();
+  keep_samples_ = false;
+  if (config_ != nullptr) {
+    for (auto& statistic : *config_) {
+      Window window;
+      window.type = statistic.type;
+      window.length = statistic.window;
+      window.begin = head_;
+      window.sum = 0.0;
+      window.average = 0.0;
+      window.last_timestamp = 0;
+      windows_.push_back(window);
+      keep_samples_ |= statistic.type != STATISTIC_EWMA;
+    }
+  }
+
+  // Fill new windows with kept samples.
+  for (uint64_t sequence = head_; sequence < tail_; sequence++) {
+    for (auto& window : windows_)
+      Update(window, sequence);
+  }
+  Trim();
+}
+
+void SymbolStatistics::Add(uint64_t timestamp, double value,
+                           std::vector<double>& values) {
+  values.resize(windows_.size());
+  if (windows_.empty())
+    return;
+
+  uint64_t sequence = Push(timestamp, value);
+  for (size_t i = 0; i < windows_.size(); i++)
+    values[i] = Update(windows_[i], sequence);
+  Trim();
+}
+
+uint64_t SymbolStatistics::Push(uint64_t timestamp, double value) {
+  if (head_ == tail_)
+    shift_ = value;
+
+  if (tail_ - head_ == samples_.size()) {
+    // Grow ring buffer, samples keep their sequence numbers.
+    std::vector<Sample> samples(samples_.size() * 2);
+    for (uint64_t sequence = head_; sequence < tail_; sequence++)
+      samples[sequence & (samples.size() - 1)] = GetSample(sequence);
+    samples_.swap(samples);
+  }
+
+  Sample& sample = samples_[tail_ & (samples_.size() - 1)];
+  sample.timestamp = timestamp;
+  sample.value = value;
+  return tail_++;
+}
+
+double SymbolStatistics::Update(Window& window, uint64_t sequence) {
+  const Sample& sample = GetSample(sequence);
+  switch (window.type) {
+  case STATISTIC_SMA:
+    window.sum += sample.value - shift_;
+    Expire(window, sequence);
+    return shift_ + window.sum / (sequence + 1 - window.begin);
+  case STATISTIC_EWMA:
+    // Weight of previous average is halved after each half-life, so
+    // irregular intervals between samples are handled.
+    if (window.last_timestamp == 0) {
+      window.average = sample.value;
+    } else if (sample.timestamp > window.last_timestamp) {
+      double elapsed =
+          static_cast<double>(sample.timestamp - window.last_timestamp);
+      double alpha = 1.0 - std::exp2(-elapsed / window.length);
+      window.average += alpha * (sample.value - window.average);
+    }
+    window.last_timestamp = sample.timestamp;
+    return window.average;
+  case STATISTIC_MIN:
+    while (!window.extremes.empty() &&
+           GetSample(window.extremes.back()).value >= sample.value)
+      window.extremes.pop_back();
+    window.extremes.push_back(sequence);
+    Expire(window, sequence);
+    return GetSample(window.extremes.front()).value;
+  case STATISTIC_MAX:
+    while (!window.extremes.empty() &&
+           GetSample(window.extremes.back()).value <= sample.value)
+      window.extremes.pop_back();
+    window.extremes.push_back(sequence);
+    Expire(window, sequence);
+    return GetSample(window.extremes.front()).value;
+  }
+
+  return 0.0;
+}
+
+void SymbolStatistics::Expire(Window& window, uint64_t sequence) {
+  // Window is (timestamp - length, timestamp], latest sample is always kept.
+  uint64_t timestamp = GetSample(sequence).timestamp;
+  while (window.begin < sequence &&
+         GetSample(window.begin).timestamp + window.length <= timestamp) {
+    if (window.type == STATISTIC_SMA)
+      window.sum -= GetSample(window.begin).value - shift_;
+    window.begin++;
+  }
+
+  while (!window.extremes.empty() && window.extremes.front() < window.begin)
+    window.extremes.pop_front();
+}
+
+void SymbolStatistics::Trim() {
+  if (!keep_samples_) {
+    head_ = tail_;
+    return;
+  }
+
+  uint64_t head = tail_;
+  for (auto& window : windows_) {
+    if (window.type != STATISTIC_EWMA)
+      head = std::min(head, window.begin);
+  }
+  head_ = head;
+}
@@ -0,0 +1,87 @@
+#ifndef SYMBOL_STATISTICS_H_
+#define SYMBOL_STATISTICS_H_
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+#include "configuration.h"
+
+// Statistics of fair values of a symbol over several windows at once (ex:
+// SMA 1s/10s/60s, EWMA, min/max over 60s).
+//
+// Samples are kept in one ring buffer, shared by all windows, as long as the
+// longest window needs them. Each window is maintained incrementally when a
+// sample is added: SMA by a running sum, min/max by a monotonic deque of
+// samples, EWMA by its last value. So the cost per sample does not depend on
+// window size.
+//
+// Not thread-safe, used by loop thread of group only.
+class SymbolStatistics {
+public:
+  typedef std::vector<StatisticInformation> Config;
+
+  SymbolStatistics();
+  virtual ~SymbolStatistics();
+
+  // Apply |config| (shared by all symbols of a group). Samples which are
+  // still kept are added again, so windows which are not longer than the
+  // previous longest window have values immediately.
+  void Configure(const std::shared_ptr<const Config>& config);
+  const std::shared_ptr<const Config>& GetConfig() const { return config_; }
+
+  // Add fair value |value| at |timestamp| (milliseconds, monotonic), then
+  // write value of each statistic (same order as config) into |values|.
+  void Add(uint64_t timestamp, double value, std::vector<double>& values);
+
+private:
+  struct Sample {
+    uint64_t timestamp;
+    double value;
+  };
+
+  struct Window {
+    StatisticType type;
+    uint64_t length;
+    // Sequence number of first sample in window.
+    uint64_t begin;
+    // SMA: sum of samples (shifted by |shift_|) in window.
+    double sum;
+    // EWMA: current value and time of last sample.
+    double average;
+    uint64_t last_timestamp;
+    // MIN/MAX: sequence numbers of samples which can still be the min/max,
+    // values are monotonic from front (min/max of window) to back.
+    std::deque<uint64_t> extremes;
+  };
+
+  const Sample& GetSample(uint64_t sequence) const {
+    return samples_[sequence & (samples_.size() - 1)];
+  }
+
+  // Append sample to ring buffer, grow buffer if it is full.
+  uint64_t Push(uint64_t timestamp, double value);
+  // Add sample |sequence| to |window|, return value of window.
+  double Update(Window& window, uint64_t sequence);
+  // Move first sample of |window| forward until it is inside window of
+  // sample |sequence|.
+  void Expire(Window& window, uint64_t sequence);
+  // Release samples which are not in any window.
+  void Trim();
+
+  std::shared_ptr<const Config> config_;
+  std::vector<Window> windows_;
+  // True if a window needs samples (SMA/MIN/MAX).
+  bool keep_samples_;
+
+  // Ring buffer, size is power of 2. Samples are identified by sequence
+  // number, samples [head_, tail_) are kept.
+  std::vector<Sample> samples_;
+  uint64_t head_;
+  uint64_t tail_;
+  // Samples are shifted by first value to avoid losing precision of sums
+  // with big prices.
+  double shift_;
+};
+
+#endif  // SYMBOL_STATISTICS_H_
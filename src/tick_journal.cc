@@ -0,0 +1,308 @@
+#include "tick_journal.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include "common/thread_helper.h"
+#include "glog/logging.h"
+
+namespace {
+
+// Number of records per block (about 136KB).
+const size_t kBlockRecordNumber = 1024;
+// Max number of blocks waiting to be written, records are dropped after
+// that (about 136MB).
+const size_t kMaxPendingBlockNumber = 1024;
+// Partial block is written after this interval. (milliseconds)
+const int kFlushInterval = 100;
+
+} // namespace
+
+void SetTickJournalInputs(const FairValueInputs& inputs,
+                          TickJournalRecord& record) {
+  record.config_version = inputs.config_version;
+  record.calculate_method = inputs.config.calculate_method;
+  record.moving_average_window = inputs.config.moving_average;
+  record.skew_active = inputs.config.skew_active;
+  record.skew_type = inputs.config.skew_type;
+  record.fixed_price = inputs.config.fixed_price;
+  record.skew_value = inputs.config.skew_value;
+  record.skew_percent = inputs.config.skew_percent;
+  record.precision = inputs.precision;
+  record.leg1_mantissa = inputs.leg1.mantissa();
+  record.leg1_scale = inputs.leg1.scale();
+  record.leg2_mantissa = inputs.leg2.mantissa();
+  record.leg2_scale = inputs.leg2.scale();
+}
+
+void GetTickJournalInputs(const TickJournalRecord& record,
+                          FairValueInputs& inputs) {
+  inputs.config_version = record.config_version;
+  inputs.config.calculate_method =
+      static_cast<CalculateFairValueMethod>(record.calculate_method);
+  inputs.config.moving_average = record.moving_average_window;
+  inputs.config.skew_active = record.skew_active != 0;
+  inputs.config.skew_type = record.skew_type;
+  inputs.config.fixed_price = record.fixed_price;
+  inputs.config.skew_value = record.skew_value;
+  inputs.config.skew_percent = record.skew_percent;
+  inputs.precision = record.precision;
+  inputs.leg1 = common::Decimal(record.leg1_mantissa, record.leg1_scale);
+  inputs.leg2 = common::Decimal(record.leg2_mantissa, record.leg2_scale);
+}
+
+TickJournalWriter::TickJournalWriter()
+    : fd_(-1), offset_(0), stop_(false), dropped_count_(0) {}
+
+TickJournalWriter::~TickJournalWriter() {
+  Close();
+}
+
+bool TickJournalWriter::Open(const std::string& file_name) {
+  Close();
+
+  int fd = open(file_name.c_str(), O_CREAT | O_WRONLY, 0644);
+  if (fd < 0) {
+    LOG(ERROR) << "Cannot open tick journal " << file_name << ": "
+               << strerror(errno);
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return false;
+  }
+
+  // New file starts with header. Append to existing file after its last
+  // complete record.
+  uint64_t offset = st.st_size;
+  if (offset < sizeof(TickJournalHeader)) {
+    TickJournalHeader header;
+    header.magic = kTickJournalMagic;
+    header.version = kTickJournalVersion;
+    header.record_size = sizeof(TickJournalRecord);
+    header.reserved = 0;
+    if (pwrite(fd, &header, sizeof(header), 0) != sizeof(header)) {
+      LOG(ERROR) << "Cannot write tick journal header: " << strerror(errno);
+      close(fd);
+      return false;
+    }
+    offset = sizeof(header);
+  } else {
+    offset -= (offset - sizeof(TickJournalHeader)) % sizeof(TickJournalRecord);
+  }
+
+  file_name_ = file_name;
+  fd_ = fd;
+  offset_ = offset;
+  stop_ = false;
+  dropped_count_ = 0;
+  thread_ = std::thread(&TickJournalWriter::Run, this);
+  LOG(INFO) << "Tick journal " << file_name << " is opened.";
+  return true;
+}
+
+void TickJournalWriter::Close() {
+  if (fd_ < 0)
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  condition_.notify_one();
+  thread_.join();
+
+  if (dropped_count_ > 0)
+    LOG(ERROR) << dropped_count_ << " records are dropped from tick journal.";
+  close(fd_);
+  fd_ = -1;
+}
+
+int TickJournalWriter::RegisterSymbol(const std::string& symbol_name) {
+  std::lock_guard<std::mutex> lock(register_mutex_);
+  auto it = symbol_ids_.find(symbol_name);
+  if (it != symbol_ids_.end())
+    return it->second;
+
+  int id = static_cast<int>(symbol_ids_.size());
+  symbol_ids_[symbol_name] = id;
+  return id;
+}
+
+void TickJournalWriter::Append(const std::vector<TickJournalRecord>& records) {
+  if (records.empty() || fd_ < 0)
+    return;
+
+  bool notify = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& record : records) {
+      if (pending_blocks_.empty() ||
+          pending_blocks_.back()->size() == kBlockRecordNumber) {
+        if (pending_blocks_.size() == kMaxPendingBlockNumber) {
+          dropped_count_++;
+          continue;
+        }
+
+        if (free_blocks_.empty()) {
+          pending_blocks_.emplace_back(new Block());
+          pending_blocks_.back()->reserve(kBlockRecordNumber);
+        } else {
+          pending_blocks_.push_back(std::move(free_blocks_.back()));
+          free_blocks_.pop_back();
+        }
+        notify |= pending_blocks_.size() > 1;
+      }
+      pending_blocks_.back()->push_back(record);
+    }
+  }
+
+  // Wake writer up as soon as a block is full.
+  if (notify)
+    condition_.notify_one();
+}
+
+void TickJournalWriter::Run() {
+  common::SetCurrentThreadName("pe-journal");
+
+  std::vector<std::unique_ptr<Block>> blocks;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    condition_.wait_for(lock, std::chrono::milliseconds(kFlushInterval),
+        [this]() { return stop_ || pending_blocks_.size() > 1; });
+    bool stop = stop_;
+
+    blocks.swap(pending_blocks_);
+    lock.unlock();
+    WriteBlocks(blocks);
+    lock.lock();
+
+    for (auto& block : blocks) {
+      block->clear();
+      free_blocks_.push_back(std::move(block));
+    }
+    blocks.clear();
+
+    if (stop)
+      break;
+  }
+}
+
+void TickJournalWriter::WriteBlocks(
+    const std::vector<std::unique_ptr<Block>>& blocks) {
+  size_t index = 0;
+  while (index < blocks.size()) {
+    // One system call for up to IOV_MAX blocks.
+    struct iovec iov[IOV_MAX];
+    int iov_number = 0;
+    size_t size = 0;
+    for (; index < blocks.size() && iov_number < IOV_MAX; index++) {
+      if (blocks[index]->empty())
+        continue;
+      iov[iov_number].iov_base = blocks[index]->data();
+      iov[iov_number].iov_len =
+          blocks[index]->size() * sizeof(TickJournalRecord);
+      size += iov[iov_number].iov_len;
+      iov_number++;
+    }
+
+    // Continue after partial write.
+    struct iovec* current = iov;
+    while (size > 0) {
+      ssize_t written = pwritev(fd_, current, iov_number, offset_);
+      if (written < 0) {
+        if (errno == EINTR)
+          continue;
+        LOG(ERROR) << "Cannot write tick journal " << file_name_ << ": "
+                   << strerror(errno);
+        return;
+      }
+
+      offset_ += written;
+      size -= written;
+      while (iov_number > 0 &&
+             static_cast<size_t>(written) >= current->iov_len) {
+        written -= current->iov_len;
+        current++;
+        iov_number--;
+      }
+      if (iov_number > 0) {
+        current->iov_base = static_cast<char*>(current->iov_base) + written;
+        current->iov_len -= written;
+      }
+    }
+  }
+}
+
+TickJournalReader::TickJournalReader()
+    : address_(nullptr), size_(0), records_(nullptr), record_number_(0) {}
+
+TickJournalReader::~TickJournalReader() {
+  Close();
+}
+
+bool TickJournalReader::Open(const std::string& file_name) {
+  Close();
+
+  int fd = open(file_name.c_str(), O_RDONLY);
+  if (fd < 0) {
+    LOG(ERROR) << "Cannot open tick journal " << file_name << ": "
+               << strerror(errno);
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      static_cast<size_t>(st.st_size) < sizeof(TickJournalHeader)) {
+    LOG(ERROR) << "Tick journal " << file_name << " is empty.";
+    close(fd);
+    return false;
+  }
+
+  void* address = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (address == MAP_FAILED) {
+    LOG(ERROR) << "Cannot map tick journal " << file_name << ": "
+               << strerror(errno);
+    return false;
+  }
+  address_ = address;
+  size_ = st.st_size;
+
+  const TickJournalHeader* header =
+      static_cast<const TickJournalHeader*>(address_);
+  if (header->magic != kTickJournalMagic ||
+      header->version != kTickJournalVersion ||
+      header->record_size != sizeof(TickJournalRecord)) {
+    LOG(ERROR) << "Tick journal " << file_name << " is not supported.";
+    Close();
+    return false;
+  }
+
+  // Records are read sequentially.
+  madvise(address_, size_, MADV_SEQUENTIAL);
+  records_ = reinterpret_cast<const TickJournalRecord*>(header + 1);
+  record_number_ =
+      (size_ - sizeof(TickJournalHeader)) / sizeof(TickJournalRecord);
+  return true;
+}
+
+void TickJournalReader::Close() {
+  if (address_ == nullptr)
+    return;
+
+  munmap(address_, size_);
+  address_ = nullptr;
+  size_ = 0;
+  records_ = nullptr;
+  record_number_ = 0;
+}
@@ -0,0 +1,156 @@
+#ifndef TICK_JOURNAL_H_
+#define TICK_JOURNAL_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "configuration.h"
+#include "symbol.h"
+
+// Append-only binary journal of all inputs and outputs of fair value
+// calculation, one fixed-size record per symbol per loop. Used to reproduce
+// pricing incidents: "PE --replay <journal>" re-runs the calculation with
+// recorded inputs, without redis, and compares outputs (see replay.h).
+//
+//   | TickJournalHeader | TickJournalRecord | TickJournalRecord | ...
+//
+// Records are in native byte order, journal is read on the same platform.
+
+const uint32_t kTickJournalMagic = 0x4a544550;  // "PETJ"
+const uint32_t kTickJournalVersion = 1;
+const size_t kTickJournalSymbolNameSize = 16;
+
+struct TickJournalHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t record_size;
+  uint32_t reserved;
+};
+
+struct TickJournalRecord {
+  // Id of symbol in the run of PE which wrote this record. Symbols can have
+  // other ids in other runs (appended to the same file), name is the key.
+  int32_t symbol_id;
+  // |PricingCoreType| which calculated this record.
+  int32_t pricing_core;
+  char symbol_name[kTickJournalSymbolNameSize];
+  // Wall clock, milliseconds since unix epoch.
+  uint64_t timestamp;
+
+  // Inputs.
+  uint64_t config_version;
+  int32_t calculate_method;
+  int32_t moving_average_window;
+  int32_t skew_active;
+  int32_t skew_type;
+  double fixed_price;
+  double skew_value;
+  double skew_percent;
+  int32_t precision;
+  int32_t leg1_scale;
+  int32_t leg2_scale;
+  int32_t fair_value_scale;
+  int64_t leg1_mantissa;
+  int64_t leg2_mantissa;
+
+  // Outputs.
+  int64_t fair_value_mantissa;
+  double moving_average;
+  double standard_deviation_ratio;
+};
+
+static_assert(sizeof(TickJournalRecord) == 136,
+              "Layout of TickJournalRecord is changed, update version.");
+
+// Fill inputs of |record|.
+void SetTickJournalInputs(const FairValueInputs& inputs,
+                          TickJournalRecord& record);
+// Get inputs from |record|.
+void GetTickJournalInputs(const TickJournalRecord& record,
+                          FairValueInputs& inputs);
+
+// Write records to journal file. Records are appended to memory blocks by
+// loop threads (one lock per loop), a background thread writes full blocks
+// by pwritev(), so loops do not wait for disk.
+class TickJournalWriter {
+public:
+  TickJournalWriter();
+  virtual ~TickJournalWriter();
+
+  TickJournalWriter(const TickJournalWriter&) = delete;
+  TickJournalWriter& operator=(const TickJournalWriter&) = delete;
+
+  // Open |file_name| to append (create it if not existed), start writer
+  // thread.
+  bool Open(const std::string& file_name);
+  // Write all pending records, stop writer thread.
+  void Close();
+
+  // Get id of |symbol_name|, register it if necessary.
+  int RegisterSymbol(const std::string& symbol_name);
+
+  // Append |records| (can be called by many threads). Records are dropped if
+  // writer thread is too far behind.
+  void Append(const std::vector<TickJournalRecord>& records);
+
+private:
+  typedef std::vector<TickJournalRecord> Block;
+
+  // Run on writer thread.
+  void Run();
+  // Write |blocks| to file at |offset_|.
+  void WriteBlocks(const std::vector<std::unique_ptr<Block>>& blocks);
+
+  std::string file_name_;
+  int fd_;
+  // Position of next write.
+  uint64_t offset_;
+
+  // Protect blocks and |stop_|.
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  // Blocks which are waiting to be written (last one can be partial).
+  std::vector<std::unique_ptr<Block>> pending_blocks_;
+  // Written blocks, reused to avoid allocation.
+  std::vector<std::unique_ptr<Block>> free_blocks_;
+  bool stop_;
+  uint64_t dropped_count_;
+
+  std::thread thread_;
+
+  // Protect symbol registration.
+  std::mutex register_mutex_;
+  std::map<std::string, int> symbol_ids_;
+};
+
+// Read journal file (mapped into memory).
+class TickJournalReader {
+public:
+  TickJournalReader();
+  virtual ~TickJournalReader();
+
+  TickJournalReader(const TickJournalReader&) = delete;
+  TickJournalReader& operator=(const TickJournalReader&) = delete;
+
+  bool Open(const std::string& file_name);
+  void Close();
+
+  // Records are valid until |Close()|. A partial record at the end (PE was
+  // killed while writing) is ignored.
+  size_t GetRecordNumber() const { return record_number_; }
+  const TickJournalRecord* GetRecords() const { return records_; }
+
+private:
+  void* address_;
+  size_t size_;
+  const TickJournalRecord* records_;
+  size_t record_number_;
+};
+
+#endif  // TICK_JOURNAL_H_